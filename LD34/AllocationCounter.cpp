@@ -0,0 +1,154 @@
+#include "PCH.hpp"
+#include "AllocationCounter.hpp"
+#include "Logger.hpp"
+#include "MemoryTracker.hpp"
+#include <atomic>
+#include <new>
+
+static std::atomic<uint64_t> s_allocations(0);
+static std::atomic<uint64_t> s_frees(0);
+static std::atomic<uint64_t> s_bytesAllocated(0);
+static std::atomic<uint64_t> s_exemptAllocations(0);
+static thread_local int s_exemptDepth = 0;
+
+uint64_t AllocationCounter::GetAllocations()
+{
+    return s_allocations.load(std::memory_order_relaxed);
+}
+
+uint64_t AllocationCounter::GetFrees()
+{
+    return s_frees.load(std::memory_order_relaxed);
+}
+
+uint64_t AllocationCounter::GetBytesAllocated()
+{
+    return s_bytesAllocated.load(std::memory_order_relaxed);
+}
+
+uint64_t AllocationCounter::GetExemptAllocations()
+{
+    return s_exemptAllocations.load(std::memory_order_relaxed);
+}
+
+AllocationExemption::AllocationExemption()
+{
+    s_exemptDepth++;
+}
+
+AllocationExemption::~AllocationExemption()
+{
+    s_exemptDepth--;
+}
+
+static void CountAllocation(std::size_t size)
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    s_bytesAllocated.fetch_add(size, std::memory_order_relaxed);
+    if (s_exemptDepth > 0)
+    {
+        s_exemptAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+static void* CountedAlloc(std::size_t size)
+{
+    CountAllocation(size);
+
+#if JAND_MEMORY_TRACKING
+    return MemoryTracker::Allocate(size);
+#else
+    void* ptr = std::malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    return ptr;
+#endif
+}
+
+static void CountedFree(void* ptr)
+{
+    if (ptr != nullptr)
+    {
+        s_frees.fetch_add(1, std::memory_order_relaxed);
+#if JAND_MEMORY_TRACKING
+        MemoryTracker::Free(ptr);
+#else
+        std::free(ptr);
+#endif
+    }
+}
+
+void* operator new(std::size_t size)
+{
+    return CountedAlloc(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return CountedAlloc(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    CountedFree(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    CountedFree(ptr);
+}
+
+#if SDL_VERSION_ATLEAST(2, 0, 7)
+// SDL's own allocator, which the hooks below forward to
+static SDL_malloc_func s_sdlMalloc = nullptr;
+static SDL_calloc_func s_sdlCalloc = nullptr;
+static SDL_realloc_func s_sdlRealloc = nullptr;
+static SDL_free_func s_sdlFree = nullptr;
+
+static void* SDLCALL CountedSDLMalloc(size_t size)
+{
+    CountAllocation(size);
+    return s_sdlMalloc(size);
+}
+
+static void* SDLCALL CountedSDLCalloc(size_t count, size_t size)
+{
+    CountAllocation(count * size);
+    return s_sdlCalloc(count, size);
+}
+
+static void* SDLCALL CountedSDLRealloc(void* ptr, size_t size)
+{
+    CountAllocation(size);
+    return s_sdlRealloc(ptr, size);
+}
+
+static void SDLCALL CountedSDLFree(void* ptr)
+{
+    if (ptr != nullptr)
+    {
+        s_frees.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    s_sdlFree(ptr);
+}
+#endif
+
+void AllocationCounter::InstallSDLHooks()
+{
+#if SDL_VERSION_ATLEAST(2, 0, 7)
+    if (s_sdlMalloc != nullptr)
+    {
+        return;
+    }
+
+    SDL_GetMemoryFunctions(&s_sdlMalloc, &s_sdlCalloc, &s_sdlRealloc, &s_sdlFree);
+    if (SDL_SetMemoryFunctions(CountedSDLMalloc, CountedSDLCalloc, CountedSDLRealloc, CountedSDLFree) < 0)
+    {
+        LOG_ERROR("Unable to count SDL allocations! SDL error: %s", SDL_GetError());
+    }
+#endif
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "PCH.hpp"
+
+// Running totals of every heap allocation made through global operator new,
+// and through SDL_malloc() once the SDL hooks are installed. The counters are
+// cheap relaxed atomics so they can stay on in release builds.
+class AllocationCounter
+{
+public:
+    static uint64_t GetAllocations();
+    static uint64_t GetFrees();
+    static uint64_t GetBytesAllocated();
+
+    // Allocations made inside an AllocationExemption
+    static uint64_t GetExemptAllocations();
+
+    // Must be called before SDL allocates anything, so before SDL_Init()
+    static void InstallSDLHooks();
+};
+
+// Allocations made on this thread while one of these is alive are still
+// counted, but also tallied as exempt. Used for work that is allowed to
+// allocate after warm-up, like adding objects to the world.
+class AllocationExemption
+{
+public:
+    AllocationExemption();
+    ~AllocationExemption();
+};
@@ -0,0 +1,135 @@
+#include "PCH.hpp"
+#include "BatchRunner.hpp"
+#include "Game.hpp"
+#include "ScriptPlayer.hpp"
+#include <thread>
+
+// Ticks in a minute of game time
+static const double TICKS_PER_MINUTE = 60.0 * 60.0;
+
+BatchRunner::BatchRunner(const GameOptions& options) :
+    m_options(options),
+    m_nextWorld(0)
+{
+    // Every world is a plain headless simulation, whatever else was asked for
+    m_options.headless = true;
+    m_options.software = false;
+    m_options.dumpPath.clear();
+    m_options.telemetryPath.clear();
+    m_options.allocCheck = 0;
+    m_options.hostPort = 0;
+    m_options.joinAddress.clear();
+}
+
+int BatchRunner::Run()
+{
+    int worlds = m_options.batchWorlds;
+    int threads = m_options.batchThreads;
+    if (threads <= 0)
+    {
+        threads = std::max((int)std::thread::hardware_concurrency(), 1);
+    }
+    threads = std::min(threads, worlds);
+
+    m_results.assign(worlds, WorldResult());
+    m_nextWorld = 0;
+
+    Uint64 startTime = SDL_GetPerformanceCounter();
+
+    std::vector<std::thread> pool;
+    for (int i = 0; i < threads; i++)
+    {
+        pool.push_back(std::thread(&BatchRunner::Worker, this));
+    }
+
+    for (std::vector<std::thread>::iterator it = pool.begin(); it != pool.end(); it++)
+    {
+        it->join();
+    }
+
+    double seconds = (double)(SDL_GetPerformanceCounter() - startTime) / SDL_GetPerformanceFrequency();
+    PrintResults(threads, seconds);
+    return 0;
+}
+
+void BatchRunner::Worker()
+{
+    for (;;)
+    {
+        int index = m_nextWorld.fetch_add(1);
+        if (index >= m_options.batchWorlds)
+        {
+            return;
+        }
+
+        RunWorld(index);
+    }
+}
+
+void BatchRunner::RunWorld(int index)
+{
+    GameOptions options = m_options;
+    options.seed = m_options.seed + index;
+
+    Uint64 startTime = SDL_GetPerformanceCounter();
+
+    Game game(options);
+    game.CreateWorld();
+    ScriptPlayer script(&game);
+    while (game.GetTick() < options.maxTicks)
+    {
+        if (options.script)
+        {
+            script.Update();
+        }
+        game.Step();
+    }
+
+    // Each thread only ever writes its own worlds' slots
+    WorldResult& result = m_results[index];
+    result.seed = options.seed;
+    result.ticks = game.GetTick();
+    result.resourcesGathered = game.GetResourcesGathered();
+    result.resources = game.GetResources();
+    result.peons = game.GetPeonCount();
+    result.checksum = game.ComputeChecksum();
+    result.seconds = (double)(SDL_GetPerformanceCounter() - startTime) / SDL_GetPerformanceFrequency();
+}
+
+void BatchRunner::PrintResults(int threads, double seconds) const
+{
+    double minutes = m_options.maxTicks / TICKS_PER_MINUTE;
+    double totalRate = 0;
+    double minRate = 0;
+    double maxRate = 0;
+    int totalGrowth = 0;
+    int minGrowth = 0;
+    int maxGrowth = 0;
+    uint64_t totalTicks = 0;
+
+    for (size_t i = 0; i < m_results.size(); i++)
+    {
+        const WorldResult& result = m_results[i];
+        double rate = result.resourcesGathered / minutes;
+        int growth = result.peons - m_options.initialPeons;
+
+        std::cout << "World " << i << " (seed " << result.seed << "): gathered " << result.resourcesGathered
+            << " (" << rate << " per minute), " << result.resources << " left, " << m_options.initialPeons
+            << " -> " << result.peons << " peons, checksum " << std::hex << result.checksum << std::dec
+            << ", " << result.seconds << "s" << std::endl;
+
+        totalRate += rate;
+        totalGrowth += growth;
+        totalTicks += result.ticks;
+        minRate = (i == 0) ? rate : std::min(minRate, rate);
+        maxRate = (i == 0) ? rate : std::max(maxRate, rate);
+        minGrowth = (i == 0) ? growth : std::min(minGrowth, growth);
+        maxGrowth = (i == 0) ? growth : std::max(maxGrowth, growth);
+    }
+
+    double count = (double)m_results.size();
+    std::cout << "Resources per minute: mean " << (totalRate / count) << ", min " << minRate << ", max " << maxRate << std::endl;
+    std::cout << "Peon growth: mean " << (totalGrowth / count) << ", min " << minGrowth << ", max " << maxGrowth << std::endl;
+    std::cout << "Simulated " << m_results.size() << " worlds of " << m_options.maxTicks << " ticks on " << threads
+        << " threads in " << seconds << "s (" << (totalTicks / seconds) << " world ticks/s)" << std::endl;
+}
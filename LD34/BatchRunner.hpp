@@ -0,0 +1,38 @@
+#pragma once
+#include "PCH.hpp"
+#include "GameOptions.hpp"
+#include <atomic>
+
+// Simulates a batch of headless worlds side by side, seeded one after
+// another, on a pool of threads. Each thread takes the next world nobody has
+// started and runs it to the end before taking another, so one slow world
+// only holds up its own thread. Prints how every world did, how the batch
+// did as a whole, and the throughput in world ticks per second.
+class BatchRunner
+{
+public:
+    BatchRunner(const GameOptions& options);
+
+    int Run();
+
+private:
+    struct WorldResult
+    {
+        unsigned int seed;
+        int ticks;
+        int resourcesGathered;
+        int resources;
+        int peons;
+        uint32_t checksum;
+        double seconds;
+    };
+
+    void Worker();
+    void RunWorld(int index);
+    void PrintResults(int threads, double seconds) const;
+
+private:
+    GameOptions m_options;
+    std::vector<WorldResult> m_results;
+    std::atomic<int> m_nextWorld;
+};
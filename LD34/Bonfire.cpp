@@ -2,49 +2,78 @@
 #include "Bonfire.hpp"
 #include "Game.hpp"
 
-Bonfire::Bonfire(Game* game)
+Bonfire::Bonfire(Game* game) :
+    m_stage(0),
+    m_flamesDue(0)
 {
     m_game = game;
     m_ID = "bonfire";
+
+    m_depositSubscription = m_game->GetEvents().Subscribe<ResourcesDepositedEvent>(
+        [this](const ResourcesDepositedEvent& event) { SetStage(event.total); });
+    m_sacrificeSubscription = m_game->GetEvents().Subscribe<PeonSacrificedEvent>(
+        [this](const PeonSacrificedEvent& event) { SetStage(event.resources); });
+}
+
+Bonfire::~Bonfire()
+{
+    m_game->GetEvents().Unsubscribe<ResourcesDepositedEvent>(m_depositSubscription);
+    m_game->GetEvents().Unsubscribe<PeonSacrificedEvent>(m_sacrificeSubscription);
+}
+
+void Bonfire::Load(Vector2D position, double width, double height, std::string textureID)
+{
+    GameObject::Load(position, width, height, textureID);
+    SetStage(m_game->GetResources());
 }
 
 void Bonfire::Update()
 {
     GameObject::Update();
-    
-    int resources = m_game->GetResources();
+
+    // A bigger fire throws more flames, and bigger ones
+    m_flamesDue += FLAME_RATES[m_stage] * m_game->m_deltaTime;
+    int flames = (int)m_flamesDue;
+    m_flamesDue -= flames;
+
+    float x = (float)(m_position.GetX() + m_width / 2);
+    float y = (float)(m_position.GetY() + m_height - 10);
+    m_game->GetParticles().Emit(PARTICLE_FLAME, x, y, flames, 1.0f + m_stage * 0.25f);
+}
+
+void Bonfire::SetStage(int resources)
+{
     if (resources <= 50)
     {
-        m_textureID = "bonfire_0";
+        m_stage = 0;
     }
     else if (resources <= 400)
     {
-        m_textureID = "bonfire_1";
+        m_stage = 1;
     }
     else if (resources <= 1000)
     {
-        m_textureID = "bonfire_2";
+        m_stage = 2;
     }
     else if (resources <= 2000)
     {
-        m_textureID = "bonfire_3";
-    }
-    else if (resources > 2000)
-    {
-        m_textureID = "bonfire_4";
+        m_stage = 3;
     }
     else
     {
-        m_textureID = "bonfire_0";
+        m_stage = 4;
     }
+
+    static const char* const STAGE_TEXTURES[STAGE_COUNT] = { "bonfire_0", "bonfire_1", "bonfire_2", "bonfire_3", "bonfire_4" };
+    m_textureID = STAGE_TEXTURES[m_stage];
 }
 
-void Bonfire::Render()
+void Bonfire::Render(RenderSnapshot& snapshot)
 {
-    GameObject::Render();
+    GameObject::Render(snapshot);
 }
 
 void Bonfire::Clean()
 {
     GameObject::Clean();
-}
\ No newline at end of file
+}
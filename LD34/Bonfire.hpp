@@ -1,13 +1,31 @@
 #pragma once
 #include "PCH.hpp"
 #include "GameObject.hpp"
+#include "EventBus.hpp"
 
 class Bonfire : public GameObject
 {
 public:
     Bonfire(Game* game);
+    ~Bonfire();
 
+    void Load(Vector2D position, double width, double height, std::string textureID);
     void Update();
-    void Render();
+    void Render(RenderSnapshot& snapshot);
     void Clean();
-};
\ No newline at end of file
+
+private:
+    // The fire grows with the resources, and only changes when they do
+    void SetStage(int resources);
+
+private:
+    // Flames per second at each stage of the fire
+    static const int STAGE_COUNT = 5;
+    const double FLAME_RATES[STAGE_COUNT] = { 12, 30, 60, 110, 180 };
+
+    int m_stage;
+    double m_flamesDue;
+
+    EventBus::SubscriptionID m_depositSubscription;
+    EventBus::SubscriptionID m_sacrificeSubscription;
+};
@@ -0,0 +1,38 @@
+#pragma once
+#include "PCH.hpp"
+
+// Stackless coroutines in plain C++14, in the style of protothreads. The body
+// of a coroutine sits between CO_BEGIN and CO_END. Suspending stores a resume
+// point in the frame and returns, and the next call jumps straight back to
+// it through the switch that CO_BEGIN opens. Nothing on the stack survives a
+// suspension, so whatever is needed afterwards has to live in the frame or
+// the object, and a switch of the coroutine's own cannot span a suspension.
+//
+// Resume points are numbered with __COUNTER__ rather than __LINE__, which is
+// not a constant for MSVC under /ZI.
+enum CoroutineStatus
+{
+    COROUTINE_SUSPENDED,
+    COROUTINE_DONE
+};
+
+struct CoroutineFrame
+{
+    CoroutineFrame() :
+        resumePoint(0)
+    {
+    }
+
+    int resumePoint;
+};
+
+#define CO_BEGIN(frame) switch ((frame)->resumePoint) { case 0:
+#define CO_END(frame) } (frame)->resumePoint = -1; return COROUTINE_DONE
+
+#define CO_SUSPEND(frame) CO_SUSPEND_AT(frame, __COUNTER__ + 1)
+#define CO_SUSPEND_AT(frame, point) do { (frame)->resumePoint = (point); return COROUTINE_SUSPENDED; case (point):; } while (0)
+
+// Checked again every time the coroutine is resumed
+#define CO_AWAIT(frame, condition) while (!(condition)) CO_SUSPEND(frame)
+
+#define CO_RETURN(frame) do { (frame)->resumePoint = -1; return COROUTINE_DONE; } while (0)
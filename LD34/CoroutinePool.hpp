@@ -0,0 +1,89 @@
+#pragma once
+#include "PCH.hpp"
+#include <new>
+#include <type_traits>
+
+// Coroutine frames of one type, handed out from chunks that are only given
+// back when the pool goes away. Acquiring and releasing push and pop a free
+// list, so starting and finishing coroutines costs no heap traffic once the
+// pool has grown to the most that are ever alive at once.
+template <typename T>
+class CoroutinePool
+{
+public:
+    CoroutinePool() :
+        m_free(nullptr),
+        m_capacity(0),
+        m_inUse(0)
+    {
+    }
+
+    T* Acquire()
+    {
+        if (m_free == nullptr)
+        {
+            Grow();
+        }
+
+        Block* block = m_free;
+        m_free = block->next;
+        m_inUse++;
+        return new (&block->storage) T();
+    }
+
+    void Release(T* frame)
+    {
+        frame->~T();
+
+        Block* block = reinterpret_cast<Block*>(frame);
+        block->next = m_free;
+        m_free = block;
+        m_inUse--;
+    }
+
+    void Reserve(size_t count)
+    {
+        while (m_capacity < count)
+        {
+            Grow();
+        }
+    }
+
+    size_t GetCapacity() const
+    {
+        return m_capacity;
+    }
+
+    size_t GetInUse() const
+    {
+        return m_inUse;
+    }
+
+private:
+    union Block
+    {
+        Block* next;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    };
+
+    void Grow()
+    {
+        std::unique_ptr<Block[]> chunk(new Block[CHUNK_SIZE]);
+        for (size_t i = 0; i < CHUNK_SIZE; i++)
+        {
+            chunk[i].next = (i + 1 < CHUNK_SIZE) ? &chunk[i + 1] : m_free;
+        }
+
+        m_free = &chunk[0];
+        m_chunks.push_back(std::move(chunk));
+        m_capacity += CHUNK_SIZE;
+    }
+
+private:
+    static const size_t CHUNK_SIZE = 256;
+
+    std::vector<std::unique_ptr<Block[]>> m_chunks;
+    Block* m_free;
+    size_t m_capacity;
+    size_t m_inUse;
+};
@@ -0,0 +1,80 @@
+#include "PCH.hpp"
+#include "CpuMeter.hpp"
+
+#if WINDOWS
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+
+CpuMeter::CpuMeter() :
+    m_startCpu(0),
+    m_startWall(0),
+    m_lastCpu(0),
+    m_lastWall(0),
+    m_usage(0)
+{
+}
+
+void CpuMeter::Start()
+{
+    m_startCpu = GetProcessTime();
+    m_startWall = GetWallTime();
+    m_lastCpu = m_startCpu;
+    m_lastWall = m_startWall;
+    m_usage = 0;
+}
+
+void CpuMeter::Update()
+{
+    double wall = GetWallTime();
+    if (wall - m_lastWall < SAMPLE_TIME)
+    {
+        return;
+    }
+
+    double cpu = GetProcessTime();
+    m_usage = (cpu - m_lastCpu) / (wall - m_lastWall);
+    m_lastCpu = cpu;
+    m_lastWall = wall;
+}
+
+double CpuMeter::GetUsage() const
+{
+    return m_usage;
+}
+
+double CpuMeter::GetAverage() const
+{
+    double wall = GetWallTime() - m_startWall;
+    return (wall > 0) ? (GetProcessTime() - m_startCpu) / wall : 0.0;
+}
+
+double CpuMeter::GetProcessTime()
+{
+#if WINDOWS
+    // Kernel and user time come in 100 ns units
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+    {
+        return 0.0;
+    }
+
+    ULARGE_INTEGER kernelTime = { { kernel.dwLowDateTime, kernel.dwHighDateTime } };
+    ULARGE_INTEGER userTime = { { user.dwLowDateTime, user.dwHighDateTime } };
+    return (double)(kernelTime.QuadPart + userTime.QuadPart) / 10000000.0;
+#else
+    timespec time;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time) != 0)
+    {
+        return 0.0;
+    }
+
+    return time.tv_sec + time.tv_nsec / 1000000000.0;
+#endif
+}
+
+double CpuMeter::GetWallTime()
+{
+    return (double)SDL_GetPerformanceCounter() / SDL_GetPerformanceFrequency();
+}
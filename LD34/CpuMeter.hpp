@@ -0,0 +1,32 @@
+#pragma once
+#include "PCH.hpp"
+
+// CPU time the whole process uses per second of wall time, counting every
+// thread, so 1.0 is one core kept busy. Reads the clocks at most once per
+// SAMPLE_TIME, so it is cheap to update every frame.
+class CpuMeter
+{
+public:
+    CpuMeter();
+
+    void Start();
+    void Update();
+
+    // Over the last sample, and since Start()
+    double GetUsage() const;
+    double GetAverage() const;
+
+private:
+    // Seconds of CPU used by the process so far
+    static double GetProcessTime();
+    static double GetWallTime();
+
+private:
+    const double SAMPLE_TIME = 1.0;
+
+    double m_startCpu;
+    double m_startWall;
+    double m_lastCpu;
+    double m_lastWall;
+    double m_usage;
+};
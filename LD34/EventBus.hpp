@@ -0,0 +1,112 @@
+#pragma once
+#include "PCH.hpp"
+#include <atomic>
+#include <functional>
+
+// Typed publish/subscribe. Any struct can be an event; handlers subscribe to
+// one event type and are called in subscription order, synchronously, from
+// Publish(). Each event type gets its own handler list, so publishing an
+// event nobody listens to costs a bounds check.
+class EventBus
+{
+public:
+    typedef uint32_t SubscriptionID;
+
+    template <typename E>
+    SubscriptionID Subscribe(std::function<void(const E&)> handler)
+    {
+        Handler<E> entry;
+        entry.id = ++m_lastID;
+        entry.function = std::move(handler);
+        GetList<E>().handlers.push_back(std::move(entry));
+
+        return entry.id;
+    }
+
+    template <typename E>
+    void Unsubscribe(SubscriptionID id)
+    {
+        std::vector<Handler<E>>& handlers = GetList<E>().handlers;
+        for (size_t i = 0; i < handlers.size(); i++)
+        {
+            if (handlers[i].id == id)
+            {
+                handlers.erase(handlers.begin() + i);
+                return;
+            }
+        }
+    }
+
+    template <typename E>
+    void Publish(const E& event)
+    {
+        size_t type = TypeIndex<E>();
+        if (type >= m_lists.size() || !m_lists[type])
+        {
+            return;
+        }
+
+        // Handlers must not change the subscriptions to the event being
+        // published from inside the call
+        std::vector<Handler<E>>& handlers = static_cast<HandlerList<E>*>(m_lists[type].get())->handlers;
+        for (size_t i = 0; i < handlers.size(); i++)
+        {
+            handlers[i].function(event);
+        }
+    }
+
+private:
+    template <typename E>
+    struct Handler
+    {
+        SubscriptionID id;
+        std::function<void(const E&)> function;
+    };
+
+    struct HandlerListBase
+    {
+        virtual ~HandlerListBase() {}
+    };
+
+    template <typename E>
+    struct HandlerList : public HandlerListBase
+    {
+        std::vector<Handler<E>> handlers;
+    };
+
+    // Shared by every bus, which may live on different threads
+    static size_t NextTypeIndex()
+    {
+        static std::atomic<size_t> next(0);
+        return next++;
+    }
+
+    // Dense index per event type, assigned the first time the type is used
+    template <typename E>
+    static size_t TypeIndex()
+    {
+        static const size_t index = NextTypeIndex();
+        return index;
+    }
+
+    template <typename E>
+    HandlerList<E>& GetList()
+    {
+        size_t type = TypeIndex<E>();
+        if (type >= m_lists.size())
+        {
+            m_lists.resize(type + 1);
+        }
+
+        if (!m_lists[type])
+        {
+            m_lists[type].reset(new HandlerList<E>());
+        }
+
+        return *static_cast<HandlerList<E>*>(m_lists[type].get());
+    }
+
+private:
+    std::vector<std::unique_ptr<HandlerListBase>> m_lists;
+    SubscriptionID m_lastID = 0;
+};
@@ -0,0 +1,277 @@
+#include "PCH.hpp"
+#include "FlowField.hpp"
+#include <functional>
+
+const uint32_t FlowField::UNREACHABLE;
+const uint8_t FlowField::NO_DEPOT;
+
+// Straight neighbours first, so ties go to the straight step
+static const int NEIGHBORS[8][2] =
+{
+    { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 },
+    { 1, 1 }, { -1, 1 }, { 1, -1 }, { -1, -1 }
+};
+
+FlowField::FlowField(int width, int height, int cellSize) :
+    m_cellSize(cellSize),
+    m_columns(width / cellSize + 1),
+    m_rows(height / cellSize + 1),
+    m_obstaclesChanged(false),
+    m_depotsChanged(false),
+    m_refreshes(0)
+{
+    size_t count = (size_t)m_columns * m_rows;
+    m_blockers.assign(count, 0);
+    m_cost.assign(count, UNREACHABLE);
+    m_nearest.assign(count, NO_DEPOT);
+    m_next.assign(count, -1);
+}
+
+void FlowField::AddDepot(Handle depot, Vector2D position)
+{
+    if (m_depots.size() >= NO_DEPOT)
+    {
+        return;
+    }
+
+    Depot entry;
+    entry.handle = depot;
+    entry.cell = CellAt(position);
+    m_depots.push_back(entry);
+    m_depotsChanged = true;
+}
+
+void FlowField::RemoveDepot(Handle depot)
+{
+    for (std::vector<Depot>::iterator it = m_depots.begin(); it != m_depots.end(); it++)
+    {
+        if (it->handle == depot)
+        {
+            m_depots.erase(it);
+            m_depotsChanged = true;
+            return;
+        }
+    }
+}
+
+void FlowField::AddObstacle(Vector2D position)
+{
+    ChangeObstacle(position, 1);
+}
+
+void FlowField::RemoveObstacle(Vector2D position)
+{
+    ChangeObstacle(position, -1);
+}
+
+void FlowField::Refresh()
+{
+    if (!m_obstaclesChanged && !m_depotsChanged)
+    {
+        return;
+    }
+
+    // New obstacles reroute every depot's field, while a new depot only
+    // needs its own, and losing one none at all. The open list is shared, as
+    // it is empty again after each.
+    ArenaVector<uint64_t> open(FrameArena::ForThisThread());
+    for (std::vector<Depot>::iterator it = m_depots.begin(); it != m_depots.end(); it++)
+    {
+        if (m_obstaclesChanged || it->cost.empty())
+        {
+            Integrate(*it, open);
+        }
+    }
+
+    Combine();
+    m_obstaclesChanged = false;
+    m_depotsChanged = false;
+    m_refreshes++;
+}
+
+FlowField::Route FlowField::Lookup(Vector2D position) const
+{
+    Route route;
+    route.arrived = false;
+    route.waypoint = position;
+
+    int cell = CellAt(position);
+    uint8_t nearest = m_nearest[cell];
+    if (nearest == NO_DEPOT || nearest >= m_depots.size())
+    {
+        return route;
+    }
+
+    route.depot = m_depots[nearest].handle;
+    int next = m_next[cell];
+    if (next < 0)
+    {
+        route.arrived = true;
+    }
+    else
+    {
+        route.waypoint = Vector2D((next % m_columns + 0.5) * m_cellSize, (next / m_columns + 0.5) * m_cellSize);
+    }
+
+    return route;
+}
+
+int FlowField::GetRefreshCount() const
+{
+    return m_refreshes;
+}
+
+int FlowField::CellAt(Vector2D position) const
+{
+    int column = std::min(std::max((int)(position.GetX() / m_cellSize), 0), m_columns - 1);
+    int row = std::min(std::max((int)(position.GetY() / m_cellSize), 0), m_rows - 1);
+
+    return row * m_columns + column;
+}
+
+bool FlowField::IsOpen(int column, int row) const
+{
+    if (column < 0 || row < 0 || column >= m_columns || row >= m_rows)
+    {
+        return false;
+    }
+
+    return m_blockers[row * m_columns + column] == 0;
+}
+
+void FlowField::ChangeObstacle(Vector2D position, int change)
+{
+    int half = OBSTACLE_SIZE / 2;
+    int firstColumn = std::max((int)std::floor((position.GetX() - half) / m_cellSize), 0);
+    int firstRow = std::max((int)std::floor((position.GetY() - half) / m_cellSize), 0);
+    int lastColumn = std::min((int)std::floor((position.GetX() + half - 1) / m_cellSize), m_columns - 1);
+    int lastRow = std::min((int)std::floor((position.GetY() + half - 1) / m_cellSize), m_rows - 1);
+
+    for (int row = firstRow; row <= lastRow; row++)
+    {
+        for (int column = firstColumn; column <= lastColumn; column++)
+        {
+            // Only a cell that opens up or closes changes any route
+            uint8_t& blockers = m_blockers[row * m_columns + column];
+            bool wasOpen = (blockers == 0);
+            blockers = (uint8_t)std::max((int)blockers + change, 0);
+            if (wasOpen != (blockers == 0))
+            {
+                m_obstaclesChanged = true;
+            }
+        }
+    }
+}
+
+void FlowField::Integrate(Depot& depot, ArenaVector<uint64_t>& open)
+{
+    // Dijkstra out from the depot. Diagonal steps may not cut the corner of
+    // a blocked cell.
+    depot.cost.assign(m_cost.size(), UNREACHABLE);
+    depot.cost[depot.cell] = 0;
+
+    // Entries are the cost in the high half and the cell in the low half,
+    // so the smallest entry is the cheapest cell. Stale ones are skipped.
+    open.reserve(m_cost.size() * 8);
+    open.push_back((uint64_t)depot.cell);
+
+    while (!open.empty())
+    {
+        std::pop_heap(open.begin(), open.end(), std::greater<uint64_t>());
+        uint64_t entry = open.back();
+        open.pop_back();
+
+        uint32_t cost = (uint32_t)(entry >> 32);
+        int cell = (int)(entry & 0xffffffff);
+        if (cost > depot.cost[cell])
+        {
+            continue;
+        }
+
+        int column = cell % m_columns;
+        int row = cell / m_columns;
+        for (int i = 0; i < 8; i++)
+        {
+            int neighborColumn = column + NEIGHBORS[i][0];
+            int neighborRow = row + NEIGHBORS[i][1];
+            bool diagonal = (NEIGHBORS[i][0] != 0 && NEIGHBORS[i][1] != 0);
+            if (!IsOpen(neighborColumn, neighborRow) ||
+                (diagonal && (!IsOpen(neighborColumn, row) || !IsOpen(column, neighborRow))))
+            {
+                continue;
+            }
+
+            int neighbor = neighborRow * m_columns + neighborColumn;
+            uint32_t next = cost + (diagonal ? DIAGONAL_COST : STRAIGHT_COST);
+            if (next < depot.cost[neighbor])
+            {
+                depot.cost[neighbor] = next;
+                open.push_back(((uint64_t)next << 32) | (uint64_t)neighbor);
+                std::push_heap(open.begin(), open.end(), std::greater<uint64_t>());
+            }
+        }
+    }
+}
+
+void FlowField::Combine()
+{
+    size_t count = m_cost.size();
+    for (size_t cell = 0; cell < count; cell++)
+    {
+        uint32_t best = UNREACHABLE;
+        uint8_t nearest = NO_DEPOT;
+        for (size_t d = 0; d < m_depots.size(); d++)
+        {
+            if (m_depots[d].cost[cell] < best)
+            {
+                best = m_depots[d].cost[cell];
+                nearest = (uint8_t)d;
+            }
+        }
+
+        m_cost[cell] = best;
+        m_nearest[cell] = nearest;
+    }
+
+    // Head for the cheapest neighbour that can be walked into. Blocked cells
+    // get a way out too, for anyone who ends up standing in one.
+    for (size_t cell = 0; cell < count; cell++)
+    {
+        m_next[cell] = -1;
+        if (m_cost[cell] == 0)
+        {
+            continue;
+        }
+
+        int column = (int)cell % m_columns;
+        int row = (int)cell / m_columns;
+        uint32_t best = m_cost[cell];
+        for (int i = 0; i < 8; i++)
+        {
+            int neighborColumn = column + NEIGHBORS[i][0];
+            int neighborRow = row + NEIGHBORS[i][1];
+            if (neighborColumn < 0 || neighborRow < 0 || neighborColumn >= m_columns || neighborRow >= m_rows)
+            {
+                continue;
+            }
+
+            bool diagonal = (NEIGHBORS[i][0] != 0 && NEIGHBORS[i][1] != 0);
+            if (diagonal && (!IsOpen(neighborColumn, row) || !IsOpen(column, neighborRow)))
+            {
+                continue;
+            }
+
+            int neighbor = neighborRow * m_columns + neighborColumn;
+            if (m_cost[neighbor] < best)
+            {
+                best = m_cost[neighbor];
+                m_next[cell] = neighbor;
+            }
+        }
+
+        if (m_cost[cell] == UNREACHABLE && m_next[cell] >= 0)
+        {
+            m_nearest[cell] = m_nearest[m_next[cell]];
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "PCH.hpp"
+#include "Handle.hpp"
+#include "Vector2D.hpp"
+#include "FrameArena.hpp"
+
+// Routes from anywhere in the world to the nearest depot, over a coarse grid.
+// Every depot has its own integration field: the cost of walking from each
+// cell to it, around blocked cells. These are folded into one field saying,
+// per cell, which depot is nearest and which neighbouring cell leads there,
+// so finding the way home is a single lookup. Changes to depots or obstacles
+// only mark the fields stale; Refresh() redoes what they touched, at most
+// once a tick however many changes came in.
+class FlowField
+{
+public:
+    FlowField(int width, int height, int cellSize);
+
+    void AddDepot(Handle depot, Vector2D position);
+    void RemoveDepot(Handle depot);
+
+    // Blocks the cells under a square around position. Counted per cell, so
+    // overlapping obstacles can come and go in any order.
+    void AddObstacle(Vector2D position);
+    void RemoveObstacle(Vector2D position);
+
+    void Refresh();
+
+    struct Route
+    {
+        // Null when no depot can be reached from here
+        Handle depot;
+
+        // In the depot's own cell, so the rest of the way is a straight line
+        bool arrived;
+
+        // Centre of the next cell on the way otherwise
+        Vector2D waypoint;
+    };
+
+    Route Lookup(Vector2D position) const;
+
+    // How many times the fields were brought up to date
+    int GetRefreshCount() const;
+
+private:
+    struct Depot
+    {
+        Handle handle;
+        int cell;
+
+        // Walking cost from every cell, empty until integrated
+        std::vector<uint32_t> cost;
+    };
+
+    int CellAt(Vector2D position) const;
+    bool IsOpen(int column, int row) const;
+    void ChangeObstacle(Vector2D position, int change);
+    void Integrate(Depot& depot, ArenaVector<uint64_t>& open);
+    void Combine();
+
+private:
+    static const uint32_t UNREACHABLE = 0xffffffff;
+    static const uint8_t NO_DEPOT = 0xff;
+    static const int STRAIGHT_COST = 10;
+    static const int DIAGONAL_COST = 14;
+    static const int OBSTACLE_SIZE = 16;
+
+    int m_cellSize;
+    int m_columns;
+    int m_rows;
+
+    std::vector<Depot> m_depots;
+    std::vector<uint8_t> m_blockers;
+
+    // The folded field: cost to and index of the nearest depot, and the
+    // cell to head for next, or -1 in a depot's cell or out of reach
+    std::vector<uint32_t> m_cost;
+    std::vector<uint8_t> m_nearest;
+    std::vector<int> m_next;
+
+    bool m_obstaclesChanged;
+    bool m_depotsChanged;
+    int m_refreshes;
+};
@@ -0,0 +1,134 @@
+#include "PCH.hpp"
+#include "Formation.hpp"
+#include "FrameArena.hpp"
+
+static const double TWO_PI = 2.0 * 3.14159265358979;
+
+// Rises with the angle around the centre like atan2 does, from 0 up to 4,
+// without any trigonometry
+static float PseudoAngle(float dx, float dy)
+{
+    float sum = std::fabs(dx) + std::fabs(dy);
+    if (sum == 0)
+    {
+        return 0;
+    }
+
+    float p = dx / sum;
+    return (dy < 0) ? 3 + p : 1 - p;
+}
+
+// Fills order with 0 to count - 1 sorted by angle, with a bucket for every
+// four points on average, which keeps the counts small enough to stay in the
+// cache. Points sharing a bucket stay in index order.
+static void SortByAngle(const float* angles, int count, int* order, FrameArena& arena)
+{
+    int buckets = std::max(count / 4, 1);
+    int* starts = arena.AllocateArray<int>(buckets + 1);
+    int* keys = arena.AllocateArray<int>(count);
+    std::fill(starts, starts + buckets + 1, 0);
+
+    for (int i = 0; i < count; i++)
+    {
+        keys[i] = std::min((int)(angles[i] * buckets / 4), buckets - 1);
+        starts[keys[i] + 1]++;
+    }
+
+    for (int b = 0; b < buckets; b++)
+    {
+        starts[b + 1] += starts[b];
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        order[starts[keys[i]]++] = i;
+    }
+}
+
+Formation::Formation(float spacing) :
+    m_spacing(spacing)
+{
+}
+
+void Formation::Assign(float centerX, float centerY, const float* xs, const float* ys, int count, float* spotXs, float* spotYs) const
+{
+    if (count <= 0)
+    {
+        return;
+    }
+
+    FrameArena& arena = FrameArena::ForThisThread();
+    float* ringXs = arena.AllocateArray<float>(count);
+    float* ringYs = arena.AllocateArray<float>(count);
+    float* spotAngles = arena.AllocateArray<float>(count);
+    float* memberAngles = arena.AllocateArray<float>(count);
+    int* spotOrder = arena.AllocateArray<int>(count);
+    int* memberOrder = arena.AllocateArray<int>(count);
+
+    // The middle, then ring after ring. The last ring only gets as many spots
+    // as are left, spread evenly around it, and every other ring is turned
+    // half a step so the spots sit between those of the ring inside.
+    ringXs[0] = centerX;
+    ringYs[0] = centerY;
+    spotAngles[0] = 0;
+    int placed = 1;
+    for (int ring = 1; placed < count; ring++)
+    {
+        int spots = std::min((int)(TWO_PI * ring), count - placed);
+        double radius = ring * m_spacing;
+        double step = TWO_PI / spots;
+        double start = (ring % 2 == 1) ? step / 2 : 0;
+
+        // Turn a unit vector around the ring instead of calling cos and sin
+        // for every spot
+        double stepX = std::cos(step);
+        double stepY = std::sin(step);
+        double dirX = std::cos(start);
+        double dirY = std::sin(start);
+        for (int i = 0; i < spots; i++)
+        {
+            ringXs[placed] = (float)(centerX + dirX * radius);
+            ringYs[placed] = (float)(centerY + dirY * radius);
+            spotAngles[placed] = PseudoAngle((float)dirX, (float)dirY);
+            placed++;
+
+            double nextX = dirX * stepX - dirY * stepY;
+            dirY = dirX * stepY + dirY * stepX;
+            dirX = nextX;
+        }
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        memberAngles[i] = PseudoAngle(xs[i] - centerX, ys[i] - centerY);
+    }
+
+    SortByAngle(spotAngles, count, spotOrder, arena);
+    SortByAngle(memberAngles, count, memberOrder, arena);
+
+    // Start with the spot closest to the first member's bearing, and hand
+    // out the rest in the same turning order
+    float firstAngle = memberAngles[memberOrder[0]];
+    int offset = 0;
+    float bestGap = 5;
+    for (int i = 0; i < count; i++)
+    {
+        float gap = std::fabs(spotAngles[spotOrder[i]] - firstAngle);
+        gap = std::min(gap, 4 - gap);
+        if (gap < bestGap)
+        {
+            bestGap = gap;
+            offset = i;
+        }
+    }
+
+    int next = offset;
+    for (int i = 0; i < count; i++)
+    {
+        int spot = spotOrder[next];
+        int member = memberOrder[i];
+        spotXs[member] = ringXs[spot];
+        spotYs[member] = ringYs[spot];
+        next = (next + 1 < count) ? next + 1 : 0;
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "PCH.hpp"
+
+// Spreads a group over distinct spots around a point: one in the middle,
+// then rings spacing apart with as many spots as fit around each. Both the
+// group and the spots are sorted by their angle around the point, with a
+// counting sort, and paired off in that order starting from the spot nearest
+// the first member's bearing. Everyone keeps roughly the side they came from
+// and nobody shares a spot, in time linear in the size of the group.
+class Formation
+{
+public:
+    Formation(float spacing);
+
+    // Picks a spot for each of count points at xs/ys and writes it to the
+    // same index of spotXs/spotYs, which may be xs/ys themselves. Scratch
+    // space comes from the frame arena.
+    void Assign(float centerX, float centerY, const float* xs, const float* ys, int count, float* spotXs, float* spotYs) const;
+
+private:
+    float m_spacing;
+};
@@ -0,0 +1,88 @@
+#include "PCH.hpp"
+#include "FrameArena.hpp"
+#include "AllocationCounter.hpp"
+#include "MemoryTracker.hpp"
+
+const size_t FrameArena::DEFAULT_CAPACITY;
+
+FrameArena::FrameArena(size_t capacity) :
+    m_capacity(capacity),
+    m_cursor(nullptr),
+    m_end(nullptr),
+    m_used(0),
+    m_highWater(0)
+{
+}
+
+void FrameArena::Reset()
+{
+    m_highWater = std::max(m_highWater, m_used);
+
+    // Grow into a single block that holds the whole of the busiest frame
+    if (!m_overflow.empty())
+    {
+        while (m_capacity < m_highWater)
+        {
+            m_capacity *= 2;
+        }
+
+        // Zeroed so the pages are mapped now, during warm-up, instead of by
+        // whichever later frame first reaches past the old peak
+        MEMORY_SCOPE(MEMORY_FRAME);
+        AllocationExemption exemption;
+        m_overflow.clear();
+        m_block.reset(new uint8_t[m_capacity]());
+    }
+
+    m_cursor = m_block.get();
+    m_end = m_cursor + (m_cursor != nullptr ? m_capacity : 0);
+    m_used = 0;
+}
+
+size_t FrameArena::GetUsed() const
+{
+    return m_used;
+}
+
+size_t FrameArena::GetCapacity() const
+{
+    return m_capacity;
+}
+
+size_t FrameArena::GetHighWater() const
+{
+    return std::max(m_highWater, m_used);
+}
+
+FrameArena& FrameArena::ForThisThread()
+{
+    static thread_local FrameArena arena;
+    return arena;
+}
+
+void* FrameArena::AllocateSlow(size_t size, size_t alignment)
+{
+    // Like adding objects to the world, growing is allowed after warm-up,
+    // and only happens until the arena has seen its busiest frame
+    MEMORY_SCOPE(MEMORY_FRAME);
+    AllocationExemption exemption;
+
+    size_t blockSize = std::max(m_capacity, size + alignment);
+    uint8_t* block = new uint8_t[blockSize];
+    if (m_block == nullptr)
+    {
+        m_capacity = blockSize;
+        m_block.reset(block);
+    }
+    else
+    {
+        m_overflow.emplace_back(block);
+    }
+
+    // The rest of the old block is wasted, but still counted as used so the
+    // next block is sized for it
+    m_used += m_end - m_cursor;
+    m_cursor = block;
+    m_end = block + blockSize;
+    return Allocate(size, alignment);
+}
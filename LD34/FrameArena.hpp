@@ -0,0 +1,123 @@
+#pragma once
+#include "PCH.hpp"
+
+// Bump allocator for data that only lives until the end of a frame or tick.
+// Allocating moves a pointer and freeing does nothing; Reset() takes it all
+// back at once. A frame that outgrows the block borrows more from the heap,
+// and the next Reset() swaps them for one block big enough for the peak, so
+// after warm-up the arena stops touching the heap.
+//
+// Nothing is destroyed on Reset(), so only put trivially destructible data
+// in it, or containers whose destructors have already run.
+class FrameArena
+{
+public:
+    FrameArena(size_t capacity = DEFAULT_CAPACITY);
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* Allocate(size_t size, size_t alignment);
+
+    template<typename T>
+    T* AllocateArray(size_t count)
+    {
+        return (T*)Allocate(count * sizeof(T), alignof(T));
+    }
+
+    // Everything allocated since the last reset is gone after this
+    void Reset();
+
+    size_t GetUsed() const;
+    size_t GetCapacity() const;
+
+    // Most bytes in use between two resets, padding included
+    size_t GetHighWater() const;
+
+    // The arena of the calling thread, reset by whichever loop runs on it
+    static FrameArena& ForThisThread();
+
+private:
+    void* AllocateSlow(size_t size, size_t alignment);
+
+private:
+    static const size_t DEFAULT_CAPACITY = 64 * 1024;
+
+    std::unique_ptr<uint8_t[]> m_block;
+    size_t m_capacity;
+
+    // Blocks borrowed this frame after m_block ran out
+    std::vector<std::unique_ptr<uint8_t[]>> m_overflow;
+
+    uint8_t* m_cursor;
+    uint8_t* m_end;
+    size_t m_used;
+    size_t m_highWater;
+};
+
+inline void* FrameArena::Allocate(size_t size, size_t alignment)
+{
+    uintptr_t start = ((uintptr_t)m_cursor + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if (m_cursor == nullptr || start + size > (uintptr_t)m_end)
+    {
+        return AllocateSlow(size, alignment);
+    }
+
+    m_used += start + size - (uintptr_t)m_cursor;
+    m_cursor = (uint8_t*)(start + size);
+    return (void*)start;
+}
+
+// Lets standard containers allocate from an arena. Freeing is a no-op, so a
+// container that grows leaves its old buffers behind until the reset; reserve
+// up front where the size is known.
+template<typename T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    ArenaAllocator(FrameArena& arena) :
+        m_arena(&arena)
+    {
+    }
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) :
+        m_arena(other.GetArena())
+    {
+    }
+
+    T* allocate(size_t count)
+    {
+        return m_arena->AllocateArray<T>(count);
+    }
+
+    void deallocate(T*, size_t)
+    {
+    }
+
+    FrameArena* GetArena() const
+    {
+        return m_arena;
+    }
+
+private:
+    FrameArena* m_arena;
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+    return a.GetArena() == b.GetArena();
+}
+
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+    return a.GetArena() != b.GetArena();
+}
+
+// Must not outlive the reset of its arena
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
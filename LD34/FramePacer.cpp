@@ -0,0 +1,98 @@
+#include "PCH.hpp"
+#include "FramePacer.hpp"
+#include <thread>
+
+FramePacer::FramePacer() :
+    m_period(1000.0 / 60),
+    m_deadline(0),
+    m_frameStart(0),
+    m_workIndex(0),
+    m_missedDeadlines(0)
+{
+    for (int i = 0; i < HISTORY_SIZE; i++)
+    {
+        m_workTimes[i] = 0;
+    }
+}
+
+void FramePacer::SetRefreshRate(int hz)
+{
+    m_period = 1000.0 / ((hz > 0) ? hz : 60);
+}
+
+void FramePacer::Wait()
+{
+    if (m_deadline == 0)
+    {
+        m_deadline = Now() + m_period;
+    }
+
+    SleepUntil(m_deadline - GetWorkEstimate() - SAFETY_MARGIN);
+    m_frameStart = Now();
+}
+
+void FramePacer::FrameDone()
+{
+    double now = Now();
+    m_workTimes[m_workIndex] = now - m_frameStart;
+    m_workIndex = (m_workIndex + 1) % HISTORY_SIZE;
+
+    // After a miss, start counting from now rather than trying to catch up
+    if (now > m_deadline)
+    {
+        m_missedDeadlines++;
+        m_deadline = now + m_period;
+    }
+    else
+    {
+        m_deadline += m_period;
+    }
+}
+
+void FramePacer::Resume()
+{
+    m_frameStart = Now();
+    m_deadline = m_frameStart + m_period;
+}
+
+double FramePacer::GetWorkEstimate() const
+{
+    double slowest = 0;
+    for (int i = 0; i < HISTORY_SIZE; i++)
+    {
+        slowest = std::max(slowest, m_workTimes[i]);
+    }
+
+    return std::min(slowest, m_period);
+}
+
+uint64_t FramePacer::GetMissedDeadlines() const
+{
+    return m_missedDeadlines;
+}
+
+double FramePacer::Now() const
+{
+    return SDL_GetPerformanceCounter() * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+void FramePacer::SleepUntil(double time)
+{
+    for (;;)
+    {
+        double remaining = time - Now();
+        if (remaining <= 0)
+        {
+            break;
+        }
+
+        if (remaining > SPIN_TIME)
+        {
+            SDL_Delay((Uint32)(remaining - SPIN_TIME));
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "PCH.hpp"
+
+// Paces frames to the display refresh without vsync. Instead of rendering
+// straight away and blocking in present until the vblank, the loop sleeps
+// first and only starts the frame when there is just enough time left to
+// sample input, update, render and present before the next deadline. How
+// long that takes is estimated from the slowest of the recent frames.
+class FramePacer
+{
+public:
+    FramePacer();
+
+    void SetRefreshRate(int hz);
+
+    // Sleep until it is time to start the next frame
+    void Wait();
+
+    // Call right after the frame has been presented
+    void FrameDone();
+
+    // Start a frame now without waiting, after a stretch of skipped frames
+    // that would otherwise count as missed deadlines
+    void Resume();
+
+    double GetWorkEstimate() const;
+    uint64_t GetMissedDeadlines() const;
+
+private:
+    double Now() const;
+    void SleepUntil(double time);
+
+private:
+    static const int HISTORY_SIZE = 30;
+
+    // Slack left before the deadline, and how close to the wake-up time we
+    // stop trusting SDL_Delay() and yield instead
+    const double SAFETY_MARGIN = 1.0;
+    const double SPIN_TIME = 2.0;
+
+    double m_period;
+    double m_deadline;
+    double m_frameStart;
+    double m_workTimes[HISTORY_SIZE];
+    int m_workIndex;
+    uint64_t m_missedDeadlines;
+};
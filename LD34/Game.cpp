@@ -1,37 +1,174 @@
 #include "PCH.hpp"
 #include "Game.hpp"
+#include "Logger.hpp"
 #include "Vector2D.hpp"
+#include "AllocationCounter.hpp"
+#include "MemoryTracker.hpp"
+#include <fstream>
 
-Game::Game() :
+// FNV-1a over the bytes of a value
+template <typename T>
+static uint32_t HashValue(uint32_t hash, const T& value)
+{
+    const uint8_t* bytes = (const uint8_t*)&value;
+    for (size_t i = 0; i < sizeof(T); i++)
+    {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+// Rough size of a texture's pixel data, assuming 32 bits per pixel
+static int64_t TextureBytes(SDL_Texture* texture)
+{
+    int width = 0;
+    int height = 0;
+    if (texture == nullptr || SDL_QueryTexture(texture, NULL, NULL, &width, &height) != 0)
+    {
+        return 0;
+    }
+
+    return (int64_t)width * height * 4;
+}
+
+// The first bonfire sits in the middle, and any others in the corners
+static const int MAX_BONFIRES = 5;
+static const int BONFIRE_POSITIONS[MAX_BONFIRES][2] =
+{
+    { 304, 224 }, { 64, 64 }, { 544, 64 }, { 64, 384 }, { 544, 384 }
+};
+
+HudLabel::HudLabel() :
+    value(-1),
+    width(0)
+{
+    // As long as RefreshLabels() formats into, so refreshing never allocates
+    text.reserve(32);
+}
+
+PeonSample::PeonSample(FrameArena& arena) :
+    x(arena),
+    y(arena),
+    states(arena)
+{
+}
+
+Game::Game(const GameOptions& options) :
     m_deltaTime(0.0),
+    m_options(options),
+    mouseX(0),
+    mouseY(0),
     m_isRunning(true),
+    m_exitCode(0),
+    m_window(nullptr),
+    m_renderer(nullptr),
+    m_time(0),
+    m_tick(0),
+    m_localPlayer(0),
+    m_stepAccumulator(0),
+    m_oldestInput(0),
+    m_inputDueTick(0),
+    m_hasInput(false),
+    m_shownInput(0),
+    m_inputSequence(0),
+    m_presentedInput(0),
+    m_framesDrawn(0),
+    m_perfOverlay(this),
+    m_drawCalls(0),
+    m_textureSwitches(0),
+    m_lastTexture(nullptr),
+    m_telemetryTime(0),
+    m_frameTexture(nullptr),
+    m_dumpFile(nullptr),
+    m_framesRendered(0),
+    m_glyphTexture(nullptr),
+    m_soundOverflows(0),
+    m_soundsPlayed(0),
+    m_soundsDropped(0),
+    m_flowField(WINDOW_WIDTH, WINDOW_HEIGHT, 16),
+    m_staticVersion(0),
+    m_lastWakeTicket(0),
+    m_parkedObjects(0),
+    m_objectUpdates(0),
+    m_peonCount(0),
+    m_treeCount(0),
+    m_stoneCount(0),
+    m_otherCount(0),
+    m_coarseObjects(0),
+    m_resourceIndex(WINDOW_WIDTH, WINDOW_HEIGHT, 64),
+    m_neighborGrid(SEPARATION_RADIUS),
+    m_formation(SEPARATION_RADIUS),
+    m_slowestOrder(0),
+    m_slowestOrderPeons(0),
     m_resources(0),
-    m_peons(0)
+    m_resourcesGathered(0),
+    m_peons(0),
+    m_random(options.seed)
 {
+    m_peonsToSpawn = m_options.initialPeons;
+    m_regrowTimer.SetClock(&m_time);
+
+    // The whole map is on screen for now
+    m_viewRect.x = 0;
+    m_viewRect.y = 0;
+    m_viewRect.w = WINDOW_WIDTH;
+    m_viewRect.h = WINDOW_HEIGHT;
 }
 
 Game::~Game()
 {
-    m_gameObjects.clear();
+    m_gameObjects.Clear();
 
     std::map<std::string, SDL_Texture*>::const_iterator texIt;
     for (texIt = m_textureMap.begin(); texIt != m_textureMap.end(); texIt++)
     {
+        MEMORY_UNTRACK(MEMORY_TEXTURES, TextureBytes(texIt->second));
         SDL_DestroyTexture(texIt->second);
     }
 
+    if (m_glyphTexture != nullptr)
+    {
+        MEMORY_UNTRACK(MEMORY_TEXTURES, TextureBytes(m_glyphTexture));
+        SDL_DestroyTexture(m_glyphTexture);
+    }
+
+    if (m_softwareRenderer)
+    {
+        MEMORY_UNTRACK(MEMORY_TEXTURES, m_softwareRenderer->GetImageBytes());
+        m_softwareRenderer.reset();
+    }
+
+    if (m_dumpFile != nullptr)
+    {
+        std::fclose(m_dumpFile);
+    }
+
     std::map<std::string, TTF_Font*>::const_iterator fontIt;
     for (fontIt = m_fontMap.begin(); fontIt != m_fontMap.end(); fontIt++)
     {
+        MEMORY_UNTRACK(MEMORY_FONTS, m_fontSizes[fontIt->first]);
         TTF_CloseFont(fontIt->second);
     }
 
-    std::map<std::string, Mix_Chunk*>::const_iterator soundIt;
-    for (soundIt = m_soundMap.begin(); soundIt != m_soundMap.end(); soundIt++)
+    std::vector<Mix_Chunk*>::const_iterator soundIt;
+    for (soundIt = m_sounds.begin(); soundIt != m_sounds.end(); soundIt++)
+    {
+        MEMORY_UNTRACK(MEMORY_SOUNDS, (*soundIt)->alen);
+        Mix_FreeChunk(*soundIt);
+    }
+
+    if (m_options.headless)
     {
-        Mix_FreeChunk(soundIt->second);
+        if (m_options.software)
+        {
+            TTF_Quit();
+            IMG_Quit();
+        }
+        return;
     }
 
+    SDL_DestroyTexture(m_frameTexture);
     SDL_DestroyRenderer(m_renderer);
     SDL_DestroyWindow(m_window);
 
@@ -40,126 +177,96 @@ Game::~Game()
     TTF_Quit();
 }
 
-void Game::Start()
+bool Game::Init()
 {
-    // Initialize SDL
-    if (SDL_Init(SDL_INIT_VIDEO) < 0)
-    {
-        std::cerr << "SDL could not initialize! SDL error: " << SDL_GetError() << std::endl;
-    }
-
-    // Initialize SDL_image
-    if (IMG_Init(IMG_INIT_PNG) < 0)
+    if (!StartSession())
     {
-        std::cerr << "SDL_image could not initialize! SDL_image Error: " << IMG_GetError() << std::endl;
+        m_exitCode = 1;
+        return false;
     }
 
-    //Initialize SDL_mixer
-    if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048) < 0)
+    if (m_options.software)
     {
-        std::cerr << "SDL_mixer could not initialize! SDL_mixer Error: " << Mix_GetError() << std::endl;
+        m_softwareRenderer.reset(new SoftwareRenderer(WINDOW_WIDTH, WINDOW_HEIGHT, m_options.renderThreads));
     }
 
-    //Initialize SDL_ttf
-    if (TTF_Init() < 0)
+    if (!m_options.headless)
     {
-        std::cerr << "SDL_ttf could not be initialized! SDL_ttf error: " << TTF_GetError() << std::endl;
+        InitSDL();
+        LoadAssets();
     }
-
-    // Create window
-    m_window = SDL_CreateWindow(WINDOW_TITLE.c_str(), SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_SHOWN);
-    if (m_window == nullptr)
+    else if (m_options.software)
     {
-        std::cerr << "Window could not be created! SDL error: " << SDL_GetError() << std::endl;
+        InitOffscreen();
+        LoadAssets();
     }
 
-    // Create renderer
-    m_renderer = SDL_CreateRenderer(m_window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
-    if (m_renderer == nullptr)
+    if (m_renderer != nullptr || m_softwareRenderer)
     {
-        std::cerr << "Renderer could not be created! SDL error: " << SDL_GetError() << std::endl;
+        m_particles.Init(PARTICLES_PER_LAYER);
+        for (int i = 0; i < 3; i++)
+        {
+            m_snapshots.GetSlot(i).Reserve(0, 0, PARTICLES_PER_LAYER);
+        }
     }
 
-    // Load application icon
-    SDL_Surface* tempSurface = IMG_Load("res/textures/icon.png");
-    if (tempSurface == nullptr)
+    if (m_softwareRenderer)
     {
-        std::cerr << "Unable to load image " << "res/textures/icon.png" << "! SDL_image error: " << IMG_GetError() << std::endl;
+        m_softwareRenderer->ReserveBatches(PARTICLES_PER_LAYER * PARTICLE_LAYER_COUNT);
     }
-    SDL_SetWindowIcon(m_window, tempSurface);
-    SDL_FreeSurface(tempSurface);
-
-    // Load Textures
-    LoadTexture("res/textures/man.png", "man");
-    LoadTexture("res/textures/man_2.png", "man2");
-    LoadTexture("res/textures/man_3.png", "man3");
-    LoadTexture("res/textures/man_4.png", "man4");
-    LoadTexture("res/textures/tree.png", "tree");
-    LoadTexture("res/textures/log.png", "log");
-    LoadTexture("res/textures/stone.png", "stone");
-    LoadTexture("res/textures/rock.png", "rock");
-    LoadTexture("res/textures/selection.png", "selection");
-    LoadTexture("res/textures/bonfire_0.png", "bonfire_0");
-    LoadTexture("res/textures/bonfire_1.png", "bonfire_1");
-    LoadTexture("res/textures/bonfire_2.png", "bonfire_2");
-    LoadTexture("res/textures/bonfire_3.png", "bonfire_3");
-    LoadTexture("res/textures/bonfire_4.png", "bonfire_4");
-    LoadTexture("res/textures/fire.png", "fire");
-    LoadTexture("res/textures/grass.png", "grass");
-
-    // Load fonts
-    LoadFont("res/fonts/dos.ttf", "dos");
 
-    // Load Sounds
-    LoadSound("res/sounds/chop.wav", "chop");
-    LoadSound("res/sounds/mine.wav", "mine");
-    LoadSound("res/sounds/drop.wav", "drop");
-    LoadSound("res/sounds/die.wav", "die");
-
-    // Load GameObjects
-    m_bonfire = new Bonfire(this);
-    m_bonfire->Load(Vector2D(304, 224), 32, 32, "bonfire");
-    m_gameObjects.push_back(m_bonfire);
-
-    for (int i = 0; i < 6; i++)
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    // Every batch of particles is a run of quads, two triangles each
+    if (m_renderer != nullptr && !m_softwareRenderer)
     {
-        Tree* t = new Tree(this);
-        Vector2D pos = Vector2D(rand() % (WINDOW_WIDTH - 100), rand() % (WINDOW_HEIGHT - 100));
-
-        while (Vector2D::Distance(pos, m_bonfire->GetPosition()) < 100)
+        m_particleIndices.resize(PARTICLE_BATCH_SIZE * 6);
+        for (int i = 0; i < PARTICLE_BATCH_SIZE; i++)
         {
-            pos = Vector2D(rand() % (WINDOW_WIDTH - 100), rand() % (WINDOW_HEIGHT - 100));
+            static const int QUAD_INDICES[6] = { 0, 1, 2, 0, 2, 3 };
+            for (int j = 0; j < 6; j++)
+            {
+                m_particleIndices[i * 6 + j] = i * 4 + QUAD_INDICES[j];
+            }
         }
-
-        t->Load(pos, 32, 32, "tree");
-        m_gameObjects.push_back(t);
     }
+#endif
 
-    for (int i = 0; i < 3; i++)
+    if (!m_options.telemetryPath.empty())
     {
-        Stone* s = new Stone(this);
-        Vector2D pos = Vector2D(rand() % (WINDOW_WIDTH - 100), rand() % (WINDOW_HEIGHT - 100));
+        m_telemetry.Open(m_options.telemetryPath, (uint64_t)m_options.telemetryMB << 20, WINDOW_WIDTH, WINDOW_HEIGHT);
+    }
 
-        while (Vector2D::Distance(pos, m_bonfire->GetPosition()) < 100)
-        {
-            pos = Vector2D(rand() % (WINDOW_WIDTH - 100), rand() % (WINDOW_HEIGHT - 100));
-        }
+    CreateWorld();
+    return true;
+}
 
-        s->Load(pos, 32, 32, "stone");
-        m_gameObjects.push_back(s);
+void Game::Start()
+{
+    if (!Init())
+    {
+        return;
     }
 
-    SpawnPeons(true);
+    // From here on the world belongs to the simulation thread, and this one
+    // only handles input and draws the snapshots it publishes
+    m_simThread = std::thread(&Game::RunSimulation, this);
+    m_cpuMeter.Start();
 
     // Game loop
     double frameStartTime = 0.0;
     double frameEndTime = 0.0;
     SDL_Event event;
+    FrameArena& arena = FrameArena::ForThisThread();
     while (m_isRunning)
     {
-        frameStartTime = SDL_GetTicks();
-        m_deltaTime = (frameStartTime - frameEndTime) / 1000;
-        frameEndTime = frameStartTime;
+        arena.Reset();
+
+        // Sleep now rather than in present, so the input read below is
+        // as fresh as possible when the frame reaches the screen
+        if (m_options.lowLatency && !m_idleThrottle.IsIdle())
+        {
+            m_framePacer.Wait();
+        }
 
         for (int i = 0; i < 5; i++)
         {
@@ -167,13 +274,43 @@ void Game::Start()
             m_buttonsUp[i] = false;
         }
 
-        while (SDL_PollEvent(&event) != 0)
+        // After a skipped frame, block for the first event instead of polling
+        int wait = m_idleThrottle.ChooseWait(m_snapshots.GetReadBuffer());
+        bool hadInput = false;
+        while ((wait > 0) ? SDL_WaitEventTimeout(&event, wait) != 0 : SDL_PollEvent(&event) != 0)
         {
+            wait = 0;
+            if (m_idleThrottle.IsWakeEvent(event))
+            {
+                continue;
+            }
+            hadInput = true;
+
             if (event.type == SDL_QUIT)
             {
                 m_isRunning = false;
             }
 
+            if (event.type == SDL_KEYDOWN)
+            {
+                if (event.key.keysym.sym == SDLK_F3)
+                {
+                    m_perfOverlay.Toggle();
+                }
+                else if (event.key.keysym.sym == SDLK_F4)
+                {
+                    MemoryTracker::Report("memory_report.txt");
+                }
+                else if (event.key.keysym.sym >= SDLK_1 && event.key.keysym.sym <= SDLK_9)
+                {
+                    // Ctrl and a number keeps the selection as a control
+                    // group, and the number alone selects it again
+                    uint8_t type = (event.key.keysym.mod & KMOD_CTRL) ? COMMAND_SET_GROUP : COMMAND_RECALL_GROUP;
+                    PlayerCommand command = { type, (int16_t)(event.key.keysym.sym - SDLK_1), 0, 0, 0 };
+                    QueueCommand(command, event.key.timestamp);
+                }
+            }
+
             if (event.type == SDL_MOUSEBUTTONDOWN)
             {
                 if (event.button.button == SDL_BUTTON_LEFT)
@@ -184,6 +321,7 @@ void Game::Start()
                     }
 
                     m_buttonsCurrent[SDL_BUTTON_LEFT] = true;
+                    m_buttonTimes[SDL_BUTTON_LEFT] = event.button.timestamp;
                 }
                 else if (event.button.button == SDL_BUTTON_RIGHT)
                 {
@@ -193,6 +331,7 @@ void Game::Start()
                     }
 
                     m_buttonsCurrent[SDL_BUTTON_RIGHT] = true;
+                    m_buttonTimes[SDL_BUTTON_RIGHT] = event.button.timestamp;
                 }
             }
 
@@ -202,11 +341,13 @@ void Game::Start()
                 {
                     m_buttonsUp[SDL_BUTTON_LEFT] = true;
                     m_buttonsCurrent[SDL_BUTTON_LEFT] = false;
+                    m_buttonTimes[SDL_BUTTON_LEFT] = event.button.timestamp;
                 }
                 else if (event.button.button == SDL_BUTTON_RIGHT)
                 {
                     m_buttonsUp[SDL_BUTTON_RIGHT] = true;
                     m_buttonsCurrent[SDL_BUTTON_RIGHT] = false;
+                    m_buttonTimes[SDL_BUTTON_RIGHT] = event.button.timestamp;
                 }
             }
         }
@@ -216,258 +357,1509 @@ void Game::Start()
             break;
         }
 
+        uint64_t allocations = AllocationCounter::GetAllocations();
+
         ProcessInput();
-        Update();
-        Render();
-    }
-}
+        FlushSounds();
+        m_cpuMeter.Update();
 
-void Game::Update()
-{
-    SpawnPeons(false);
+        if (m_options.idleThrottle)
+        {
+            m_idleThrottle.Arm();
+        }
 
-    for (std::vector<GameObject*>::const_iterator it = m_gameObjects.begin(); it != m_gameObjects.end(); it++)
-    {
-        (*it)->Update();
-    }
-}
+        m_snapshots.Acquire();
+        const RenderSnapshot& snapshot = m_snapshots.GetReadBuffer();
+        if (m_options.idleThrottle && !m_idleThrottle.ShouldDraw(snapshot, hadInput))
+        {
+            continue;
+        }
+        if (m_idleThrottle.IsIdle() && m_options.lowLatency)
+        {
+            m_framePacer.Resume();
+        }
 
-void Game::ProcessInput()
-{
-    SDL_GetMouseState(&mouseX, &mouseY);
+        frameStartTime = SDL_GetTicks();
+        double frameTime = frameStartTime - frameEndTime;
+        frameEndTime = frameStartTime;
 
-    if (m_buttonsDown[SDL_BUTTON_LEFT])
-    {
-        LeftClick();
-    }
-    else if (m_buttonsDown[SDL_BUTTON_RIGHT])
-    {
-        RightClick();
-    }
+        Uint64 renderStart = SDL_GetPerformanceCounter();
+        Render(snapshot);
+        m_idleThrottle.FrameDrawn(snapshot, frameStartTime);
+        m_framesDrawn++;
 
-    if (m_buttonsUp[SDL_BUTTON_LEFT])
-    {
-        LeftClickUp();
+        if (m_options.lowLatency)
+        {
+            m_framePacer.FrameDone();
+        }
+
+        // The first frame to show the result of an input is now on screen
+        if (snapshot.inputSequence != m_presentedInput.load(std::memory_order_relaxed))
+        {
+            m_inputLatency.Add(SDL_GetTicks() - snapshot.inputTime);
+            m_presentedInput.store(snapshot.inputSequence, std::memory_order_relaxed);
+        }
+
+        Uint64 renderEnd = SDL_GetPerformanceCounter();
+        double ticksPerMs = SDL_GetPerformanceFrequency() / 1000.0;
+
+        FrameStats stats;
+        stats.frameTime = frameTime;
+        stats.simTime = snapshot.stats.tickTime;
+        stats.renderTime = (renderEnd - renderStart) / ticksPerMs;
+        stats.drawCalls = m_drawCalls;
+        stats.textureSwitches = m_textureSwitches;
+        stats.allocations = AllocationCounter::GetAllocations() - allocations;
+        stats.arenaPeak = arena.GetHighWater();
+        m_perfOverlay.AddFrame(stats);
     }
-    if (m_buttonsUp[SDL_BUTTON_LEFT])
+
+    m_isRunning = false;
+    m_simThread.join();
+
+    if (m_inputLatency.GetCount() > 0)
     {
-        RightClickUp();
+        m_inputLatency.Print(std::cout);
     }
 
-    // Box selection
-    if (m_buttonsCurrent[SDL_BUTTON_LEFT])
+    if (m_options.lowLatency)
     {
-        if (!m_selecting)
-        {
-            m_selecting = true;
+        std::cout << "Missed " << m_framePacer.GetMissedDeadlines() << " frame deadlines" << std::endl;
+    }
 
-            m_selectionRect.x = mouseX;
-            m_selectionRect.y = mouseY;
-        }
+    std::cout << "Drew " << m_framesDrawn << " frames and skipped " << m_idleThrottle.GetSkippedFrames() << ", using "
+        << m_cpuMeter.GetAverage() << " s of CPU per second" << std::endl;
 
-        if (m_selecting)
-        {
-            m_selectionRect.w = mouseX - m_selectionRect.x;
-            m_selectionRect.h = mouseY - m_selectionRect.y;
-        }
+    if (m_lockstep)
+    {
+        m_lockstep->Finish(1000);
     }
 }
 
-void Game::Render()
+void Game::CreateWorld()
 {
-    SDL_SetRenderDrawColor(m_renderer, 133, 222, 80, 255);
-    SDL_RenderClear(m_renderer);
+    // Fixed timestep, so a run is reproducible for a given seed
+    m_deltaTime = STEP_TIME / 1000;
 
-    for (int x = 0; x < (WINDOW_WIDTH / 32); x++)
+    MEMORY_SCOPE(MEMORY_OBJECTS);
+    int bonfires = std::min(std::max(m_options.bonfires, 1), MAX_BONFIRES);
+    for (int i = 0; i < bonfires; i++)
     {
-        for (int y = 0; y < (WINDOW_HEIGHT / 32); y++)
+        Vector2D position(BONFIRE_POSITIONS[i][0], BONFIRE_POSITIONS[i][1]);
+        Bonfire* bonfire = new Bonfire(this);
+        bonfire->Load(position, 32, 32, "bonfire");
+        Handle handle = AddObject(bonfire);
+        if (handle.IsNull())
         {
-            RenderTexture("grass", x * 32, y * 32, 32, 32);
+            continue;
         }
+        m_depots.push_back(handle);
+        m_flowField.AddDepot(handle, position);
     }
+    m_bonfire = m_depots.front();
 
-    for (std::vector<GameObject*>::const_iterator it = m_gameObjects.begin(); it != m_gameObjects.end(); it++)
-    {
-        (*it)->Render();
-    }
-
-    for (std::vector<Peon*>::const_iterator it = m_selectedPeons.begin(); it != m_selectedPeons.end(); it++)
+    for (int i = 0; i < MAX_TREES; i++)
     {
-        RenderTexture("selection", (*it)->GetPosition().GetX(), (*it)->GetPosition().GetY(), (*it)->GetWidth(), (*it)->GetHeight());
+        SpawnResource(RESOURCE_TREE);
     }
 
-    if (m_selecting)
+    for (int i = 0; i < MAX_STONES; i++)
     {
-        SDL_SetRenderDrawColor(m_renderer, 0, 0, 0, 255);
-        SDL_RenderDrawRect(m_renderer, &m_selectionRect);
+        SpawnResource(RESOURCE_STONE);
     }
 
-    // Draw GUI
-    sstream.str("");
-    sstream << m_resources;
-    RenderTexture("log", -4, 40, 32, 32);
-    RenderTexture("rock", 2, 45, 32, 32);
-    RenderText("dos", 10, 75, sstream.str());
+    m_flowField.Refresh();
+    SpawnPeons(true);
+    m_regrowTimer.Start();
+}
 
-    sstream.str("");
-    sstream << m_peons;
-    RenderTexture("man", 0 - 16, 0 - 32, 64, 64);
-    RenderText("dos", 8, 32, sstream.str());
+void Game::Step()
+{
+    Update();
 
-    SDL_RenderPresent(m_renderer);
+    // Nothing plays them without a window, but the queue still needs room
+    FlushSounds();
 }
 
-void Game::LeftClick()
+int Game::GetExitCode() const
 {
-    m_selectedPeons.clear();
+    return m_exitCode;
 }
 
-void Game::LeftClickUp()
+void Game::NoteInput(Uint32 inputTime)
 {
-    if (m_selecting)
+    // Later inputs are measured once this one has been
+    if (m_hasInput)
     {
-        // Look for the peons in our selection box, and select them
-        for (std::vector<GameObject*>::const_iterator it = m_gameObjects.begin(); it != m_gameObjects.end(); it++)
-        {
-            GameObject* obj = *it;
-            if (obj->m_ID == "peon")
-            {
-                // Check if the selection contains that unit
-                if (CheckCollision(m_selectionRect, obj->GetHitBox()))
-                {
-                    m_selectedPeons.push_back(dynamic_cast<Peon*>(obj));
-                }
-            }
-        }
-
-        m_selecting = false;
+        return;
     }
+
+    // A lockstep command is scheduled input delay ticks ahead, and shows
+    // once that tick has run
+    m_oldestInput = inputTime;
+    m_inputDueTick = m_lockstep ? m_tick + m_lockstep->GetInputDelay() + 1 : m_tick + 1;
+    m_hasInput = true;
 }
 
-void Game::RightClick()
+void Game::PublishInput(RenderSnapshot& snapshot)
 {
-    GameObject* obj = nullptr;
-    for (std::vector<GameObject*>::const_iterator objIt = m_gameObjects.begin(); objIt != m_gameObjects.end(); objIt++)
+    if (m_hasInput && m_tick >= m_inputDueTick)
     {
-        SDL_Rect mouseRect = { mouseX - 5, mouseY - 5, 10, 10 };
-        if (CheckCollision(mouseRect, (*objIt)->GetHitBox()))
+        // Held back while the last input shown has not reached the screen,
+        // so a snapshot the main thread skips does not lose its sample
+        if (m_presentedInput.load(std::memory_order_relaxed) == m_inputSequence)
         {
-            if ((*objIt)->m_ID == "tree" || (*objIt)->m_ID == "stone" || (*objIt)->m_ID == "bonfire")
-            {
-                obj = (*objIt);
-            }
+            m_shownInput = m_oldestInput;
+            m_inputSequence++;
+            m_hasInput = false;
         }
     }
 
-    CommandPeons(obj);
+    snapshot.inputTime = m_shownInput;
+    snapshot.inputSequence = m_inputSequence;
 }
 
-void Game::RightClickUp()
+const LatencyHistogram& Game::GetInputLatency() const
 {
+    return m_inputLatency;
+}
 
+const CpuMeter& Game::GetCpuMeter() const
+{
+    return m_cpuMeter;
 }
 
-bool Game::CheckCollision(SDL_Rect a, SDL_Rect b)
+uint64_t Game::GetSkippedFrames() const
 {
-    int leftA = a.x;
-    int rightA = a.x + a.w;
-    int topA = a.y;
-    int bottomA = a.y + a.h;
+    return m_idleThrottle.GetSkippedFrames();
+}
 
-    int leftB = b.x;
-    int rightB = b.x + b.w;
-    int topB = b.y;
-    int bottomB = b.y + b.h;
+uint64_t Game::GetObjectUpdates() const
+{
+    return m_objectUpdates;
+}
 
-    if (rightA < leftA)
-    {
-        int temp = leftA;
-        leftA = rightA;
-        rightA = temp;
-    }
+double Game::GetSlowestOrderTime() const
+{
+    return (double)m_slowestOrder * 1000 / SDL_GetPerformanceFrequency();
+}
 
-    if (rightB < leftB)
+int Game::GetSlowestOrderPeons() const
+{
+    return m_slowestOrderPeons;
+}
+
+TelemetryWriter& Game::GetTelemetry()
+{
+    return m_telemetry;
+}
+
+double Game::GetTelemetryTime() const
+{
+    return (double)m_telemetryTime * 1000 / SDL_GetPerformanceFrequency();
+}
+
+const SoftwareRenderer* Game::GetSoftwareRenderer() const
+{
+    return m_softwareRenderer.get();
+}
+
+int Game::GetFramesRendered() const
+{
+    return m_framesRendered;
+}
+
+bool Game::StartSession()
+{
+    if (m_options.hostPort == 0 && m_options.joinAddress.empty())
     {
-        int temp = leftB;
-        leftB = rightB;
-        rightB = temp;
+        return true;
     }
 
-    if (bottomA < topA)
+    m_lockstep.reset(new LockstepDriver(this));
+    if (!m_lockstep->Connect(m_options))
     {
-        int temp = topA;
-        topA = bottomA;
-        bottomA = temp;
+        return false;
     }
 
-    if (bottomB < topB)
-    {
-        int temp = topB;
-        topB = bottomB;
+    // Both sides build the same world from the host's settings, and from
+    // here on only player input may feed into the simulation
+    m_peonsToSpawn = m_options.initialPeons;
+    m_random.seed(m_options.seed);
+    m_localPlayer = m_lockstep->GetLocalPlayer();
+    return true;
+}
+
+void Game::RunSimulation()
+{
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    Uint64 lastTime = SDL_GetPerformanceCounter();
+    while (m_isRunning)
+    {
+        Uint64 now = SDL_GetPerformanceCounter();
+        double elapsed = (double)(now - lastTime) * 1000 / frequency;
+        lastTime = now;
+
+        ApplyQueuedCommands();
+
+        // Fixed steps, and only a few at once to catch up after a stall
+        m_stepAccumulator = std::min(m_stepAccumulator + elapsed, STEP_TIME * MAX_CATCHUP_STEPS);
+
+        int tick = m_tick;
+        if (m_lockstep)
+        {
+            if (!m_lockstep->Step(m_stepAccumulator, STEP_TIME))
+            {
+                m_isRunning = false;
+            }
+        }
+        else
+        {
+            StepLocal();
+        }
+
+        if (m_tick != tick)
+        {
+            double tickTime = (double)(SDL_GetPerformanceCounter() - now) * 1000 / frequency / (m_tick - tick);
+            PublishSnapshot(tickTime);
+        }
+
+        // Sleep until the next step is due, or a little while when stalled
+        double wait = STEP_TIME - m_stepAccumulator;
+        SDL_Delay((Uint32)std::max(wait, 1.0));
+    }
+}
+
+void Game::StepLocal()
+{
+    // The same fixed steps as a lockstep game, just without waiting on anyone
+    while (m_stepAccumulator >= STEP_TIME)
+    {
+        Update();
+        m_stepAccumulator -= STEP_TIME;
+    }
+}
+
+void Game::ApplyQueuedCommands()
+{
+    QueuedCommand queued;
+    while (m_commandQueue.TryPop(queued))
+    {
+        PushCommand(queued.command);
+        NoteInput(queued.inputTime);
+    }
+}
+
+void Game::PublishSnapshot(double tickTime)
+{
+    RenderSnapshot& snapshot = m_snapshots.GetWriteBuffer();
+    const SelectionSet& selection = m_selectedPeons[m_localPlayer];
+    {
+        // Only grows along with the world
+        AllocationExemption exemption;
+        snapshot.Reserve(m_gameObjects.Size() * 2, selection.GetCount(), 0);
+    }
+    snapshot.Clear();
+
+    // Each slot rebuilds the static layer only when it has fallen behind
+    if (snapshot.staticVersion != m_staticVersion)
+    {
+        AllocationExemption exemption;
+        snapshot.BeginStaticLayer();
+        for (std::vector<Handle>::const_iterator it = m_staticObjects.begin(); it != m_staticObjects.end(); it++)
+        {
+            GameObject* obj = GetGameObject(*it);
+            if (IsInView(obj, 8))
+            {
+                obj->Render(snapshot);
+            }
+        }
+        snapshot.EndStaticLayer(m_staticVersion);
+    }
+
+    for (size_t i = 0; i < m_gameObjects.Size(); i++)
+    {
+        const GameObject* obj = m_gameObjects[i].get();
+        if (!obj->m_isStatic && IsInView(obj, 8))
+        {
+            m_gameObjects[i]->Render(snapshot);
+        }
+    }
+
+    // Copied, since the next tick moves them while this frame is drawn
+    for (int layer = 0; layer < PARTICLE_LAYER_COUNT; layer++)
+    {
+        const ParticlePool& pool = m_particles.GetLayer((ParticleLayer)layer);
+        const float* xs = pool.GetX();
+        const float* ys = pool.GetY();
+        const float* sizes = pool.GetSize();
+        const SDL_Color* colors = pool.GetColor();
+
+        std::vector<ParticleInstance>& particles = snapshot.particles[layer];
+        for (int i = 0; i < pool.GetCount(); i++)
+        {
+            ParticleInstance particle = { xs[i], ys[i], sizes[i], colors[i] };
+            particle.color.a = (Uint8)(pool.GetFade(i) * 255);
+            particles.push_back(particle);
+        }
+    }
+
+    selection.ForEach([this, &snapshot](uint32_t index)
+    {
+        Peon* peon = GetPeon(m_gameObjects.HandleOfSlot(index));
+        if (peon != nullptr)
+        {
+            SDL_Rect rect = { (int)peon->GetPosition().GetX(), (int)peon->GetPosition().GetY(), (int)peon->GetWidth(), (int)peon->GetHeight() };
+            snapshot.selected.push_back(rect);
+        }
+    });
+
+    snapshot.resources = m_resources;
+    snapshot.peons = m_peons;
+    snapshot.objectCount = m_gameObjects.Size();
+
+    WorldStats& stats = snapshot.stats;
+    stats.tick = m_tick;
+    stats.tickTime = tickTime;
+    stats.peons = m_peonCount;
+    stats.trees = m_treeCount;
+    stats.stones = m_stoneCount;
+    stats.others = m_otherCount;
+    stats.parked = m_parkedObjects;
+    stats.coarse = m_coarseObjects;
+    stats.particles = m_particles.GetCount();
+    stats.particleUpdateTime = m_particles.GetUpdateTime();
+    stats.arenaPeak = FrameArena::ForThisThread().GetHighWater();
+
+    PublishInput(snapshot);
+
+    if (m_options.idleThrottle)
+    {
+        snapshot.sceneHash = snapshot.HashScene();
+    }
+    uint32_t sceneHash = snapshot.sceneHash;
+
+    m_snapshots.Publish();
+    m_idleThrottle.Published(sceneHash);
+}
+
+void Game::RenderOffscreen()
+{
+    PublishSnapshot(0);
+    m_snapshots.Acquire();
+    Render(m_snapshots.GetReadBuffer());
+}
+
+void Game::InitSDL()
+{
+    // Initialize SDL
+    if (SDL_Init(SDL_INIT_VIDEO) < 0)
+    {
+        LOG_ERROR("SDL could not initialize! SDL error: %s", SDL_GetError());
+    }
+
+    // Initialize SDL_image
+    if (IMG_Init(IMG_INIT_PNG) < 0)
+    {
+        LOG_ERROR("SDL_image could not initialize! SDL_image Error: %s", IMG_GetError());
+    }
+
+    //Initialize SDL_mixer
+    if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048) < 0)
+    {
+        LOG_ERROR("SDL_mixer could not initialize! SDL_mixer Error: %s", Mix_GetError());
+    }
+
+    //Initialize SDL_ttf
+    if (TTF_Init() < 0)
+    {
+        LOG_ERROR("SDL_ttf could not be initialized! SDL_ttf error: %s", TTF_GetError());
+    }
+
+    // Create window
+    m_window = SDL_CreateWindow(WINDOW_TITLE.c_str(), SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_SHOWN);
+    if (m_window == nullptr)
+    {
+        LOG_ERROR("Window could not be created! SDL error: %s", SDL_GetError());
+    }
+
+    // Create renderer. Low latency mode paces itself instead of waiting
+    // for the vblank in present.
+    Uint32 rendererFlags = SDL_RENDERER_ACCELERATED;
+    if (!m_options.lowLatency)
+    {
+        rendererFlags |= SDL_RENDERER_PRESENTVSYNC;
+    }
+
+    m_renderer = SDL_CreateRenderer(m_window, -1, rendererFlags);
+    if (m_renderer == nullptr)
+    {
+        LOG_ERROR("Renderer could not be created! SDL error: %s", SDL_GetError());
+    }
+
+    SDL_DisplayMode mode;
+    if (m_options.lowLatency && SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(m_window), &mode) == 0)
+    {
+        m_framePacer.SetRefreshRate(mode.refresh_rate);
+    }
+
+    // Software frames are uploaded into this texture and drawn in one copy
+    if (m_softwareRenderer)
+    {
+        m_frameTexture = SDL_CreateTexture(m_renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, WINDOW_WIDTH, WINDOW_HEIGHT);
+        if (m_frameTexture == nullptr)
+        {
+            LOG_ERROR("Frame texture could not be created! SDL error: %s", SDL_GetError());
+        }
+    }
+
+    // Lets the simulation wake the main thread out of an idle wait
+    m_idleThrottle.Init();
+
+    // Load application icon
+    SDL_Surface* tempSurface = IMG_Load("res/textures/icon.png");
+    if (tempSurface == nullptr)
+    {
+        LOG_ERROR("Unable to load image res/textures/icon.png! SDL_image error: %s", IMG_GetError());
+    }
+    SDL_SetWindowIcon(m_window, tempSurface);
+    SDL_FreeSurface(tempSurface);
+}
+
+void Game::InitOffscreen()
+{
+    // Images and fonts still come through SDL, but nothing needs a window
+    if (IMG_Init(IMG_INIT_PNG) < 0)
+    {
+        LOG_ERROR("SDL_image could not initialize! SDL_image Error: %s", IMG_GetError());
+    }
+
+    if (TTF_Init() < 0)
+    {
+        LOG_ERROR("SDL_ttf could not be initialized! SDL_ttf error: %s", TTF_GetError());
+    }
+
+    LOG_INFO("Rendering offscreen with %d threads", m_softwareRenderer->GetThreadCount());
+}
+
+void Game::LoadAssets()
+{
+    // Load Textures
+    LoadTexture("res/textures/man.png", "man");
+    LoadTexture("res/textures/man_2.png", "man2");
+    LoadTexture("res/textures/man_3.png", "man3");
+    LoadTexture("res/textures/man_4.png", "man4");
+    LoadTexture("res/textures/tree.png", "tree");
+    LoadTexture("res/textures/log.png", "log");
+    LoadTexture("res/textures/stone.png", "stone");
+    LoadTexture("res/textures/rock.png", "rock");
+    LoadTexture("res/textures/selection.png", "selection");
+    LoadTexture("res/textures/bonfire_0.png", "bonfire_0");
+    LoadTexture("res/textures/bonfire_1.png", "bonfire_1");
+    LoadTexture("res/textures/bonfire_2.png", "bonfire_2");
+    LoadTexture("res/textures/bonfire_3.png", "bonfire_3");
+    LoadTexture("res/textures/bonfire_4.png", "bonfire_4");
+    LoadTexture("res/textures/fire.png", "fire");
+    LoadTexture("res/textures/grass.png", "grass");
+
+    // Load fonts
+    LoadFont("res/fonts/dos.ttf", "dos");
+    BuildGlyphAtlas("dos");
+
+    // Load Sounds
+    if (m_options.headless)
+    {
+        return;
+    }
+
+    LoadSound("res/sounds/chop.wav", "chop");
+    LoadSound("res/sounds/mine.wav", "mine");
+    LoadSound("res/sounds/drop.wav", "drop");
+    LoadSound("res/sounds/die.wav", "die");
+}
+
+void Game::Update()
+{
+    // Bookkeeping by default; spawning, strings and the frame arena tag
+    // their own allocations
+    MEMORY_SCOPE(MEMORY_CONTAINERS);
+
+    // Scratch from the last tick is done with
+    FrameArena& arena = FrameArena::ForThisThread();
+    arena.Reset();
+
+    m_time += m_deltaTime * 1000;
+    m_tick++;
+
+    SpawnPeons(false);
+    RegrowResources();
+    m_flowField.Refresh();
+
+    WakeDueObjects();
+    UpdateObjects();
+
+    PeonSample peons(arena);
+    SeparatePeons(peons);
+    RecordTelemetry(peons);
+    ReassignOrphanedPeons();
+    FlushDestroyedObjects();
+
+    m_particles.Update((float)m_deltaTime);
+}
+
+void Game::RecordTelemetry(const PeonSample& sample)
+{
+    if (!m_telemetry.IsOpen())
+    {
+        return;
+    }
+
+    // Reuses what separation gathered, rather than visiting every peon again
+    Uint64 start = SDL_GetPerformanceCounter();
+    m_telemetry.Submit(m_tick, m_resources, m_peons, sample.x.data(), sample.y.data(), sample.states.data(), sample.x.size());
+    m_telemetryTime += SDL_GetPerformanceCounter() - start;
+}
+
+void Game::ProcessInput()
+{
+    SDL_GetMouseState(&mouseX, &mouseY);
+
+    if (m_buttonsDown[SDL_BUTTON_LEFT])
+    {
+        LeftClick();
+    }
+    else if (m_buttonsDown[SDL_BUTTON_RIGHT])
+    {
+        RightClick();
+    }
+
+    if (m_buttonsUp[SDL_BUTTON_LEFT])
+    {
+        LeftClickUp();
+    }
+    if (m_buttonsUp[SDL_BUTTON_LEFT])
+    {
+        RightClickUp();
+    }
+
+    // Box selection
+    if (m_buttonsCurrent[SDL_BUTTON_LEFT])
+    {
+        if (!m_selecting)
+        {
+            m_selecting = true;
+
+            m_selectionRect.x = mouseX;
+            m_selectionRect.y = mouseY;
+        }
+
+        if (m_selecting)
+        {
+            m_selectionRect.w = mouseX - m_selectionRect.x;
+            m_selectionRect.h = mouseY - m_selectionRect.y;
+        }
+    }
+}
+
+void Game::Render(const RenderSnapshot& snapshot)
+{
+    MEMORY_SCOPE(MEMORY_FRAME);
+
+    m_drawCalls = 0;
+    m_textureSwitches = 0;
+    m_lastTexture = nullptr;
+
+    RefreshLabels(snapshot);
+
+    if (m_softwareRenderer)
+    {
+        // Every object may draw itself and a load, on top of the ground and
+        // HUD. Done here, as the renderer belongs to whoever draws.
+        {
+            AllocationExemption exemption;
+            m_softwareRenderer->Reserve(snapshot.objectCount * 2 + RESERVED_DRAWS);
+        }
+        m_softwareRenderer->Clear(133, 222, 80);
+    }
+    else
+    {
+        SDL_SetRenderDrawColor(m_renderer, 133, 222, 80, 255);
+        SDL_RenderClear(m_renderer);
+    }
+
+    for (int x = 0; x < (WINDOW_WIDTH / 32); x++)
+    {
+        for (int y = 0; y < (WINDOW_HEIGHT / 32); y++)
+        {
+            RenderTexture("grass", x * 32, y * 32, 32, 32);
+        }
+    }
+
+    for (std::vector<SpriteInstance>::const_iterator it = snapshot.staticSprites.begin(); it != snapshot.staticSprites.end(); it++)
+    {
+        RenderTexture(it->texture, it->x, it->y, it->width, it->height);
+    }
+
+    for (std::vector<SpriteInstance>::const_iterator it = snapshot.sprites.begin(); it != snapshot.sprites.end(); it++)
+    {
+        RenderTexture(it->texture, it->x, it->y, it->width, it->height);
+    }
+
+    RenderParticles(snapshot);
+
+    for (std::vector<SDL_Rect>::const_iterator it = snapshot.selected.begin(); it != snapshot.selected.end(); it++)
+    {
+        RenderTexture("selection", it->x, it->y, it->w, it->h);
+    }
+
+    if (m_selecting)
+    {
+        if (m_softwareRenderer)
+        {
+            SDL_Color black = { 0, 0, 0, 255 };
+            m_softwareRenderer->DrawRect(m_selectionRect, black);
+        }
+        else
+        {
+            SDL_SetRenderDrawColor(m_renderer, 0, 0, 0, 255);
+            SDL_RenderDrawRect(m_renderer, &m_selectionRect);
+        }
+    }
+
+    // Draw GUI
+    RenderTexture("log", -4, 40, 32, 32);
+    RenderTexture("rock", 2, 45, 32, 32);
+    RenderText(10, 75, m_resourceLabel.text);
+
+    RenderTexture("man", 0 - 16, 0 - 32, 64, 64);
+    RenderText(8, 32, m_peonLabel.text);
+
+    RenderText(WINDOW_WIDTH - m_selectionLabel.width - 8, 8, m_selectionLabel.text);
+
+    if (m_softwareRenderer)
+    {
+        PresentSoftwareFrame();
+    }
+
+    if (m_renderer == nullptr)
+    {
+        return;
+    }
+
+    m_perfOverlay.SetWorldStats(snapshot.stats);
+    m_perfOverlay.Render(m_renderer);
+
+    SDL_RenderPresent(m_renderer);
+}
+
+void Game::RenderParticles(const RenderSnapshot& snapshot)
+{
+    for (int layer = 0; layer < PARTICLE_LAYER_COUNT; layer++)
+    {
+        const std::vector<ParticleInstance>& particles = snapshot.particles[layer];
+        int count = (int)particles.size();
+        if (count == 0)
+        {
+            continue;
+        }
+
+        const char* textureID = (layer == PARTICLE_LAYER_FLAMES) ? "fire" : "";
+
+        if (m_softwareRenderer)
+        {
+            m_softwareRenderer->BeginBatch(textureID);
+            for (int i = 0; i < count; i++)
+            {
+                const ParticleInstance& particle = particles[i];
+                int size = std::max((int)particle.size, 1);
+                SDL_Rect dest = { (int)(particle.x - size / 2), (int)(particle.y - size / 2), size, size };
+                m_softwareRenderer->AddToBatch(dest, particle.color);
+            }
+            m_softwareRenderer->EndBatch();
+            m_drawCalls++;
+            continue;
+        }
+
+        SDL_Texture* texture = (layer == PARTICLE_LAYER_FLAMES) ? m_textureMap[textureID] : nullptr;
+        if (texture != m_lastTexture)
+        {
+            m_textureSwitches++;
+            m_lastTexture = texture;
+        }
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+        SDL_Vertex* vertices = FrameArena::ForThisThread().AllocateArray<SDL_Vertex>(std::min(count, PARTICLE_BATCH_SIZE) * 4);
+        int quads = 0;
+        for (int i = 0; i < count; i++)
+        {
+            const ParticleInstance& particle = particles[i];
+            float half = particle.size * 0.5f;
+            float x0 = particle.x - half;
+            float y0 = particle.y - half;
+            float x1 = particle.x + half;
+            float y1 = particle.y + half;
+            SDL_Color color = particle.color;
+
+            SDL_Vertex* vertex = &vertices[quads * 4];
+            vertex[0] = { { x0, y0 }, color, { 0.0f, 0.0f } };
+            vertex[1] = { { x1, y0 }, color, { 1.0f, 0.0f } };
+            vertex[2] = { { x1, y1 }, color, { 1.0f, 1.0f } };
+            vertex[3] = { { x0, y1 }, color, { 0.0f, 1.0f } };
+
+            quads++;
+            if (quads == PARTICLE_BATCH_SIZE || i == count - 1)
+            {
+                SDL_RenderGeometry(m_renderer, texture, vertices, quads * 4, m_particleIndices.data(), quads * 6);
+                m_drawCalls++;
+                quads = 0;
+            }
+        }
+#else
+        SDL_SetRenderDrawBlendMode(m_renderer, SDL_BLENDMODE_BLEND);
+        for (int i = 0; i < count; i++)
+        {
+            const ParticleInstance& particle = particles[i];
+            int size = std::max((int)particle.size, 1);
+            SDL_Rect dest = { (int)(particle.x - size / 2), (int)(particle.y - size / 2), size, size };
+            SDL_Color color = particle.color;
+
+            if (texture != nullptr)
+            {
+                SDL_SetTextureColorMod(texture, color.r, color.g, color.b);
+                SDL_SetTextureAlphaMod(texture, color.a);
+                SDL_RenderCopy(m_renderer, texture, nullptr, &dest);
+            }
+            else
+            {
+                SDL_SetRenderDrawColor(m_renderer, color.r, color.g, color.b, color.a);
+                SDL_RenderFillRect(m_renderer, &dest);
+            }
+            m_drawCalls++;
+        }
+
+        if (texture != nullptr)
+        {
+            SDL_SetTextureColorMod(texture, 255, 255, 255);
+            SDL_SetTextureAlphaMod(texture, 255);
+        }
+        SDL_SetRenderDrawBlendMode(m_renderer, SDL_BLENDMODE_NONE);
+#endif
+    }
+}
+
+void Game::RefreshLabels(const RenderSnapshot& snapshot)
+{
+    char buffer[32];
+
+    if (m_resourceLabel.value != snapshot.resources)
+    {
+        snprintf(buffer, sizeof(buffer), "%d", snapshot.resources);
+        RefreshLabel(m_resourceLabel, snapshot.resources, buffer);
+    }
+
+    if (m_peonLabel.value != snapshot.peons)
+    {
+        snprintf(buffer, sizeof(buffer), "%d", snapshot.peons);
+        RefreshLabel(m_peonLabel, snapshot.peons, buffer);
+    }
+
+    int selected = (int)snapshot.selected.size();
+    if (m_selectionLabel.value != selected)
+    {
+        buffer[0] = '\0';
+        if (selected > 0)
+        {
+            snprintf(buffer, sizeof(buffer), "%d selected", selected);
+        }
+        RefreshLabel(m_selectionLabel, selected, buffer);
+    }
+}
+
+void Game::RefreshLabel(HudLabel& label, int value, const char* text)
+{
+    // Labels are short enough to stay within the string's own buffer, so
+    // this never allocates
+    MEMORY_SCOPE(MEMORY_STRINGS);
+    label.text = text;
+    label.value = value;
+    label.width = m_glyphAtlas.MeasureText(text);
+}
+
+void Game::PresentSoftwareFrame()
+{
+    m_softwareRenderer->Flush();
+    m_framesRendered++;
+    DumpFrame();
+
+    if (m_frameTexture != nullptr)
+    {
+        SDL_UpdateTexture(m_frameTexture, NULL, m_softwareRenderer->GetPixels(), WINDOW_WIDTH * sizeof(uint32_t));
+        SDL_RenderCopy(m_renderer, m_frameTexture, NULL, NULL);
+    }
+}
+
+void Game::DumpFrame()
+{
+    const std::string& path = m_options.dumpPath;
+    if (path.empty() || (m_framesRendered - 1) % m_options.dumpEvery != 0)
+    {
+        return;
+    }
+
+    // A .raw path collects every frame into one stream, e.g. for
+    // ffmpeg -f rawvideo -pix_fmt rgba -s 640x480 -i frames.raw
+    if (path.size() > 4 && path.compare(path.size() - 4, 4, ".raw") == 0)
+    {
+        if (m_dumpFile == nullptr)
+        {
+            m_dumpFile = std::fopen(path.c_str(), "wb");
+            if (m_dumpFile == nullptr)
+            {
+                LOG_ERROR("Unable to open %s for writing!", path.c_str());
+                m_options.dumpPath.clear();
+                return;
+            }
+        }
+
+        m_softwareRenderer->WriteRaw(m_dumpFile);
+        return;
+    }
+
+    char number[16];
+    snprintf(number, sizeof(number), "%06d", m_framesRendered);
+    m_softwareRenderer->SavePNG(path + number + ".png");
+}
+
+void Game::LeftClick()
+{
+    PlayerCommand command = { COMMAND_DESELECT, 0, 0, 0, 0 };
+    QueueCommand(command, m_buttonTimes[SDL_BUTTON_LEFT]);
+}
+
+void Game::LeftClickUp()
+{
+    if (m_selecting)
+    {
+        PlayerCommand command = { COMMAND_SELECT, (int16_t)m_selectionRect.x, (int16_t)m_selectionRect.y, (int16_t)m_selectionRect.w, (int16_t)m_selectionRect.h };
+        QueueCommand(command, m_buttonTimes[SDL_BUTTON_LEFT]);
+
+        m_selecting = false;
+    }
+}
+
+void Game::RightClick()
+{
+    PlayerCommand command = { COMMAND_MOVE, (int16_t)mouseX, (int16_t)mouseY, 0, 0 };
+    QueueCommand(command, m_buttonTimes[SDL_BUTTON_RIGHT]);
+}
+
+void Game::RightClickUp()
+{
+
+}
+
+void Game::PushCommand(const PlayerCommand& command)
+{
+    if (m_lockstep)
+    {
+        m_lockstep->PushCommand(command);
+    }
+    else
+    {
+        ApplyCommand(m_localPlayer, command);
+    }
+}
+
+void Game::QueueCommand(const PlayerCommand& command, Uint32 inputTime)
+{
+    QueuedCommand queued = { command, inputTime };
+    if (!m_commandQueue.TryPush(queued))
+    {
+        LOG_WARNING("Dropped a command, the simulation is not keeping up");
+    }
+}
+
+void Game::ApplyCommand(int player, const PlayerCommand& command)
+{
+    SelectionSet& selection = m_selectedPeons[player];
+
+    if (command.type == COMMAND_DESELECT)
+    {
+        selection.Clear();
+        NotifySelectionChanged(player);
+    }
+    else if (command.type == COMMAND_SELECT)
+    {
+        // Look for the peons in the selection box, and select them
+        SDL_Rect box = { command.x, command.y, command.w, command.h };
+        for (std::vector<Handle>::const_iterator it = m_peonObjects.begin(); it != m_peonObjects.end(); it++)
+        {
+            Peon* peon = GetPeon(*it);
+            if (peon != nullptr && CheckCollision(box, peon->GetHitBox()))
+            {
+                selection.Add(*it);
+            }
+        }
+        NotifySelectionChanged(player);
+    }
+    else if (command.type == COMMAND_MOVE)
+    {
+        GameObject* obj = nullptr;
+        SDL_Rect clickRect = { command.x - 5, command.y - 5, 10, 10 };
+        for (SlotMap<std::unique_ptr<GameObject>>::const_iterator objIt = m_gameObjects.begin(); objIt != m_gameObjects.end(); objIt++)
+        {
+            if (CheckCollision(clickRect, (*objIt)->GetHitBox()))
+            {
+                if ((*objIt)->m_ID == "tree" || (*objIt)->m_ID == "stone" || (*objIt)->m_ID == "bonfire")
+                {
+                    obj = objIt->get();
+                }
+            }
+        }
+
+        CommandPeons(player, obj, Vector2D(command.x - 16, command.y - 16));
+    }
+    else if (command.type == COMMAND_SET_GROUP)
+    {
+        SetControlGroup(player, command.x);
+    }
+    else if (command.type == COMMAND_RECALL_GROUP)
+    {
+        RecallControlGroup(player, command.x);
+    }
+}
+
+uint32_t Game::ComputeChecksum() const
+{
+    // Covers what the simulation decides: the world, where everything is
+    // and what every peon is doing
+    uint32_t hash = 2166136261u;
+    hash = HashValue(hash, m_tick);
+    hash = HashValue(hash, m_resources);
+    hash = HashValue(hash, m_peons);
+    hash = HashValue(hash, (uint32_t)m_gameObjects.Size());
+
+    for (size_t i = 0; i < m_gameObjects.Size(); i++)
+    {
+        Vector2D position = m_gameObjects[i]->GetPosition();
+        hash = HashValue(hash, m_gameObjects.HandleAt(i).GetValue());
+        hash = HashValue(hash, position.GetX());
+        hash = HashValue(hash, position.GetY());
+    }
+
+    for (std::vector<Handle>::const_iterator it = m_peonObjects.begin(); it != m_peonObjects.end(); it++)
+    {
+        Peon* peon = GetPeon(*it);
+        hash = HashValue(hash, (int)peon->m_state);
+        hash = HashValue(hash, peon->m_resources);
+        hash = HashValue(hash, peon->m_targetResource.GetValue());
+    }
+
+    return hash;
+}
+
+LockstepDriver* Game::GetLockstep() const
+{
+    return m_lockstep.get();
+}
+
+int Game::GetLocalPlayer() const
+{
+    return m_localPlayer;
+}
+
+ParticleSystem& Game::GetParticles()
+{
+    return m_particles;
+}
+
+EventBus& Game::GetEvents()
+{
+    return m_events;
+}
+
+const double* Game::GetClock() const
+{
+    return &m_time;
+}
+
+bool Game::CheckCollision(SDL_Rect a, SDL_Rect b)
+{
+    int leftA = a.x;
+    int rightA = a.x + a.w;
+    int topA = a.y;
+    int bottomA = a.y + a.h;
+
+    int leftB = b.x;
+    int rightB = b.x + b.w;
+    int topB = b.y;
+    int bottomB = b.y + b.h;
+
+    if (rightA < leftA)
+    {
+        int temp = leftA;
+        leftA = rightA;
+        rightA = temp;
+    }
+
+    if (rightB < leftB)
+    {
+        int temp = leftB;
+        leftB = rightB;
+        rightB = temp;
+    }
+
+    if (bottomA < topA)
+    {
+        int temp = topA;
+        topA = bottomA;
+        bottomA = temp;
+    }
+
+    if (bottomB < topB)
+    {
+        int temp = topB;
+        topB = bottomB;
         bottomB = temp;
     }
 
 
-    if (rightA > leftB && leftA < rightB)
+    if (rightA > leftB && leftA < rightB)
+    {
+        if (bottomA > topB && topA < bottomB)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+Handle Game::AddObject(GameObject* obj)
+{
+    // The world is allowed to grow. The object itself was counted by
+    // whoever made it; what grows here is the bookkeeping.
+    MEMORY_SCOPE(MEMORY_CONTAINERS);
+    AllocationExemption exemption;
+
+    // Refused before the storage takes it over, so the caller can tell
+    if (!m_gameObjects.CanInsert())
+    {
+        LOG_WARNING("The world is full, so a new %s was not added", obj->m_ID.c_str());
+        delete obj;
+        return Handle();
+    }
+
+    Handle handle = m_gameObjects.Insert(std::unique_ptr<GameObject>(obj));
+    obj->SetHandle(handle);
+    CountObject(obj, 1);
+
+    if (obj->m_isStatic)
+    {
+        m_staticObjects.push_back(handle);
+        m_staticVersion++;
+    }
+    else
+    {
+        obj->m_inUpdateSet = true;
+        obj->m_lastUpdateTick = m_tick - 1;
+        m_updateSet.push_back(handle);
+        if (m_updateSet.capacity() < m_gameObjects.Size())
+        {
+            m_updateSet.reserve(m_gameObjects.Size() * 2);
+        }
+    }
+
+    // Stale wake entries linger until they come due, so leave some slack
+    m_wakeScheduler.Reserve(m_gameObjects.Size() * 4);
+
+    return handle;
+}
+
+void Game::DestroyObject(Handle handle)
+{
+    // Objects are removed at the end of the tick so nothing disappears while
+    // the update loop is walking the storage
+    if (m_gameObjects.Contains(handle))
+    {
+        m_destroyedObjects.push_back(handle);
+    }
+}
+
+GameObject* Game::GetGameObject(Handle handle) const
+{
+    const std::unique_ptr<GameObject>* obj = m_gameObjects.Get(handle);
+    return (obj != nullptr) ? obj->get() : nullptr;
+}
+
+Peon* Game::GetPeon(Handle handle) const
+{
+    // Only valid for handles taken from the peon lists, which never hold
+    // anything but peons
+    return static_cast<Peon*>(GetGameObject(handle));
+}
+
+void Game::Park(GameObject* obj, double wakeTime)
+{
+    if (obj->m_wakeTicket == 0)
+    {
+        m_parkedObjects++;
+    }
+
+    // Tickets start at 1, since 0 means awake
+    if (++m_lastWakeTicket == 0)
+    {
+        m_lastWakeTicket = 1;
+    }
+
+    obj->m_wakeTicket = m_lastWakeTicket;
+    m_wakeScheduler.Schedule(obj->GetHandle(), wakeTime, obj->m_wakeTicket);
+}
+
+void Game::Wake(GameObject* obj)
+{
+    if (obj->m_wakeTicket != 0)
+    {
+        obj->m_wakeTicket = 0;
+        m_parkedObjects--;
+    }
+
+    // Still in the set if it was parked earlier this tick
+    if (!obj->m_inUpdateSet)
+    {
+        obj->m_inUpdateSet = true;
+        m_updateSet.push_back(obj->GetHandle());
+    }
+}
+
+size_t Game::GetParkedCount() const
+{
+    return m_parkedObjects;
+}
+
+size_t Game::GetCoarseCount() const
+{
+    return m_coarseObjects;
+}
+
+bool Game::IsInView(const GameObject* obj, int margin) const
+{
+    SDL_Rect bounds = { (int)obj->GetPosition().GetX() - margin, (int)obj->GetPosition().GetY() - margin,
+        (int)obj->GetWidth() + margin * 2, (int)obj->GetHeight() + margin * 2 };
+
+    return bounds.x < m_viewRect.x + m_viewRect.w && bounds.x + bounds.w > m_viewRect.x &&
+        bounds.y < m_viewRect.y + m_viewRect.h && bounds.y + bounds.h > m_viewRect.y;
+}
+
+int Game::ChooseUpdateInterval(const GameObject* obj) const
+{
+    if (IsInView(obj, 0))
+    {
+        return 1;
+    }
+
+    return IsInView(obj, LOD_NEAR_MARGIN) ? LOD_NEAR_INTERVAL : LOD_FAR_INTERVAL;
+}
+
+void Game::WakeDueObjects()
+{
+    Handle handle;
+    uint32_t ticket;
+    while (m_wakeScheduler.PopDue(m_time, handle, ticket))
+    {
+        // Destroyed, woken early or parked again since this was scheduled
+        GameObject* obj = GetGameObject(handle);
+        if (obj != nullptr && obj->m_wakeTicket == ticket)
+        {
+            Wake(obj);
+        }
+    }
+}
+
+void Game::UpdateObjects()
+{
+    // Objects may be added or woken while updating, so walk the set by index
+    for (size_t i = 0; i < m_updateSet.size(); i++)
+    {
+        GameObject* obj = GetGameObject(m_updateSet[i]);
+        if (obj == nullptr || obj->m_wakeTicket != 0)
+        {
+            continue;
+        }
+
+        // Coarse objects take turns, spread out by slot so they do not all
+        // land on the same tick
+        int interval = obj->m_updateInterval;
+        if (interval > 1 && (m_tick + m_updateSet[i].GetIndex()) % interval != 0)
+        {
+            continue;
+        }
+
+        // Cover the skipped ticks, but never more than one interval, so an
+        // object coming back from being parked does not leap ahead
+        int ticks = std::min(m_tick - obj->m_lastUpdateTick, interval);
+        obj->m_step = m_deltaTime * std::max(ticks, 1);
+        obj->m_lastUpdateTick = m_tick;
+        obj->Update();
+        m_objectUpdates++;
+
+        int nextInterval = ChooseUpdateInterval(obj);
+        if ((nextInterval > 1) != (interval > 1))
+        {
+            m_coarseObjects += (nextInterval > 1) ? 1 : -1;
+        }
+        obj->m_updateInterval = nextInterval;
+    }
+
+    // Drop whatever parked itself or was destroyed, keeping the update order
+    size_t kept = 0;
+    for (size_t i = 0; i < m_updateSet.size(); i++)
+    {
+        GameObject* obj = GetGameObject(m_updateSet[i]);
+        if (obj == nullptr)
+        {
+            continue;
+        }
+
+        if (obj->m_wakeTicket != 0)
+        {
+            obj->m_inUpdateSet = false;
+            continue;
+        }
+
+        m_updateSet[kept++] = m_updateSet[i];
+    }
+    m_updateSet.resize(kept);
+}
+
+void Game::FlushDestroyedObjects()
+{
+    if (m_destroyedObjects.empty())
+    {
+        return;
+    }
+
+    bool selectionChanged[LockstepSession::MAX_PLAYERS] = {};
+    for (std::vector<Handle>::const_iterator it = m_destroyedObjects.begin(); it != m_destroyedObjects.end(); it++)
+    {
+        GameObject* obj = GetGameObject(*it);
+        if (obj != nullptr && obj->m_wakeTicket != 0)
+        {
+            m_parkedObjects--;
+        }
+        if (obj != nullptr && obj->m_updateInterval > 1)
+        {
+            m_coarseObjects--;
+        }
+        if (obj != nullptr)
+        {
+            CountObject(obj, -1);
+
+            // Before the slot can be handed out to something else
+            for (int player = 0; player < LockstepSession::MAX_PLAYERS; player++)
+            {
+                if (m_selectedPeons[player].Remove(*it))
+                {
+                    selectionChanged[player] = true;
+                }
+            }
+        }
+        if (obj != nullptr && obj->m_ID == "bonfire")
+        {
+            m_flowField.RemoveDepot(*it);
+            m_depots.erase(std::find(m_depots.begin(), m_depots.end(), *it));
+        }
+        if (obj != nullptr && obj->m_isStatic)
+        {
+            m_staticObjects.erase(std::find(m_staticObjects.begin(), m_staticObjects.end(), *it));
+            m_staticVersion++;
+        }
+
+        m_gameObjects.Remove(*it);
+    }
+    m_destroyedObjects.clear();
+
+    // Drop references that just went stale
+    m_peonObjects.erase(std::remove_if(m_peonObjects.begin(), m_peonObjects.end(),
+        [this](Handle h) { return !m_gameObjects.Contains(h); }), m_peonObjects.end());
+    for (int player = 0; player < LockstepSession::MAX_PLAYERS; player++)
     {
-        if (bottomA > topB && topA < bottomB)
+        if (selectionChanged[player])
         {
-            return true;
+            NotifySelectionChanged(player);
         }
     }
+}
 
-    return false;
+void Game::CountObject(const GameObject* obj, int change)
+{
+    const std::string& id = obj->m_ID;
+    if (id == "peon")
+    {
+        m_peonCount += change;
+    }
+    else if (id == "tree")
+    {
+        m_treeCount += change;
+    }
+    else if (id == "stone")
+    {
+        m_stoneCount += change;
+    }
+    else
+    {
+        m_otherCount += change;
+    }
 }
 
 Bonfire* Game::FindBonfire(Peon* peon)
 {
-    Bonfire* bonfire = nullptr;
-
-    for (std::vector<GameObject*>::const_iterator objIt = m_gameObjects.begin(); objIt != m_gameObjects.end(); objIt++)
+    // The nearest one to walk to, or the first if none can be reached
+    Handle depot = m_flowField.Lookup(peon->GetPosition()).depot;
+    if (depot.IsNull())
     {
-        GameObject* obj = *objIt;
-        if (obj->m_ID == "bonfire")
-        {
-            bonfire = dynamic_cast<Bonfire*>(obj);
-        }
+        depot = m_bonfire;
     }
 
-    return bonfire;
+    return dynamic_cast<Bonfire*>(GetGameObject(depot));
 }
 
 Tree* Game::FindTree(Peon* peon)
 {
-    Tree* tree = nullptr;
+    return dynamic_cast<Tree*>(GetGameObject(FindResource(RESOURCE_TREE, peon->GetPosition())));
+}
+
+Handle Game::FindResource(ResourceType type, Vector2D position) const
+{
+    return m_resourceIndex.FindNearest(type, position);
+}
+
+Resource* Game::SpawnResource(ResourceType type)
+{
+    MEMORY_SCOPE(MEMORY_OBJECTS);
+    AllocationExemption exemption;
+
+    Resource* resource = nullptr;
+    std::string textureID;
+    if (type == RESOURCE_TREE)
+    {
+        resource = new Tree(this);
+        textureID = "tree";
+    }
+    else
+    {
+        resource = new Stone(this);
+        textureID = "stone";
+    }
 
-    for (std::vector<GameObject*>::const_iterator objIt = m_gameObjects.begin(); objIt != m_gameObjects.end(); objIt++)
+    // Keep new resources away from the bonfires
+    Vector2D pos;
+    bool nearBonfire = true;
+    while (nearBonfire)
     {
-        GameObject* obj = *objIt;
-        if (obj->m_ID == "tree")
+        pos = Vector2D(Random() % (WINDOW_WIDTH - 100), Random() % (WINDOW_HEIGHT - 100));
+        nearBonfire = false;
+        for (std::vector<Handle>::const_iterator it = m_depots.begin(); it != m_depots.end(); it++)
         {
-            if (tree == nullptr)
+            GameObject* bonfire = GetGameObject(*it);
+            if (bonfire != nullptr && Vector2D::Distance(pos, bonfire->GetPosition()) < 100)
             {
-                tree = dynamic_cast<Tree*>(obj);
+                nearBonfire = true;
             }
-            else
+        }
+    }
+
+    resource->Load(pos, 32, 32, textureID);
+    Handle handle = AddObject(resource);
+    if (handle.IsNull())
+    {
+        return nullptr;
+    }
+
+    m_resourceIndex.Add(handle, type, pos);
+    m_flowField.AddObstacle(pos);
+
+    return resource;
+}
+
+void Game::RemoveResource(Resource* resource)
+{
+    m_resourceIndex.Remove(resource->GetHandle(), resource->GetType(), resource->GetPosition());
+    m_flowField.RemoveObstacle(resource->GetPosition());
+    m_depletedResources.push_back(std::make_pair(resource->GetHandle(), resource->GetType()));
+    DestroyObject(resource->GetHandle());
+}
+
+void Game::RegrowResources()
+{
+    if (m_regrowTimer.GetTime() < REGROW_TIME)
+    {
+        return;
+    }
+    m_regrowTimer.Start();
+
+    if (m_resourceIndex.GetCount(RESOURCE_TREE) < MAX_TREES)
+    {
+        SpawnResource(RESOURCE_TREE);
+    }
+
+    if (m_resourceIndex.GetCount(RESOURCE_STONE) < MAX_STONES)
+    {
+        SpawnResource(RESOURCE_STONE);
+    }
+}
+
+void Game::ReassignOrphanedPeons()
+{
+    // Peons whose resource was harvested dry this tick move on to the nearest
+    // node of the same kind. Done in one pass for all depletions in the tick.
+    if (m_depletedResources.empty())
+    {
+        return;
+    }
+
+    for (std::vector<Handle>::const_iterator it = m_peonObjects.begin(); it != m_peonObjects.end(); it++)
+    {
+        Peon* peon = GetPeon(*it);
+        if (peon->m_targetResource.IsNull())
+        {
+            continue;
+        }
+
+        for (size_t i = 0; i < m_depletedResources.size(); i++)
+        {
+            if (peon->m_targetResource == m_depletedResources[i].first)
             {
-                if (Vector2D::Distance(peon->GetPosition(), obj->GetPosition()) < Vector2D::Distance(peon->GetPosition(), tree->GetPosition()))
+                Wake(peon);
+                peon->m_targetResource = FindResource(m_depletedResources[i].second, peon->GetPosition());
+                if (peon->m_state == Peon::GATHERING)
                 {
-                    tree = dynamic_cast<Tree*>(obj);
+                    peon->m_state = Peon::IDLE;
                 }
+
+                // Nothing left to gather, so drop off whatever we are carrying
+                if (peon->m_targetResource.IsNull() && peon->m_resources > 0)
+                {
+                    peon->ReturnToDepot();
+                }
+                break;
             }
         }
     }
 
-    return tree;
+    m_depletedResources.clear();
 }
 
 void Game::SpawnPeons(bool initial)
 {
+    MEMORY_SCOPE(MEMORY_OBJECTS);
+    AllocationExemption exemption;
+
     for (int i = 0; i < m_peonsToSpawn; i++)
     {
         Peon* obj;
-        Vector2D position(rand() % WINDOW_WIDTH, -(rand() % 100));
-        Vector2D dest(rand() % (WINDOW_WIDTH - 100), rand() % (WINDOW_HEIGHT - 100));
+        Vector2D position(Random() % WINDOW_WIDTH, -(Random() % 100));
+        Vector2D dest(Random() % (WINDOW_WIDTH - 100), Random() % (WINDOW_HEIGHT - 100));
         int width = 32;
         int height = 32;
 
@@ -483,11 +1875,36 @@ void Game::SpawnPeons(bool initial)
             obj->m_state = Peon::IDLE;
         }
 
-        m_gameObjects.push_back(obj);
+        Handle handle = AddObject(obj);
+        if (handle.IsNull())
+        {
+            break;
+        }
+
+        m_peonObjects.push_back(handle);
         m_peons++;
+
+        if (handle.GetIndex() >= m_peonXs.size())
+        {
+            m_peonXs.resize(handle.GetIndex() + 1);
+            m_peonYs.resize(handle.GetIndex() + 1);
+        }
+        m_peonXs[handle.GetIndex()] = (float)obj->GetPosition().GetX();
+        m_peonYs[handle.GetIndex()] = (float)obj->GetPosition().GetY();
+
+        PeonSpawnedEvent event = { handle, m_peons };
+        m_events.Publish(event);
     }
 
     m_peonsToSpawn = 0;
+
+    // Every peon runs at most one behavior at a time
+    m_behaviorPool.Reserve(m_peonObjects.size());
+
+    // Room for the grid separation builds every tick
+    size_t capacity = m_peonObjects.capacity();
+    m_neighborGrid.Reserve(capacity);
+    m_telemetry.Reserve(capacity);
 }
 
 void Game::SacrificePeon(Peon* peon)
@@ -503,46 +1920,236 @@ void Game::SacrificePeon(Peon* peon)
         m_peonsToSpawn++;
 
         m_resources -= 100;
+
+        PeonSacrificedEvent event = { peon->GetHandle(), m_resources };
+        m_events.Publish(event);
+
+        // The respawned peon starts out unselected, everyone else's
+        // selection stays as it was
+        for (int player = 0; player < LockstepSession::MAX_PLAYERS; player++)
+        {
+            if (m_selectedPeons[player].Remove(peon->GetHandle()))
+            {
+                NotifySelectionChanged(player);
+            }
+        }
     }
     else
     {
         peon->m_state = Peon::IDLE;
     }
+}
+
+CoroutinePool<PeonBehavior>& Game::GetBehaviorPool()
+{
+    return m_behaviorPool;
+}
 
-    m_selectedPeons.clear();
+const FlowField& Game::GetFlowField() const
+{
+    return m_flowField;
+}
+
+void Game::NotifySelectionChanged(int player)
+{
+    SelectionChangedEvent event = { player, m_selectedPeons[player].GetCount() };
+    m_events.Publish(event);
 }
 
-void Game::CommandPeons(GameObject* target)
+void Game::CommandPeons(int player, GameObject* target, const Vector2D& position)
 {
-    for (std::vector<Peon*>::const_iterator it = m_selectedPeons.begin(); it != m_selectedPeons.end(); it++)
+    if (target == nullptr)
     {
-        (*it)->m_isWandering = false;
-        if (target == nullptr)
+        MovePeons(player, position);
+        return;
+    }
+
+    m_selectedPeons[player].ForEach([this, target](uint32_t index)
+    {
+        Peon* peon = GetPeon(m_gameObjects.HandleOfSlot(index));
+        if (peon == nullptr)
         {
-            (*it)->dest = Vector2D(mouseX - 16, mouseY - 16);
-            (*it)->m_targetResource = nullptr;
-            (*it)->m_state = Peon::WALKING;
+            return;
         }
-        else
+
+        Wake(peon);
+        peon->m_isWandering = false;
+        peon->m_isReturning = false;
+        if (peon->m_targetResource != target->GetHandle())
         {
-            if ((*it)->m_targetResource != target)
-            {
-                (*it)->m_state = Peon::IDLE;
-                (*it)->m_targetResource = target;
-            }
+            peon->m_state = Peon::IDLE;
+            peon->m_targetResource = target->GetHandle();
+        }
+
+        if (target->m_ID == "bonfire")
+        {
+            peon->m_bonfire = target->GetHandle();
+            peon->m_state = Peon::SACRIFICE;
+        }
+    });
+}
+
+void Game::MovePeons(int player, const Vector2D& position)
+{
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    // Destroyed peons leave the selection right away, so every bit is a
+    // live peon with a stored position. The spots replace the positions.
+    const SelectionSet& selection = m_selectedPeons[player];
+    FrameArena& arena = FrameArena::ForThisThread();
+    float* xs = arena.AllocateArray<float>(selection.GetCount());
+    float* ys = arena.AllocateArray<float>(selection.GetCount());
+
+    int count = 0;
+    selection.ForEach([this, xs, ys, &count](uint32_t index)
+    {
+        xs[count] = m_peonXs[index];
+        ys[count] = m_peonYs[index];
+        count++;
+    });
+
+    m_formation.Assign((float)position.GetX(), (float)position.GetY(), xs, ys, count, xs, ys);
+
+    // The only pass that visits the peons, in the same order as above
+    int i = 0;
+    selection.ForEach([this, xs, ys, &i](uint32_t index)
+    {
+        Peon* peon = GetPeon(m_gameObjects.HandleOfSlot(index));
+        Wake(peon);
+        peon->m_isWandering = false;
+        peon->m_isReturning = false;
+        peon->m_targetResource = Handle();
+        peon->m_state = Peon::WALKING;
+
+        // The outer rings of a big crowd can reach past the edge of the
+        // world, so those spots end up along it
+        double x = std::min(std::max((double)xs[i], 0.0), (double)(WINDOW_WIDTH - peon->GetWidth()));
+        double y = std::min(std::max((double)ys[i], 0.0), (double)(WINDOW_HEIGHT - peon->GetHeight()));
+        peon->dest = Vector2D(x, y);
+        i++;
+    });
+
+    Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+    if (elapsed > m_slowestOrder)
+    {
+        m_slowestOrder = elapsed;
+        m_slowestOrderPeons = count;
+    }
+}
+
+void Game::SetControlGroup(int player, int group)
+{
+    if (group < 0 || group >= CONTROL_GROUPS)
+    {
+        return;
+    }
+
+    const SelectionSet& selection = m_selectedPeons[player];
+    std::vector<Handle>& members = m_controlGroups[player][group];
+    if (members.capacity() < selection.GetCount())
+    {
+        // Only grows along with the world
+        AllocationExemption exemption;
+        members.reserve(selection.GetCount());
+    }
+
+    members.clear();
+    selection.ForEach([this, &members](uint32_t index)
+    {
+        members.push_back(m_gameObjects.HandleOfSlot(index));
+    });
+}
+
+void Game::RecallControlGroup(int player, int group)
+{
+    if (group < 0 || group >= CONTROL_GROUPS)
+    {
+        return;
+    }
+
+    // Peons that are gone by now leave the group for good
+    std::vector<Handle>& members = m_controlGroups[player][group];
+    members.erase(std::remove_if(members.begin(), members.end(),
+        [this](Handle h) { return GetPeon(h) == nullptr; }), members.end());
+
+    SelectionSet& selection = m_selectedPeons[player];
+    selection.Clear();
+    for (std::vector<Handle>::const_iterator it = members.begin(); it != members.end(); it++)
+    {
+        selection.Add(*it);
+    }
+    NotifySelectionChanged(player);
+}
+
+SelectionSet& Game::GetSelection(int player)
+{
+    return m_selectedPeons[player];
+}
+
+const std::vector<Handle>& Game::GetPeonHandles() const
+{
+    return m_peonObjects;
+}
 
-            if (target->m_ID == "bonfire")
+Handle Game::GetMainBonfire() const
+{
+    return m_bonfire;
+}
+
+void Game::SeparatePeons(PeonSample& sample)
+{
+    // Gather positions, bucket them into the grid and push apart anyone who
+    // is standing on top of a neighbour.
+    size_t count = m_peonObjects.size();
+    bool recording = m_telemetry.IsOpen();
+    sample.x.resize(count);
+    sample.y.resize(count);
+    sample.states.resize(recording ? count : 0);
+    for (size_t i = 0; i < count; i++)
+    {
+        const Peon* peon = GetPeon(m_peonObjects[i]);
+        Vector2D position = peon->GetPosition();
+        sample.x[i] = (float)position.GetX();
+        sample.y[i] = (float)position.GetY();
+        m_peonXs[m_peonObjects[i].GetIndex()] = sample.x[i];
+        m_peonYs[m_peonObjects[i].GetIndex()] = sample.y[i];
+
+        if (recording)
+        {
+            sample.states[i] = (uint8_t)peon->m_state;
+        }
+    }
+
+    FrameArena& arena = FrameArena::ForThisThread();
+    float* pushX = arena.AllocateArray<float>(count);
+    float* pushY = arena.AllocateArray<float>(count);
+    m_neighborGrid.Build(sample.x.data(), sample.y.data(), (int)count);
+    m_neighborGrid.ComputeSeparation(SEPARATION_RADIUS, pushX, pushY);
+
+    double maxStep = SEPARATION_SPEED * m_deltaTime;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (pushX[i] != 0.0f || pushY[i] != 0.0f)
+        {
+            Vector2D push(pushX[i], pushY[i]);
+            double length = Vector2D::Magnitude(push);
+            if (length > 1.0)
             {
-                (*it)->m_state = Peon::SACRIFICE;
+                push /= length;
             }
-        }
 
+            GetPeon(m_peonObjects[i])->Separate(push * maxStep);
+        }
     }
 }
 
 void Game::DepositResources(int amount)
 {
     m_resources += amount;
+    m_resourcesGathered += amount;
+
+    ResourcesDepositedEvent event = { amount, m_resources };
+    m_events.Publish(event);
 }
 
 int Game::GetResources() const
@@ -550,24 +2157,69 @@ int Game::GetResources() const
     return m_resources;
 }
 
+int Game::GetResourcesGathered() const
+{
+    return m_resourcesGathered;
+}
+
+int Game::GetPeonCount() const
+{
+    return m_peons;
+}
+
+int Game::GetTick() const
+{
+    return m_tick;
+}
+
+int Game::GetWidth() const
+{
+    return WINDOW_WIDTH;
+}
+
+int Game::GetHeight() const
+{
+    return WINDOW_HEIGHT;
+}
+
+int Game::Random()
+{
+    return (int)(m_random() >> 1);
+}
+
 bool Game::LoadTexture(const std::string& path, const std::string& id)
 {
     SDL_Surface* tempSurface = IMG_Load(path.c_str());
     if (tempSurface == nullptr)
     {
-        std::cerr << "Unable to load image " << path << "! SDL_image error: " << IMG_GetError() << std::endl;
+        LOG_ERROR("Unable to load image %s! SDL_image error: %s", path.c_str(), IMG_GetError());
         return false;
     }
 
+    if (m_softwareRenderer)
+    {
+        bool loaded = m_softwareRenderer->LoadTexture(id, tempSurface);
+        if (loaded)
+        {
+            LOG_INFO("Texture %s loaded.", id.c_str());
+            MEMORY_TRACK(MEMORY_TEXTURES, (int64_t)tempSurface->w * tempSurface->h * 4);
+        }
+        SDL_FreeSurface(tempSurface);
+        return loaded;
+    }
+
     SDL_Texture* texture = SDL_CreateTextureFromSurface(m_renderer, tempSurface);
     SDL_FreeSurface(tempSurface);
     if (texture == nullptr)
     {
-        std::cerr << "Unable to create texture from " << path << "! SDL error: " << SDL_GetError() << std::endl;
+        LOG_ERROR("Unable to create texture from %s! SDL error: %s", path.c_str(), SDL_GetError());
         return false;
     }
 
-    std::cout << "Texture " << id << " loaded." << std::endl;
+    LOG_INFO("Texture %s loaded.", id.c_str());
+    MEMORY_TRACK(MEMORY_TEXTURES, TextureBytes(texture));
+
+    MEMORY_SCOPE(MEMORY_STRINGS);
     m_textureMap[id] = texture;
     return true;
 }
@@ -577,7 +2229,22 @@ void Game::RenderTexture(const std::string& id, const int& x, const int& y, cons
     SDL_Rect srcRect = { 0, 0, 32, 32 };
     SDL_Rect destRect = { x, y, width, height };
 
-    SDL_RenderCopyEx(m_renderer, m_textureMap[id], &srcRect, &destRect, 0, 0, SDL_FLIP_NONE);
+    if (m_softwareRenderer)
+    {
+        m_drawCalls++;
+        m_softwareRenderer->DrawImage(id, srcRect, destRect);
+        return;
+    }
+
+    SDL_Texture* texture = m_textureMap[id];
+    if (texture != m_lastTexture)
+    {
+        m_textureSwitches++;
+        m_lastTexture = texture;
+    }
+    m_drawCalls++;
+
+    SDL_RenderCopyEx(m_renderer, texture, &srcRect, &destRect, 0, 0, SDL_FLIP_NONE);
 }
 
 bool Game::LoadFont(const std::string& path, const std::string& id)
@@ -585,38 +2252,86 @@ bool Game::LoadFont(const std::string& path, const std::string& id)
     TTF_Font* font = TTF_OpenFont(path.c_str(), 16);
     if (font == nullptr)
     {
-        std::cerr << "Failed to load font! SDL_ttf error: " << TTF_GetError() << std::endl;
+        LOG_ERROR("Failed to load font! SDL_ttf error: %s", TTF_GetError());
     }
 
-    std::cout << "Font " << id << " loaded." << std::endl;
+    // Estimate the font by the size of its file
+    std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+    int64_t size = file.is_open() ? (int64_t)file.tellg() : 0;
+    MEMORY_TRACK(MEMORY_FONTS, size);
+
+    LOG_INFO("Font %s loaded.", id.c_str());
+    MEMORY_SCOPE(MEMORY_STRINGS);
     m_fontMap[id] = font;
+    m_fontSizes[id] = size;
+    return true;
+}
+
+bool Game::BuildGlyphAtlas(const std::string& fontID)
+{
+    if (!m_glyphAtlas.Build(m_fontMap[fontID]))
+    {
+        return false;
+    }
+
+    // A software window still needs the texture for the F3 overlay
+    SDL_Surface* surface = m_glyphAtlas.GetSurface();
+    if (m_softwareRenderer)
+    {
+        m_softwareRenderer->LoadTexture("glyphs", surface);
+        MEMORY_TRACK(MEMORY_TEXTURES, (int64_t)surface->w * surface->h * 4);
+    }
+    if (m_renderer != nullptr)
+    {
+        m_glyphTexture = SDL_CreateTextureFromSurface(m_renderer, surface);
+        MEMORY_TRACK(MEMORY_TEXTURES, TextureBytes(m_glyphTexture));
+    }
+
+    m_glyphAtlas.FreeSurface();
     return true;
 }
 
-void Game::RenderText(const std::string& fontID, const int& x, const int& y, const std::string& text, SDL_Color color)
+void Game::RenderText(const int& x, const int& y, const std::string& text, SDL_Color color)
 {
-    SDL_Surface* surface = TTF_RenderText_Solid(m_fontMap[fontID], text.c_str(), color);
-    if (surface == nullptr)
+    if (!m_glyphAtlas.IsBuilt())
     {
-        std::cerr << "Failed to render font to surface! SDL_ttf error: " << TTF_GetError() << std::endl;
+        return;
     }
 
-    SDL_Texture* texture = SDL_CreateTextureFromSurface(m_renderer, surface);
-    int width;
-    int height;
-    SDL_QueryTexture(texture, NULL, NULL, &width, &height);
-    if (texture == nullptr)
+    if (!m_softwareRenderer)
     {
-        std::cout << "Failed to create texture from surface! SDL error: " << SDL_GetError() << std::endl;
+        if (m_glyphTexture != m_lastTexture)
+        {
+            m_textureSwitches++;
+            m_lastTexture = m_glyphTexture;
+        }
+
+        m_drawCalls += m_glyphAtlas.RenderText(m_renderer, m_glyphTexture, x, y, text, color);
+        return;
     }
 
-    SDL_Rect srcRect = { 0, 0, width, height };
-    SDL_Rect destRect = { x, y, width, height };
+    int penX = x;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        SDL_Rect glyph = m_glyphAtlas.GetGlyph(text[i]);
+        SDL_Rect destRect = { penX, y, glyph.w, glyph.h };
+        penX += glyph.w;
+        if (glyph.w > 0 && text[i] != ' ')
+        {
+            m_softwareRenderer->DrawImage("glyphs", glyph, destRect, color);
+            m_drawCalls++;
+        }
+    }
+}
 
-    SDL_RenderCopyEx(m_renderer, texture, &srcRect, &destRect, 0, 0, SDL_FLIP_NONE);
+const GlyphAtlas& Game::GetGlyphAtlas() const
+{
+    return m_glyphAtlas;
+}
 
-    SDL_FreeSurface(surface);
-    SDL_DestroyTexture(texture);
+SDL_Texture* Game::GetGlyphTexture() const
+{
+    return m_glyphTexture;
 }
 
 bool Game::LoadSound(const std::string& path, const std::string& id)
@@ -624,16 +2339,99 @@ bool Game::LoadSound(const std::string& path, const std::string& id)
     Mix_Chunk* sound = Mix_LoadWAV(path.c_str());
     if (sound == nullptr)
     {
-        std::cerr << "Failed to load WAV from " << path << "! SDL_mixer Error: " << Mix_GetError() << std::endl;
+        LOG_ERROR("Failed to load WAV from %s! SDL_mixer Error: %s", path.c_str(), Mix_GetError());
         return false;
     }
 
-    std::cout << "Sound " << id << " loaded." << std::endl;
-    m_soundMap[id] = sound;
+    MEMORY_TRACK(MEMORY_SOUNDS, sound->alen);
+
+    LOG_INFO("Sound %s loaded.", id.c_str());
+    m_sounds.push_back(sound);
+
+    MEMORY_SCOPE(MEMORY_STRINGS);
+    m_soundMap[id] = (int)m_sounds.size() - 1;
     return true;
 }
 
-void Game::PlaySound(const std::string& id)
+int Game::GetSoundHandle(const std::string& id) const
+{
+    std::map<std::string, int>::const_iterator it = m_soundMap.find(id);
+    return (it != m_soundMap.end()) ? it->second : -1;
+}
+
+int Game::PanForPosition(double x) const
+{
+    return std::min(std::max((int)(x / WINDOW_WIDTH * 254), 0), 254);
+}
+
+void Game::PlaySound(const std::string& id, int volume, int pan)
+{
+    PlaySound(GetSoundHandle(id), volume, pan);
+}
+
+void Game::PlaySound(int sound, int volume, int pan)
+{
+    // Callable from any thread. The sound is only queued here and played by
+    // the main thread in FlushSounds().
+    SoundCommand command;
+    command.sound = sound;
+    command.volume = volume;
+    command.pan = pan;
+
+    if (!m_soundQueue.TryPush(command))
+    {
+        m_soundOverflows.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    m_idleThrottle.Wake();
+}
+
+void Game::FlushSounds()
+{
+    SoundCommand command;
+    while (m_soundQueue.TryPop(command))
+    {
+        // There is no mixer without a window, so headless runs only drain,
+        // and have no sounds loaded to check against either
+        if (m_options.headless)
+        {
+            continue;
+        }
+
+        if (command.sound < 0 || command.sound >= (int)m_sounds.size())
+        {
+            m_soundsDropped++;
+            continue;
+        }
+
+        int channel = Mix_PlayChannel(-1, m_sounds[command.sound], 0);
+        if (channel < 0)
+        {
+            // No free mixer channel
+            m_soundsDropped++;
+            continue;
+        }
+
+        Mix_Volume(channel, command.volume);
+        if (command.pan == 127)
+        {
+            Mix_SetPanning(channel, 255, 255);
+        }
+        else
+        {
+            Mix_SetPanning(channel, 254 - command.pan, command.pan);
+        }
+
+        m_soundsPlayed++;
+    }
+}
+
+SoundStats Game::GetSoundStats() const
 {
-    Mix_PlayChannel(-1, m_soundMap[id], 0);
+    SoundStats stats;
+    stats.played = m_soundsPlayed;
+    stats.overflows = m_soundOverflows.load(std::memory_order_relaxed);
+    stats.dropped = m_soundsDropped;
+
+    return stats;
 }
@@ -4,46 +4,219 @@
 #include "Tree.hpp"
 #include "Stone.hpp"
 #include "Bonfire.hpp"
+#include "NeighborGrid.hpp"
+#include "Formation.hpp"
+#include "SelectionSet.hpp"
+#include "SlotMap.hpp"
+#include "ResourceIndex.hpp"
+#include "FlowField.hpp"
+#include "Timer.hpp"
+#include "PerfOverlay.hpp"
+#include "GameOptions.hpp"
+#include "MPSCQueue.hpp"
+#include "SoftwareRenderer.hpp"
+#include "LockstepDriver.hpp"
+#include "EventBus.hpp"
+#include "GameEvents.hpp"
+#include "WakeScheduler.hpp"
+#include "FramePacer.hpp"
+#include "IdleThrottle.hpp"
+#include "LatencyHistogram.hpp"
+#include "GlyphAtlas.hpp"
+#include "ParticleSystem.hpp"
+#include "CoroutinePool.hpp"
+#include "RenderSnapshot.hpp"
+#include "TripleBuffer.hpp"
+#include "TelemetryWriter.hpp"
+#include "CpuMeter.hpp"
+#include "FrameArena.hpp"
+#include <random>
+#include <thread>
+
+// A request to play a sound, queued from any thread
+struct SoundCommand
+{
+    int sound;
+    int volume;
+    int pan;
+};
+
+// A command on its way to the simulation thread, with the time of the
+// input event that made it. The time stays on this side of the network.
+struct QueuedCommand
+{
+    PlayerCommand command;
+    Uint32 inputTime;
+};
+
+struct SoundStats
+{
+    uint64_t played;
+    uint64_t overflows;
+    uint64_t dropped;
+};
+
+// A line of HUD text, only formatted again when the value it shows changes
+struct HudLabel
+{
+    HudLabel();
+
+    std::string text;
+    int value;
+    int width;
+};
+
+// Where every peon stood when separation ran, gathered once a tick into the
+// tick's arena and shared with telemetry
+struct PeonSample
+{
+    PeonSample(FrameArena& arena);
+
+    ArenaVector<float> x;
+    ArenaVector<float> y;
+    ArenaVector<uint8_t> states;
+};
 
 class Game
 {
     public:
-        Game();
+        Game(const GameOptions& options);
         ~Game();
 
+        // Runs the game in a window until it is closed
         void Start();
+        int GetExitCode() const;
+
+        // Joins the lockstep session if there is one, sets up whatever draws
+        // the world and builds it. Start() does this first; HeadlessRunner
+        // calls it and then drives the ticks itself.
+        bool Init();
+
+        // Builds the starting world. Init() does this; a world that is only
+        // simulated can call it and then Step() on its own, without SDL
+        // being initialized. Nothing is shared between instances, so worlds
+        // on different threads run independently.
+        void CreateWorld();
+
+        // One fixed tick without a window
+        void Step();
+
+        // Headless runs with --software draw every tick offscreen
+        void RenderOffscreen();
+
         void Update();
         void ProcessInput();
-        void Render();
+        void Render(const RenderSnapshot& snapshot);
         void LeftClick();
         void LeftClickUp();
         void RightClick();
         void RightClickUp();
 
+        // Player input. Applied at once in a single player game, otherwise
+        // queued and applied by the lockstep session on a later tick.
+        void PushCommand(const PlayerCommand& command);
+
+        // Player input from the main thread, handed to the simulation thread
+        // and pushed from there before its next step
+        void QueueCommand(const PlayerCommand& command, Uint32 inputTime);
+        void ApplyCommand(int player, const PlayerCommand& command);
+        uint32_t ComputeChecksum() const;
+
+        // Only set in a lockstep game
+        LockstepDriver* GetLockstep() const;
+        int GetLocalPlayer() const;
+
+        // GameObjects
+        Handle AddObject(GameObject* obj);
+        void DestroyObject(Handle handle);
+        GameObject* GetGameObject(Handle handle) const;
+        Peon* GetPeon(Handle handle) const;
+
+        // Leave an object out of the update loop until wakeTime on the sim
+        // clock, or until something calls Wake() on it
+        void Park(GameObject* obj, double wakeTime);
+        void Wake(GameObject* obj);
+        size_t GetParkedCount() const;
+        size_t GetCoarseCount() const;
+        bool IsInView(const GameObject* obj, int margin) const;
+
         Bonfire* FindBonfire(Peon* peon);
         Tree* FindTree(Peon* peon);
+        Handle FindResource(ResourceType type, Vector2D position) const;
+        Resource* SpawnResource(ResourceType type);
+        void RemoveResource(Resource* resource);
+        void RegrowResources();
+        void ReassignOrphanedPeons();
         void SpawnPeons(bool initial);
         void SacrificePeon(Peon* peon);
-        void CommandPeons(GameObject* target);
+        CoroutinePool<PeonBehavior>& GetBehaviorPool();
+        const FlowField& GetFlowField() const;
+        void CommandPeons(int player, GameObject* target, const Vector2D& position);
+
+        // Formation move for the selection, each peon to a spot of its own
+        void MovePeons(int player, const Vector2D& position);
+
+        // Remember the selection under a number, or select what is left of
+        // a remembered one
+        void SetControlGroup(int player, int group);
+        void RecallControlGroup(int player, int group);
+        SelectionSet& GetSelection(int player);
+        void NotifySelectionChanged(int player);
+        const std::vector<Handle>& GetPeonHandles() const;
+        Handle GetMainBonfire() const;
+        void SeparatePeons(PeonSample& sample);
         void DepositResources(int amount);
         int GetResources() const;
+        int GetResourcesGathered() const;
+        int GetPeonCount() const;
+        int GetTick() const;
+        int GetWidth() const;
+        int GetHeight() const;
 
+        // This world's own dice, so no two worlds share a sequence. Returns
+        // what rand() would, a number from 0 up to at least 32767.
+        int Random();
+
+        const double* GetClock() const;
+        EventBus& GetEvents();
+        ParticleSystem& GetParticles();
         bool CheckCollision(SDL_Rect a, SDL_Rect b);
 
         // Textures
         bool LoadTexture(const std::string& path, const std::string& id);
         void RenderTexture(const std::string& id, const int& x, const int& y, const int& width, const int& height);
 
-        // Fonts
+        // Fonts. Text is drawn from a glyph atlas built for the HUD font.
         bool LoadFont(const std::string& path, const std::string& id);
-        void RenderText(const std::string& fontID, const int& x, const int& y, const std::string& text, SDL_Color color = {0, 0, 0, 255});
+        bool BuildGlyphAtlas(const std::string& fontID);
+        const GlyphAtlas& GetGlyphAtlas() const;
+        SDL_Texture* GetGlyphTexture() const;
+        void RenderText(const int& x, const int& y, const std::string& text, SDL_Color color = {0, 0, 0, 255});
 
         // Sounds
         bool LoadSound(const std::string& path, const std::string& id);
-        void PlaySound(const std::string& id);
+        int GetSoundHandle(const std::string& id) const;
+        int PanForPosition(double x) const;
+        void PlaySound(const std::string& id, int volume = MIX_MAX_VOLUME, int pan = 127);
+        void PlaySound(int sound, int volume = MIX_MAX_VOLUME, int pan = 127);
+        void FlushSounds();
+        SoundStats GetSoundStats() const;
+        const LatencyHistogram& GetInputLatency() const;
+        const CpuMeter& GetCpuMeter() const;
+        uint64_t GetSkippedFrames() const;
+
+        // For the end of a headless run
+        uint64_t GetObjectUpdates() const;
+        double GetSlowestOrderTime() const;
+        int GetSlowestOrderPeons() const;
+        TelemetryWriter& GetTelemetry();
+        double GetTelemetryTime() const;
+        const SoftwareRenderer* GetSoftwareRenderer() const;
+        int GetFramesRendered() const;
 
     public:
         double m_deltaTime;
+        GameOptions m_options;
 
         int mouseX;
         int mouseY;
@@ -55,34 +228,204 @@ class Game
         const std::string WINDOW_TITLE = "LD34 - Celebration Of Jand";
         const int WINDOW_WIDTH = 640;
         const int WINDOW_HEIGHT = 480;
-        bool m_isRunning;
+        std::atomic<bool> m_isRunning;
+        int m_exitCode;
+
+        bool StartSession();
+        void RefreshLabels(const RenderSnapshot& snapshot);
+        void RefreshLabel(HudLabel& label, int value, const char* text);
+        void InitSDL();
+        void InitOffscreen();
+        void LoadAssets();
+        void RenderParticles(const RenderSnapshot& snapshot);
+        void PresentSoftwareFrame();
+        void DumpFrame();
 
         SDL_Window* m_window;
         SDL_Renderer* m_renderer;
 
-        // Input
+        // Simulation time in milliseconds, advanced every tick
+        double m_time;
+        int m_tick;
+
+        // Lockstep multiplayer, only used with --host or --join
+        const double STEP_TIME = 1000.0 / 60.0;
+        const int MAX_CATCHUP_STEPS = 4;
+        std::unique_ptr<LockstepDriver> m_lockstep;
+        int m_localPlayer;
+        double m_stepAccumulator;
+
+        // Simulation thread, only used by windowed games. It runs fixed steps
+        // and hands the world to this thread as snapshots, in return for
+        // the player's commands.
+        void RunSimulation();
+        void StepLocal();
+        void ApplyQueuedCommands();
+        void PublishSnapshot(double tickTime);
+
+        std::thread m_simThread;
+        TripleBuffer<RenderSnapshot> m_snapshots;
+        MPSCQueue<QueuedCommand, 256> m_commandQueue;
+
+        // Input, and how long it takes to reach the screen. The simulation
+        // holds on to the oldest applied input until the tick its command
+        // takes effect on, then numbers it and puts it in every snapshot
+        // until the main thread reports having presented one.
+        void NoteInput(Uint32 inputTime);
+        void PublishInput(RenderSnapshot& snapshot);
+
+        FramePacer m_framePacer;
+        LatencyHistogram m_inputLatency;
+        Uint32 m_oldestInput;
+        int m_inputDueTick;
+        bool m_hasInput;
+        Uint32 m_shownInput;
+        int m_inputSequence;
+        std::atomic<int> m_presentedInput;
+
+        // Only used with --idle-throttle
+        IdleThrottle m_idleThrottle;
+        uint64_t m_framesDrawn;
+        CpuMeter m_cpuMeter;
+
         bool m_buttonsDown[5];
         bool m_buttonsUp[5];
         bool m_buttonsCurrent[5];
+        Uint32 m_buttonTimes[5];
+
+        // Events
+        EventBus m_events;
+
+        // Particles, only set up when something renders them. Without
+        // SDL_RenderGeometry() they are drawn one at a time.
+        const int PARTICLES_PER_LAYER = 1 << 16;
+        ParticleSystem m_particles;
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+        const int PARTICLE_BATCH_SIZE = 4096;
+        std::vector<int> m_particleIndices;
+#endif
+
+        // HUD
+        HudLabel m_resourceLabel;
+        HudLabel m_peonLabel;
+        HudLabel m_selectionLabel;
+
+        // Stats
+        PerfOverlay m_perfOverlay;
+        const int RESERVED_DRAWS = 1024;
+        int m_drawCalls;
+        int m_textureSwitches;
+        SDL_Texture* m_lastTexture;
+
+        // World state recorded every tick with --telemetry
+        void RecordTelemetry(const PeonSample& sample);
+
+        TelemetryWriter m_telemetry;
+        Uint64 m_telemetryTime;
 
         // Textures
         std::map<std::string, SDL_Texture*> m_textureMap;
 
+        // CPU rendering, only used with --software
+        std::unique_ptr<SoftwareRenderer> m_softwareRenderer;
+        SDL_Texture* m_frameTexture;
+        std::FILE* m_dumpFile;
+        int m_framesRendered;
+
         // Fonts
         std::map<std::string, TTF_Font*> m_fontMap;
+        std::map<std::string, int64_t> m_fontSizes;
+        GlyphAtlas m_glyphAtlas;
+        SDL_Texture* m_glyphTexture;
 
         // Sounds
-        std::map<std::string, Mix_Chunk*> m_soundMap;
+        std::map<std::string, int> m_soundMap;
+        std::vector<Mix_Chunk*> m_sounds;
+        MPSCQueue<SoundCommand, 256> m_soundQueue;
+        std::atomic<uint64_t> m_soundOverflows;
+        uint64_t m_soundsPlayed;
+        uint64_t m_soundsDropped;
 
         // GameObjects
-        std::vector<GameObject*> m_gameObjects;
-        GameObject* m_bonfire;
+        void FlushDestroyedObjects();
+        void WakeDueObjects();
+        void UpdateObjects();
+        int ChooseUpdateInterval(const GameObject* obj) const;
+
+        SlotMap<std::unique_ptr<GameObject>> m_gameObjects;
+        std::vector<Handle> m_destroyedObjects;
+
+        // Every bonfire takes deposits, and loaded peons find their way to
+        // the nearest over the flow field. The first is the one the scripted
+        // player sacrifices to.
+        Handle m_bonfire;
+        std::vector<Handle> m_depots;
+        FlowField m_flowField;
+
+        // Static objects, and a count of changes to them for the snapshots
+        std::vector<Handle> m_staticObjects;
+        int m_staticVersion;
+
+        // Objects that get updated every tick, and the ones parked until later
+        std::vector<Handle> m_updateSet;
+        WakeScheduler m_wakeScheduler;
+        uint32_t m_lastWakeTicket;
+        size_t m_parkedObjects;
+        uint64_t m_objectUpdates;
+
+        // Objects of each kind for the F3 overlay, counted as they come and
+        // go rather than every tick
+        void CountObject(const GameObject* obj, int change);
+        int m_peonCount;
+        int m_treeCount;
+        int m_stoneCount;
+        int m_otherCount;
+
+        // Simulation level of detail. Only depends on the world, so both
+        // sides of a lockstep game pick the same levels.
+        const int LOD_NEAR_MARGIN = 96;
+        const int LOD_NEAR_INTERVAL = 2;
+        const int LOD_FAR_INTERVAL = 4;
+        SDL_Rect m_viewRect;
+        size_t m_coarseObjects;
+
+        // Resources
+        const int MAX_TREES = 6;
+        const int MAX_STONES = 3;
+        const double REGROW_TIME = 8000;
+        ResourceIndex m_resourceIndex;
+        std::vector<std::pair<Handle, ResourceType>> m_depletedResources;
+        Timer m_regrowTimer;
+
+        std::vector<Handle> m_peonObjects;
+
+        // Where each peon stood when separation last ran, by the slot index
+        // of its handle, so an order for a crowd reads positions without
+        // visiting every peon
+        std::vector<float> m_peonXs;
+        std::vector<float> m_peonYs;
+        CoroutinePool<PeonBehavior> m_behaviorPool;
+        SelectionSet m_selectedPeons[LockstepSession::MAX_PLAYERS];
+
+        // Control groups 1 to 9, sorted handles of the peons in each
+        static const int CONTROL_GROUPS = 9;
+        std::vector<Handle> m_controlGroups[LockstepSession::MAX_PLAYERS][CONTROL_GROUPS];
+
+        // Crowd separation
+        const float SEPARATION_RADIUS = 14.0f;
+        const double SEPARATION_SPEED = 48.0;
+        NeighborGrid m_neighborGrid;
 
-        std::vector<Peon*> m_selectedPeons;
+        // Formation spots are as far apart as separation pushes, so peons
+        // that arrive stay where they were sent
+        Formation m_formation;
+        Uint64 m_slowestOrder;
+        size_t m_slowestOrderPeons;
 
-        std::stringstream sstream;
         int m_resources;
+        int m_resourcesGathered;
         int m_peons;
+        std::mt19937 m_random;
 
         int m_peonsToSpawn = 10;
 };
@@ -0,0 +1,31 @@
+#pragma once
+#include "PCH.hpp"
+#include "Handle.hpp"
+
+// Events published on the game's EventBus
+
+// A peon dropped its resources off at the bonfire
+struct ResourcesDepositedEvent
+{
+    int amount;
+    int total;
+};
+
+struct PeonSpawnedEvent
+{
+    Handle peon;
+    int total;
+};
+
+// A peon was given to the bonfire, which costs resources
+struct PeonSacrificedEvent
+{
+    Handle peon;
+    int resources;
+};
+
+struct SelectionChangedEvent
+{
+    int player;
+    size_t count;
+};
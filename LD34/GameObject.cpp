@@ -1,16 +1,32 @@
 #include "PCH.hpp"
 #include "GameObject.hpp"
 #include "Game.hpp"
+#include "RenderSnapshot.hpp"
+#include "MemoryTracker.hpp"
+
+GameObject::~GameObject()
+{
+}
 
 void GameObject::Load(Vector2D position, double width, double height, std::string textureID)
 {
     m_position = position;
     m_width = width;
     m_height = height;
+
+    MEMORY_SCOPE(MEMORY_STRINGS);
     m_textureID = textureID;
+
+    // Static objects keep this for good
+    UpdateHitBox();
 }
 
 void GameObject::Update()
+{
+    UpdateHitBox();
+}
+
+void GameObject::UpdateHitBox()
 {
     m_hitBox.x = (int)m_position.GetX();
     m_hitBox.y = (int)m_position.GetY();
@@ -18,9 +34,9 @@ void GameObject::Update()
     m_hitBox.h = (int)m_height;
 }
 
-void GameObject::Render() 
-{ 
-    m_game->RenderTexture(m_textureID, m_position.GetX(), m_position.GetY(), m_width, m_height);
+void GameObject::Render(RenderSnapshot& snapshot)
+{
+    snapshot.AddSprite(m_textureID, m_position.GetX(), m_position.GetY(), m_width, m_height);
 }
 
 void GameObject::Clean()
@@ -46,4 +62,14 @@ double GameObject::GetHeight() const
 SDL_Rect GameObject::GetHitBox() const
 {
     return m_hitBox;
+}
+
+Handle GameObject::GetHandle() const
+{
+    return m_handle;
+}
+
+void GameObject::SetHandle(Handle handle)
+{
+    m_handle = handle;
 }
\ No newline at end of file
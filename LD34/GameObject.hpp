@@ -1,25 +1,51 @@
 #pragma once
 #include "PCH.hpp"
 #include "Vector2D.hpp"
+#include "Handle.hpp"
 
 class Game;
+class RenderSnapshot;
 
 class GameObject
 {
 public:
+    virtual ~GameObject();
+
     virtual void Load(Vector2D position, double width, double height, std::string textureID);
     virtual void Update();
-    virtual void Render();
+    virtual void Render(RenderSnapshot& snapshot);
     virtual void Clean();
 
     Vector2D GetPosition() const;
     double GetWidth() const;
     double GetHeight() const;
     SDL_Rect GetHitBox() const;
+    Handle GetHandle() const;
+    void SetHandle(Handle handle);
 
 public:
     std::string m_ID;
 
+    // Update scheduling, managed by the Game. A parked object holds the
+    // ticket of its pending wake-up and is skipped by the update loop.
+    uint32_t m_wakeTicket = 0;
+    bool m_inUpdateSet = false;
+
+    // Static objects never move or change how they look. They are left out
+    // of the update loop, and drawn from a layer built when one is added or
+    // removed.
+    bool m_isStatic = false;
+
+    // Level of detail. Objects away from the view are updated every
+    // m_updateInterval ticks, and m_step is the time in seconds the current
+    // update has to cover.
+    int m_updateInterval = 1;
+    int m_lastUpdateTick = 0;
+    double m_step = 0;
+
+protected:
+    void UpdateHitBox();
+
 protected:
     Game* m_game;
     Vector2D m_position;
@@ -27,4 +53,5 @@ protected:
     double m_height;
     std::string m_textureID;
     SDL_Rect m_hitBox;
+    Handle m_handle;
 };
\ No newline at end of file
@@ -0,0 +1,221 @@
+#include "PCH.hpp"
+#include "GameOptions.hpp"
+
+GameOptions::GameOptions() :
+    headless(false),
+    maxTicks(0),
+    initialPeons(10),
+    bonfires(1),
+    seed((unsigned int)std::time(0)),
+    script(true),
+    software(false),
+    renderThreads(0),
+    lowLatency(false),
+    idleThrottle(false),
+    dumpEvery(1),
+    telemetryMB(64),
+    allocCheck(0),
+    batchWorlds(0),
+    batchThreads(0),
+    hostPort(0),
+    inputDelay(4),
+    relayPort(0),
+    packetLoss(0.0),
+    latency(0),
+    jitter(0)
+{
+}
+
+bool GameOptions::Parse(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+
+        if (arg == "--headless")
+        {
+            headless = true;
+        }
+        else if (arg == "--ticks" && hasValue)
+        {
+            maxTicks = std::atoi(argv[++i]);
+        }
+        else if (arg == "--peons" && hasValue)
+        {
+            initialPeons = std::atoi(argv[++i]);
+        }
+        else if (arg == "--bonfires" && hasValue)
+        {
+            bonfires = std::min(std::max(std::atoi(argv[++i]), 1), 5);
+        }
+        else if (arg == "--seed" && hasValue)
+        {
+            seed = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--no-script")
+        {
+            script = false;
+        }
+        else if (arg == "--software")
+        {
+            software = true;
+        }
+        else if (arg == "--render-threads" && hasValue)
+        {
+            renderThreads = std::atoi(argv[++i]);
+        }
+        else if (arg == "--low-latency")
+        {
+            lowLatency = true;
+        }
+        else if (arg == "--idle-throttle")
+        {
+            idleThrottle = true;
+        }
+        else if (arg == "--dump" && hasValue)
+        {
+            dumpPath = argv[++i];
+        }
+        else if (arg == "--dump-every" && hasValue)
+        {
+            dumpEvery = std::max(std::atoi(argv[++i]), 1);
+        }
+        else if (arg == "--log" && hasValue)
+        {
+            logPath = argv[++i];
+        }
+        else if (arg == "--telemetry" && hasValue)
+        {
+            telemetryPath = argv[++i];
+        }
+        else if (arg == "--telemetry-mb" && hasValue)
+        {
+            telemetryMB = std::max(std::atoi(argv[++i]), 1);
+        }
+        else if (arg == "--read-telemetry" && hasValue)
+        {
+            readTelemetry = argv[++i];
+        }
+        else if (arg == "--alloc-check" && hasValue)
+        {
+            allocCheck = std::max(std::atoi(argv[++i]), 1);
+        }
+        else if (arg == "--batch" && hasValue)
+        {
+            batchWorlds = std::max(std::atoi(argv[++i]), 1);
+        }
+        else if (arg == "--batch-threads" && hasValue)
+        {
+            batchThreads = std::max(std::atoi(argv[++i]), 0);
+        }
+        else if (arg == "--host" && hasValue)
+        {
+            hostPort = std::atoi(argv[++i]);
+        }
+        else if (arg == "--join" && hasValue)
+        {
+            joinAddress = argv[++i];
+        }
+        else if (arg == "--input-delay" && hasValue)
+        {
+            inputDelay = std::min(std::max(std::atoi(argv[++i]), 1), 60);
+        }
+        else if (arg == "--relay" && hasValue)
+        {
+            relayPort = std::atoi(argv[++i]);
+        }
+        else if (arg == "--relay-to" && hasValue)
+        {
+            relayTarget = argv[++i];
+        }
+        else if (arg == "--loss" && hasValue)
+        {
+            packetLoss = std::atof(argv[++i]);
+        }
+        else if (arg == "--latency" && hasValue)
+        {
+            latency = std::atoi(argv[++i]);
+        }
+        else if (arg == "--jitter" && hasValue)
+        {
+            jitter = std::atoi(argv[++i]);
+        }
+        else
+        {
+            std::cerr << "Unknown option " << arg << std::endl;
+            PrintUsage(argv[0]);
+            return false;
+        }
+    }
+
+    // A headless run needs an end, and so does every world in a batch
+    if (batchWorlds > 0)
+    {
+        headless = true;
+    }
+
+    if (headless && maxTicks <= 0)
+    {
+        maxTicks = 10000;
+    }
+
+    if (hostPort != 0 && !joinAddress.empty())
+    {
+        std::cerr << "Pick either --host or --join" << std::endl;
+        return false;
+    }
+
+    if (relayPort != 0 && relayTarget.empty())
+    {
+        std::cerr << "--relay needs --relay-to" << std::endl;
+        return false;
+    }
+
+    // Frames only exist when something renders them
+    if (!dumpPath.empty())
+    {
+        software = true;
+    }
+
+    // The check covers rendering, but has to be repeatable
+    if (allocCheck > 0)
+    {
+        headless = true;
+        software = true;
+    }
+
+    return true;
+}
+
+void GameOptions::PrintUsage(const char* program) const
+{
+    std::cerr << "Usage: " << program << " [options]" << std::endl;
+    std::cerr << "  --headless          Simulate without a window, audio or rendering" << std::endl;
+    std::cerr << "  --ticks N           Stop after N ticks" << std::endl;
+    std::cerr << "  --peons N           Number of peons to start with" << std::endl;
+    std::cerr << "  --bonfires N        Bonfires to drop resources off at, 1 to 5" << std::endl;
+    std::cerr << "  --seed N            Random seed" << std::endl;
+    std::cerr << "  --no-script         Leave the peons idle in headless runs" << std::endl;
+    std::cerr << "  --software          Render with the CPU rasterizer" << std::endl;
+    std::cerr << "  --render-threads N  Rasterizer threads (default: one per core)" << std::endl;
+    std::cerr << "  --low-latency       Pace frames without vsync to cut input lag" << std::endl;
+    std::cerr << "  --idle-throttle     Skip unchanged frames and sleep until something happens" << std::endl;
+    std::cerr << "  --dump PATH         Save frames to PATH.raw, or to PATH000001.png and so on" << std::endl;
+    std::cerr << "  --dump-every N      Only save every Nth frame" << std::endl;
+    std::cerr << "  --log PATH          Write diagnostics to PATH instead of stderr" << std::endl;
+    std::cerr << "  --telemetry PATH    Record the world every tick to PATH" << std::endl;
+    std::cerr << "  --telemetry-mb N    Size of the telemetry ring (default 64)" << std::endl;
+    std::cerr << "  --read-telemetry PATH  Turn a telemetry file into heatmaps and a CSV" << std::endl;
+    std::cerr << "  --alloc-check N     Fail if N ticks after warm-up allocate memory" << std::endl;
+    std::cerr << "  --batch N           Simulate N headless worlds at once and compare them" << std::endl;
+    std::cerr << "  --batch-threads N   Threads for --batch (default: one per core)" << std::endl;
+    std::cerr << "  --host PORT         Host a two player game" << std::endl;
+    std::cerr << "  --join HOST:PORT    Join a two player game" << std::endl;
+    std::cerr << "  --input-delay N     Ticks between input and its effect (default 4)" << std::endl;
+    std::cerr << "  --relay PORT        Relay a game from PORT instead of playing" << std::endl;
+    std::cerr << "  --relay-to HOST:PORT  Where the relay forwards to" << std::endl;
+    std::cerr << "  --loss PERCENT      Relay packet loss" << std::endl;
+    std::cerr << "  --latency MS        Relay latency" << std::endl;
+    std::cerr << "  --jitter MS         Relay latency variation" << std::endl;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "PCH.hpp"
+
+// Settings picked on the command line
+struct GameOptions
+{
+    GameOptions();
+
+    bool Parse(int argc, char** argv);
+    void PrintUsage(const char* program) const;
+
+    // Run the simulation without a window, audio or rendering
+    bool headless;
+
+    // Stop after this many ticks, or run until quit when 0
+    int maxTicks;
+
+    // Peons spawned at the start of the game
+    int initialPeons;
+
+    // Bonfires to drop resources off at, up to five
+    int bonfires;
+
+    unsigned int seed;
+
+    // Headless runs play with a scripted player unless this is turned off,
+    // in which case the peons are left to idle
+    bool script;
+
+    // Render on the CPU instead of through SDL_Renderer. Headless runs then
+    // render every tick into an offscreen framebuffer.
+    bool software;
+
+    // Rasterizer threads, or 0 for one per core
+    int renderThreads;
+
+    // Pace frames without vsync, sampling input as late as possible
+    bool lowLatency;
+
+    // Skip frames that would show nothing new, and sleep until input or a
+    // change instead, drawing ambient animation at a lower rate
+    bool idleThrottle;
+
+    // Save rendered frames to PATH.raw as one raw RGBA stream, or to
+    // numbered PNG files starting with PATH, every dumpEvery frames
+    std::string dumpPath;
+    int dumpEvery;
+
+    // Write diagnostics to this file instead of stderr
+    std::string logPath;
+
+    // Record the world every tick into a ring of telemetryMB megabytes in
+    // this file, or turn such a file into heatmaps and a CSV and quit
+    std::string telemetryPath;
+    int telemetryMB;
+    std::string readTelemetry;
+
+    // Warm up, then fail if the simulation, sound or rendering allocates
+    // anything during this many ticks. Implies a headless software run.
+    int allocCheck;
+
+    // Simulate this many headless worlds at once instead of playing, seeded
+    // one after another from seed, on batchThreads threads (0 for one per
+    // core), and report how they did
+    int batchWorlds;
+    int batchThreads;
+
+    // Lockstep multiplayer. The host listens on hostPort and the other
+    // player joins at joinAddress ("host:port").
+    int hostPort;
+    std::string joinAddress;
+    int inputDelay;
+
+    // Run as a relay between two players instead of playing, forwarding
+    // relayPort to relayTarget with simulated loss (percent) and latency (ms)
+    int relayPort;
+    std::string relayTarget;
+    double packetLoss;
+    int latency;
+    int jitter;
+};
@@ -0,0 +1,138 @@
+#include "PCH.hpp"
+#include "GlyphAtlas.hpp"
+#include "Logger.hpp"
+
+GlyphAtlas::GlyphAtlas() :
+    m_surface(nullptr),
+    m_height(0)
+{
+    for (int i = 0; i < GLYPH_COUNT; i++)
+    {
+        m_glyphs[i] = SDL_Rect();
+    }
+}
+
+GlyphAtlas::~GlyphAtlas()
+{
+    FreeSurface();
+}
+
+bool GlyphAtlas::Build(TTF_Font* font)
+{
+    if (font == nullptr)
+    {
+        return false;
+    }
+
+    SDL_Color white = { 255, 255, 255, 255 };
+    SDL_Surface* glyphs[GLYPH_COUNT];
+    int width = 0;
+    m_height = 0;
+    for (int i = 0; i < GLYPH_COUNT; i++)
+    {
+        glyphs[i] = TTF_RenderGlyph_Solid(font, (Uint16)(FIRST_CHAR + i), white);
+        if (glyphs[i] != nullptr)
+        {
+            width += glyphs[i]->w;
+            m_height = std::max(m_height, glyphs[i]->h);
+        }
+    }
+
+    FreeSurface();
+    m_surface = SDL_CreateRGBSurfaceWithFormat(0, std::max(width, 1), std::max(m_height, 1), 32, SDL_PIXELFORMAT_RGBA32);
+
+    // Lay the glyphs out in one row
+    int x = 0;
+    for (int i = 0; i < GLYPH_COUNT; i++)
+    {
+        if (glyphs[i] == nullptr)
+        {
+            continue;
+        }
+
+        SDL_Rect dest = { x, 0, glyphs[i]->w, glyphs[i]->h };
+        if (m_surface != nullptr)
+        {
+            SDL_BlitSurface(glyphs[i], nullptr, m_surface, &dest);
+        }
+
+        m_glyphs[i] = dest;
+        x += glyphs[i]->w;
+        SDL_FreeSurface(glyphs[i]);
+    }
+
+    if (m_surface == nullptr)
+    {
+        LOG_ERROR("Unable to create the glyph atlas! SDL error: %s", SDL_GetError());
+        return false;
+    }
+
+    return true;
+}
+
+SDL_Surface* GlyphAtlas::GetSurface() const
+{
+    return m_surface;
+}
+
+void GlyphAtlas::FreeSurface()
+{
+    if (m_surface != nullptr)
+    {
+        SDL_FreeSurface(m_surface);
+        m_surface = nullptr;
+    }
+}
+
+bool GlyphAtlas::IsBuilt() const
+{
+    return m_height > 0;
+}
+
+int GlyphAtlas::GetHeight() const
+{
+    return m_height;
+}
+
+int GlyphAtlas::MeasureText(const char* text) const
+{
+    int width = 0;
+    for (const char* c = text; *c != '\0'; c++)
+    {
+        width += GetGlyph(*c).w;
+    }
+
+    return width;
+}
+
+int GlyphAtlas::RenderText(SDL_Renderer* renderer, SDL_Texture* texture, int x, int y, const std::string& text, SDL_Color color) const
+{
+    // The atlas is white, so tinting it gives any colour
+    SDL_SetTextureColorMod(texture, color.r, color.g, color.b);
+
+    int copies = 0;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        SDL_Rect glyph = GetGlyph(text[i]);
+        SDL_Rect dest = { x, y, glyph.w, glyph.h };
+        x += glyph.w;
+        if (glyph.w > 0 && text[i] != ' ')
+        {
+            SDL_RenderCopy(renderer, texture, &glyph, &dest);
+            copies++;
+        }
+    }
+
+    return copies;
+}
+
+SDL_Rect GlyphAtlas::GetGlyph(char c) const
+{
+    int index = (unsigned char)c - FIRST_CHAR;
+    if (index < 0 || index >= GLYPH_COUNT)
+    {
+        return SDL_Rect();
+    }
+
+    return m_glyphs[index];
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "PCH.hpp"
+
+// Every printable ASCII glyph of a font rendered once, in white, side by side
+// on one surface. Text is then drawn a glyph at a time out of that surface
+// (tinted to the wanted colour), so changing text never renders or uploads
+// anything new.
+class GlyphAtlas
+{
+public:
+    GlyphAtlas();
+    ~GlyphAtlas();
+
+    bool Build(TTF_Font* font);
+
+    // Only needed until the renderer has made its own copy
+    SDL_Surface* GetSurface() const;
+    void FreeSurface();
+
+    bool IsBuilt() const;
+    int GetHeight() const;
+    int MeasureText(const char* text) const;
+
+    // Where a character is on the atlas, or an empty rect if it is not there
+    SDL_Rect GetGlyph(char c) const;
+
+    // Draw with a texture made from the atlas surface, returning the number
+    // of glyphs copied
+    int RenderText(SDL_Renderer* renderer, SDL_Texture* texture, int x, int y, const std::string& text, SDL_Color color) const;
+
+private:
+    static const int FIRST_CHAR = 32;
+    static const int LAST_CHAR = 126;
+    static const int GLYPH_COUNT = LAST_CHAR - FIRST_CHAR + 1;
+
+    SDL_Surface* m_surface;
+    SDL_Rect m_glyphs[GLYPH_COUNT];
+    int m_height;
+};
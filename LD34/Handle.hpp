@@ -0,0 +1,64 @@
+#pragma once
+#include "PCH.hpp"
+
+// 32-bit reference to an object owned by a SlotMap. The low bits index a slot
+// and the high bits hold the slot's generation at the time the handle was made,
+// so a handle to a removed object can be detected instead of dangling.
+// Generation 0 is never handed out, which makes a zeroed handle the null handle.
+class Handle
+{
+public:
+    static const uint32_t INDEX_BITS = 20;
+    static const uint32_t GENERATION_BITS = 32 - INDEX_BITS;
+    static const uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+    static const uint32_t GENERATION_MASK = (1u << GENERATION_BITS) - 1;
+    static const uint32_t MAX_INDEX = INDEX_MASK;
+
+    Handle() :
+        m_value(0)
+    {
+    }
+
+    Handle(uint32_t index, uint32_t generation) :
+        m_value((index & INDEX_MASK) | ((generation & GENERATION_MASK) << INDEX_BITS))
+    {
+    }
+
+    uint32_t GetIndex() const
+    {
+        return m_value & INDEX_MASK;
+    }
+
+    uint32_t GetGeneration() const
+    {
+        return m_value >> INDEX_BITS;
+    }
+
+    uint32_t GetValue() const
+    {
+        return m_value;
+    }
+
+    bool IsNull() const
+    {
+        return m_value == 0;
+    }
+
+    bool operator==(const Handle& other) const
+    {
+        return m_value == other.m_value;
+    }
+
+    bool operator!=(const Handle& other) const
+    {
+        return m_value != other.m_value;
+    }
+
+    bool operator<(const Handle& other) const
+    {
+        return m_value < other.m_value;
+    }
+
+private:
+    uint32_t m_value;
+};
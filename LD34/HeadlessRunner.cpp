@@ -0,0 +1,161 @@
+#include "PCH.hpp"
+#include "HeadlessRunner.hpp"
+#include "AllocationCounter.hpp"
+#include "Game.hpp"
+#include "Logger.hpp"
+#include "MemoryTracker.hpp"
+#include "ScriptPlayer.hpp"
+
+HeadlessRunner::HeadlessRunner(const GameOptions& options) :
+    m_options(options),
+    m_simAllocations(0),
+    m_soundAllocations(0),
+    m_renderAllocations(0),
+    m_worldAllocations(0)
+{
+    if (m_options.allocCheck > 0)
+    {
+        m_options.maxTicks = ALLOC_WARMUP_TICKS + m_options.allocCheck;
+    }
+}
+
+int HeadlessRunner::Run()
+{
+    Game game(m_options);
+    if (!game.Init())
+    {
+        return game.GetExitCode();
+    }
+
+    ScriptPlayer script(&game);
+    LockstepDriver* lockstep = game.GetLockstep();
+
+    Uint64 renderTime = 0;
+    Uint64 startTime = SDL_GetPerformanceCounter();
+    while (game.GetTick() < m_options.maxTicks)
+    {
+        // Exempt allocations are left out of the phases, but kept as a total
+        bool checking = (m_options.allocCheck > 0 && game.GetTick() >= ALLOC_WARMUP_TICKS);
+        uint64_t exemptStart = AllocationCounter::GetExemptAllocations();
+        uint64_t phaseStart = AllocationCounter::GetAllocations() - exemptStart;
+
+        if (m_options.script)
+        {
+            script.Update();
+        }
+
+        if (lockstep != nullptr)
+        {
+            if (!lockstep->TryAdvance())
+            {
+                if (lockstep->IsTimedOut())
+                {
+                    LOG_ERROR("Lost connection to the other player!");
+                    break;
+                }
+
+                SDL_Delay(1);
+                continue;
+            }
+        }
+        else
+        {
+            game.Update();
+        }
+
+        uint64_t simEnd = AllocationCounter::GetAllocations() - AllocationCounter::GetExemptAllocations();
+        game.FlushSounds();
+        uint64_t soundEnd = AllocationCounter::GetAllocations() - AllocationCounter::GetExemptAllocations();
+
+        if (game.GetSoftwareRenderer() != nullptr)
+        {
+            Uint64 renderStart = SDL_GetPerformanceCounter();
+            game.RenderOffscreen();
+            renderTime += SDL_GetPerformanceCounter() - renderStart;
+        }
+
+        if (checking)
+        {
+            m_simAllocations += simEnd - phaseStart;
+            m_soundAllocations += soundEnd - simEnd;
+            m_renderAllocations += AllocationCounter::GetAllocations() - AllocationCounter::GetExemptAllocations() - soundEnd;
+            m_worldAllocations += AllocationCounter::GetExemptAllocations() - exemptStart;
+        }
+    }
+    double seconds = (double)(SDL_GetPerformanceCounter() - startTime) / SDL_GetPerformanceFrequency();
+
+    PrintStats(game, seconds, renderTime);
+
+    int exitCode = 0;
+    if (m_options.allocCheck > 0 && !PrintAllocationCheck(game.GetTick() - ALLOC_WARMUP_TICKS))
+    {
+        exitCode = 1;
+    }
+
+    if (MemoryTracker::IsEnabled())
+    {
+        MemoryTracker::Report("memory_report.txt");
+    }
+
+    return exitCode;
+}
+
+void HeadlessRunner::PrintStats(Game& game, double seconds, Uint64 renderTime) const
+{
+    int ticks = game.GetTick();
+    std::cout << "Simulated " << ticks << " ticks in " << seconds << "s (" << (ticks / seconds) << " ticks/s)" << std::endl;
+    std::cout << "Resources " << game.GetResources() << ", peons " << game.GetPeonCount() << std::endl;
+    std::cout << "Updated " << ((double)game.GetObjectUpdates() / std::max(ticks, 1)) << " objects per tick, "
+        << game.GetParkedCount() << " parked at the end" << std::endl;
+    std::cout << "Frame arena peaked at " << (FrameArena::ForThisThread().GetHighWater() >> 10) << " KB" << std::endl;
+    std::cout << "Flow field refreshed " << game.GetFlowField().GetRefreshCount() << " times" << std::endl;
+    if (game.GetSlowestOrderPeons() > 0)
+    {
+        std::cout << "Slowest formation order took " << game.GetSlowestOrderTime() << " ms for " << game.GetSlowestOrderPeons() << " peons" << std::endl;
+    }
+
+    TelemetryWriter& telemetry = game.GetTelemetry();
+    if (telemetry.IsOpen())
+    {
+        telemetry.Close();
+
+        double telemetryMs = game.GetTelemetryTime();
+        std::cout << "Recorded " << telemetry.GetRecordCount() << " telemetry records (" << (telemetry.GetBytesWritten() >> 10)
+            << " KB), " << (telemetryMs / std::max(ticks, 1)) << " ms per tick, " << (telemetryMs / 10 / seconds) << "% of the run, "
+            << telemetry.GetStalls() << " stalls" << std::endl;
+    }
+
+    if (game.GetLockstep() != nullptr)
+    {
+        game.GetLockstep()->Finish(2000);
+    }
+
+    const SoftwareRenderer* softwareRenderer = game.GetSoftwareRenderer();
+    if (softwareRenderer != nullptr && game.GetFramesRendered() > 0)
+    {
+        double renderMs = (double)renderTime * 1000 / SDL_GetPerformanceFrequency() / game.GetFramesRendered();
+        std::cout << "Rendered " << game.GetFramesRendered() << " frames, " << renderMs << " ms per frame" << std::endl;
+        std::cout << "Last frame checksum " << std::hex << softwareRenderer->Checksum() << std::dec << std::endl;
+    }
+}
+
+bool HeadlessRunner::PrintAllocationCheck(int ticks) const
+{
+    std::cout << "Allocations in " << ticks << " ticks after warm-up: sim " << m_simAllocations
+        << ", sound " << m_soundAllocations << ", render " << m_renderAllocations
+        << " (" << m_worldAllocations << " more from adding objects to the world)" << std::endl;
+
+    if (ticks < m_options.allocCheck)
+    {
+        std::cout << "Allocation check failed, the run ended early" << std::endl;
+        return false;
+    }
+    else if (m_simAllocations + m_soundAllocations + m_renderAllocations > 0)
+    {
+        std::cout << "Allocation check failed" << std::endl;
+        return false;
+    }
+
+    std::cout << "Allocation check passed" << std::endl;
+    return true;
+}
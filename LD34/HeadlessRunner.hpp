@@ -0,0 +1,35 @@
+#pragma once
+#include "PCH.hpp"
+#include "GameOptions.hpp"
+
+class Game;
+
+// Runs one world without a window up to --ticks, with the scripted player
+// standing in for input. A lockstep game waits on the other player's input
+// for each tick, and with --software every tick is also drawn offscreen.
+// Prints how the run went at the end.
+//
+// With --alloc-check the run goes on that many ticks past a warm-up, and
+// counts the heap allocations made in each phase of a tick. Any allocation
+// by the simulation, the sounds or the drawing fails the check; adding
+// objects to the world is exempt, and only reported.
+class HeadlessRunner
+{
+public:
+    HeadlessRunner(const GameOptions& options);
+
+    int Run();
+
+private:
+    void PrintStats(Game& game, double seconds, Uint64 renderTime) const;
+    bool PrintAllocationCheck(int ticks) const;
+
+private:
+    static const int ALLOC_WARMUP_TICKS = 600;
+
+    GameOptions m_options;
+    uint64_t m_simAllocations;
+    uint64_t m_soundAllocations;
+    uint64_t m_renderAllocations;
+    uint64_t m_worldAllocations;
+};
@@ -0,0 +1,128 @@
+#include "PCH.hpp"
+#include "IdleThrottle.hpp"
+#include "RenderSnapshot.hpp"
+
+static bool HasParticles(const RenderSnapshot& snapshot)
+{
+    for (int layer = 0; layer < PARTICLE_LAYER_COUNT; layer++)
+    {
+        if (!snapshot.particles[layer].empty())
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+IdleThrottle::IdleThrottle() :
+    m_wakeEvent((Uint32)-1),
+    m_waiting(false),
+    m_publishedSceneHash(0),
+    m_idle(false),
+    m_drawnSceneHash(0),
+    m_drawnTick(-1),
+    m_lastFrameTime(0),
+    m_framesSkipped(0)
+{
+}
+
+void IdleThrottle::Init()
+{
+    m_wakeEvent = SDL_RegisterEvents(1);
+}
+
+bool IdleThrottle::IsWakeEvent(const SDL_Event& event) const
+{
+    return event.type == m_wakeEvent;
+}
+
+int IdleThrottle::ChooseWait(const RenderSnapshot& snapshot) const
+{
+    if (!m_idle)
+    {
+        return 0;
+    }
+
+    if (!HasParticles(snapshot))
+    {
+        return IDLE_WAIT_MAX;
+    }
+
+    double due = m_lastFrameTime + IDLE_FRAME_TIME - SDL_GetTicks();
+    return std::min(std::max((int)std::ceil(due), 1), IDLE_WAIT_MAX);
+}
+
+void IdleThrottle::Arm()
+{
+    m_waiting = true;
+}
+
+bool IdleThrottle::ShouldDraw(const RenderSnapshot& snapshot, bool hadInput)
+{
+    if (!hadInput && !IsFrameWorthDrawing(snapshot))
+    {
+        m_idle = true;
+        m_framesSkipped++;
+        return false;
+    }
+
+    m_waiting = false;
+    return true;
+}
+
+void IdleThrottle::FrameDrawn(const RenderSnapshot& snapshot, double time)
+{
+    m_idle = false;
+    m_drawnSceneHash = snapshot.sceneHash;
+    m_drawnTick = snapshot.stats.tick;
+    m_lastFrameTime = time;
+}
+
+bool IdleThrottle::IsIdle() const
+{
+    return m_idle;
+}
+
+void IdleThrottle::Published(uint32_t sceneHash)
+{
+    if (sceneHash != m_publishedSceneHash)
+    {
+        m_publishedSceneHash = sceneHash;
+        Wake();
+    }
+}
+
+void IdleThrottle::Wake()
+{
+    // Only pushes an event when the main thread has gone to sleep on one
+    if (m_waiting.exchange(false))
+    {
+        SDL_Event event;
+        SDL_zero(event);
+        event.type = m_wakeEvent;
+        SDL_PushEvent(&event);
+    }
+}
+
+uint64_t IdleThrottle::GetSkippedFrames() const
+{
+    return m_framesSkipped;
+}
+
+bool IdleThrottle::IsFrameWorthDrawing(const RenderSnapshot& snapshot) const
+{
+    // Nothing new since the last frame drawn
+    if (snapshot.stats.tick == m_drawnTick)
+    {
+        return false;
+    }
+
+    if (snapshot.sceneHash != m_drawnSceneHash)
+    {
+        return true;
+    }
+
+    // Only the particles moved, which can wait for the next idle frame
+    return HasParticles(snapshot) && SDL_GetTicks() - m_lastFrameTime >= IDLE_FRAME_TIME;
+}
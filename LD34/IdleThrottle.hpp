@@ -0,0 +1,53 @@
+#pragma once
+#include "PCH.hpp"
+#include <atomic>
+
+class RenderSnapshot;
+
+// Idle throttling for --idle-throttle. A frame that would look like the last
+// one drawn is skipped, and the main thread sleeps in SDL_WaitEventTimeout()
+// until there is input, the simulation wakes it with a change or a sound, or
+// the next frame of ambient animation such as the flames is due.
+class IdleThrottle
+{
+public:
+    IdleThrottle();
+
+    // Registers the event the simulation wakes the main thread with
+    void Init();
+    bool IsWakeEvent(const SDL_Event& event) const;
+
+    // Main thread. How long to block for the first event, 0 to only poll.
+    int ChooseWait(const RenderSnapshot& snapshot) const;
+
+    // Main thread. Asks to be woken, then looks at the latest snapshot and
+    // skips it when it is not worth drawing. Asking first means a change
+    // published in between is not missed.
+    void Arm();
+    bool ShouldDraw(const RenderSnapshot& snapshot, bool hadInput);
+    void FrameDrawn(const RenderSnapshot& snapshot, double time);
+    bool IsIdle() const;
+
+    // Simulation thread. Wakes the main thread when the scene published
+    // differs from the one before, or for a sound.
+    void Published(uint32_t sceneHash);
+    void Wake();
+
+    uint64_t GetSkippedFrames() const;
+
+private:
+    bool IsFrameWorthDrawing(const RenderSnapshot& snapshot) const;
+
+private:
+    const double IDLE_FRAME_TIME = 1000.0 / 15;
+    const int IDLE_WAIT_MAX = 250;
+
+    Uint32 m_wakeEvent;
+    std::atomic<bool> m_waiting;
+    uint32_t m_publishedSceneHash;
+    bool m_idle;
+    uint32_t m_drawnSceneHash;
+    int m_drawnTick;
+    double m_lastFrameTime;
+    uint64_t m_framesSkipped;
+};
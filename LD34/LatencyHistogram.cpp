@@ -0,0 +1,91 @@
+#include "PCH.hpp"
+#include "LatencyHistogram.hpp"
+
+LatencyHistogram::LatencyHistogram()
+{
+    Clear();
+}
+
+void LatencyHistogram::Add(double milliseconds)
+{
+    milliseconds = std::max(milliseconds, 0.0);
+    int bucket = std::min((int)milliseconds, (int)BUCKET_COUNT);
+    m_buckets[bucket]++;
+
+    m_count++;
+    m_total += milliseconds;
+    m_max = std::max(m_max, milliseconds);
+}
+
+void LatencyHistogram::Clear()
+{
+    for (int i = 0; i <= BUCKET_COUNT; i++)
+    {
+        m_buckets[i] = 0;
+    }
+
+    m_count = 0;
+    m_total = 0;
+    m_max = 0;
+}
+
+uint64_t LatencyHistogram::GetCount() const
+{
+    return m_count;
+}
+
+double LatencyHistogram::GetMax() const
+{
+    return m_max;
+}
+
+double LatencyHistogram::GetMean() const
+{
+    return (m_count > 0) ? m_total / m_count : 0.0;
+}
+
+int LatencyHistogram::GetPercentile(double p) const
+{
+    if (m_count == 0)
+    {
+        return 0;
+    }
+
+    uint64_t wanted = (uint64_t)std::ceil(p * m_count);
+    uint64_t seen = 0;
+    for (int i = 0; i <= BUCKET_COUNT; i++)
+    {
+        seen += m_buckets[i];
+        if (seen >= wanted && seen > 0)
+        {
+            return i;
+        }
+    }
+
+    return BUCKET_COUNT;
+}
+
+void LatencyHistogram::Print(std::ostream& out) const
+{
+    out << "Input latency over " << m_count << " frames: mean " << GetMean() << " ms, p50 " << GetPercentile(0.5)
+        << " ms, p90 " << GetPercentile(0.9) << " ms, p99 " << GetPercentile(0.99) << " ms, max " << m_max << " ms" << std::endl;
+
+    uint64_t largest = 0;
+    for (int i = 0; i <= BUCKET_COUNT; i++)
+    {
+        largest = std::max(largest, m_buckets[i]);
+    }
+
+    for (int i = 0; i <= BUCKET_COUNT; i++)
+    {
+        if (m_buckets[i] == 0)
+        {
+            continue;
+        }
+
+        char label[16];
+        snprintf(label, sizeof(label), (i < BUCKET_COUNT) ? "%4d ms " : "%3d+ ms ", i);
+        int width = (int)((m_buckets[i] * PRINT_WIDTH + largest - 1) / largest);
+        out << label << std::string(width, '#') << " " << m_buckets[i] << std::endl;
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "PCH.hpp"
+
+// Distribution of input-to-present latencies in whole milliseconds, with
+// everything past the last bucket counted together
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void Add(double milliseconds);
+    void Clear();
+
+    uint64_t GetCount() const;
+    double GetMax() const;
+    double GetMean() const;
+
+    // Smallest latency that p (0 to 1) of the samples are at or under
+    int GetPercentile(double p) const;
+
+    void Print(std::ostream& out) const;
+
+private:
+    static const int BUCKET_COUNT = 100;
+    static const int PRINT_WIDTH = 40;
+
+    uint64_t m_buckets[BUCKET_COUNT + 1];
+    uint64_t m_count;
+    double m_total;
+    double m_max;
+};
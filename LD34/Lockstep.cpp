@@ -0,0 +1,569 @@
+#include "PCH.hpp"
+#include "Lockstep.hpp"
+#include "Logger.hpp"
+
+static const uint8_t PACKET_MAGIC = 0x4A;
+
+enum PacketType
+{
+    PACKET_HELLO = 1,
+    PACKET_WELCOME,
+    PACKET_INPUT
+};
+
+// Little-endian serialization into a fixed buffer. Writing or reading past
+// the end only clears the ok flag, so a short packet is simply rejected.
+class PacketWriter
+{
+public:
+    PacketWriter(uint8_t* data, int capacity) :
+        m_data(data),
+        m_capacity(capacity),
+        m_size(0)
+    {
+    }
+
+    void Write8(uint8_t value)
+    {
+        if (m_size < m_capacity)
+        {
+            m_data[m_size] = value;
+        }
+        m_size++;
+    }
+
+    void Write16(uint16_t value)
+    {
+        Write8((uint8_t)value);
+        Write8((uint8_t)(value >> 8));
+    }
+
+    void Write32(uint32_t value)
+    {
+        Write16((uint16_t)value);
+        Write16((uint16_t)(value >> 16));
+    }
+
+    bool IsOk() const
+    {
+        return m_size <= m_capacity;
+    }
+
+    int GetSize() const
+    {
+        return m_size;
+    }
+
+private:
+    uint8_t* m_data;
+    int m_capacity;
+    int m_size;
+};
+
+class PacketReader
+{
+public:
+    PacketReader(const uint8_t* data, int size) :
+        m_data(data),
+        m_size(size),
+        m_position(0)
+    {
+    }
+
+    uint8_t Read8()
+    {
+        uint8_t value = (m_position < m_size) ? m_data[m_position] : 0;
+        m_position++;
+        return value;
+    }
+
+    uint16_t Read16()
+    {
+        uint16_t low = Read8();
+        return (uint16_t)(low | (Read8() << 8));
+    }
+
+    uint32_t Read32()
+    {
+        uint32_t low = Read16();
+        return low | ((uint32_t)Read16() << 16);
+    }
+
+    bool IsOk() const
+    {
+        return m_position <= m_size;
+    }
+
+private:
+    const uint8_t* m_data;
+    int m_size;
+    int m_position;
+};
+
+LockstepSession::LockstepSession() :
+    m_localPlayer(0),
+    m_connected(false),
+    m_lastLocalTick(-1),
+    m_peerAck(-1),
+    m_remoteComplete(-1),
+    m_lastChecksumTick(-1),
+    m_lastChecksum(0),
+    m_desyncTick(-1),
+    m_lastSendTime(0),
+    m_lastReceiveTime(0),
+    m_inputChanged(false)
+{
+    m_settings.seed = 0;
+    m_settings.initialPeons = 0;
+    m_settings.bonfires = 1;
+    m_settings.inputDelay = 1;
+
+    m_stats.packetsSent = 0;
+    m_stats.packetsReceived = 0;
+    m_stats.bytesSent = 0;
+    m_stats.stalls = 0;
+}
+
+bool LockstepSession::Host(uint16_t port, const SessionSettings& settings)
+{
+    if (!m_socket.Open(port))
+    {
+        return false;
+    }
+
+    m_settings = settings;
+    m_localPlayer = 0;
+
+    LOG_INFO("Waiting for a player to join on port %d...", (int)port);
+    Uint32 startTime = SDL_GetTicks();
+    while (!m_connected && SDL_GetTicks() - startTime < HANDSHAKE_TIMEOUT)
+    {
+        Poll();
+        SDL_Delay(5);
+    }
+
+    if (!m_connected)
+    {
+        LOG_ERROR("Nobody joined!");
+        return false;
+    }
+
+    LOG_INFO("Player joined from %s", m_peer.ToString().c_str());
+    return true;
+}
+
+bool LockstepSession::Join(const std::string& hostAndPort)
+{
+    if (!NetAddress::Resolve(hostAndPort, m_peer))
+    {
+        LOG_ERROR("Unable to resolve %s!", hostAndPort.c_str());
+        return false;
+    }
+
+    if (!m_socket.Open(0))
+    {
+        return false;
+    }
+
+    m_localPlayer = 1;
+
+    LOG_INFO("Joining %s...", m_peer.ToString().c_str());
+    Uint32 startTime = SDL_GetTicks();
+    Uint32 lastHello = 0;
+    while (!m_connected && SDL_GetTicks() - startTime < HANDSHAKE_TIMEOUT)
+    {
+        if (lastHello == 0 || SDL_GetTicks() - lastHello > 100)
+        {
+            SendHello();
+            lastHello = SDL_GetTicks();
+        }
+
+        Poll();
+        SDL_Delay(5);
+    }
+
+    if (!m_connected)
+    {
+        LOG_ERROR("No answer from %s!", m_peer.ToString().c_str());
+        return false;
+    }
+
+    LOG_INFO("Joined game with seed %u", (unsigned int)m_settings.seed);
+    return true;
+}
+
+int LockstepSession::GetLocalPlayer() const
+{
+    return m_localPlayer;
+}
+
+const SessionSettings& LockstepSession::GetSettings() const
+{
+    return m_settings;
+}
+
+void LockstepSession::ResetBuffers()
+{
+    for (int player = 0; player < MAX_PLAYERS; player++)
+    {
+        for (int i = 0; i < INPUT_WINDOW; i++)
+        {
+            m_inputs[player][i].tick = -1;
+        }
+    }
+
+    for (int i = 0; i < INPUT_WINDOW; i++)
+    {
+        m_localChecksums[i].tick = -1;
+        m_remoteChecksums[i].tick = -1;
+    }
+
+    // Nobody can have input for the ticks inside the delay, so they start
+    // out empty on both sides
+    TickInput empty;
+    empty.count = 0;
+    for (int tick = 0; tick < m_settings.inputDelay; tick++)
+    {
+        for (int player = 0; player < MAX_PLAYERS; player++)
+        {
+            InputSlot& slot = m_inputs[player][tick % INPUT_WINDOW];
+            slot.tick = tick;
+            slot.input = empty;
+        }
+    }
+
+    m_lastLocalTick = m_settings.inputDelay - 1;
+    m_peerAck = m_settings.inputDelay - 1;
+    m_remoteComplete = m_settings.inputDelay - 1;
+    m_lastReceiveTime = SDL_GetTicks();
+}
+
+void LockstepSession::SubmitLocalInput(int tick, std::vector<PlayerCommand>& pending)
+{
+    while (m_lastLocalTick < tick + m_settings.inputDelay)
+    {
+        TickInput input;
+        input.count = (uint8_t)std::min((int)pending.size(), TickInput::MAX_COMMANDS);
+        std::copy(pending.begin(), pending.begin() + input.count, input.commands);
+        pending.erase(pending.begin(), pending.begin() + input.count);
+
+        m_lastLocalTick++;
+        StoreInput(m_localPlayer, m_lastLocalTick, input);
+        m_inputChanged = true;
+    }
+}
+
+bool LockstepSession::HasInput(int tick) const
+{
+    for (int player = 0; player < MAX_PLAYERS; player++)
+    {
+        if (m_inputs[player][tick % INPUT_WINDOW].tick != tick)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+const TickInput& LockstepSession::GetInput(int player, int tick) const
+{
+    return m_inputs[player][tick % INPUT_WINDOW].input;
+}
+
+void LockstepSession::StoreInput(int player, int tick, const TickInput& input)
+{
+    InputSlot& slot = m_inputs[player][tick % INPUT_WINDOW];
+    if (slot.tick == tick)
+    {
+        return;
+    }
+
+    slot.tick = tick;
+    slot.input = input;
+
+    if (player != m_localPlayer)
+    {
+        while (m_inputs[player][(m_remoteComplete + 1) % INPUT_WINDOW].tick == m_remoteComplete + 1)
+        {
+            m_remoteComplete++;
+        }
+    }
+}
+
+void LockstepSession::RecordChecksum(int tick, uint32_t checksum)
+{
+    ChecksumSlot& slot = m_localChecksums[tick % INPUT_WINDOW];
+    slot.tick = tick;
+    slot.checksum = checksum;
+
+    m_lastChecksumTick = tick;
+    m_lastChecksum = checksum;
+
+    const ChecksumSlot& remote = m_remoteChecksums[tick % INPUT_WINDOW];
+    if (remote.tick == tick)
+    {
+        CompareChecksum(tick, checksum, remote.checksum);
+    }
+}
+
+void LockstepSession::CompareChecksum(int tick, uint32_t local, uint32_t remote)
+{
+    if (local == remote || m_desyncTick >= 0)
+    {
+        return;
+    }
+
+    m_desyncTick = tick;
+    LOG_ERROR("Desync detected at tick %d! Local checksum %x, remote %x", (int)tick, (unsigned int)local, (unsigned int)remote);
+}
+
+bool LockstepSession::IsDesynced() const
+{
+    return m_desyncTick >= 0;
+}
+
+int LockstepSession::GetDesyncTick() const
+{
+    return m_desyncTick;
+}
+
+void LockstepSession::Poll()
+{
+    uint8_t buffer[MAX_PACKET_SIZE];
+    NetAddress from;
+    int size;
+    while ((size = m_socket.Receive(from, buffer, sizeof(buffer))) >= 0)
+    {
+        HandlePacket(from, buffer, size);
+    }
+}
+
+void LockstepSession::HandlePacket(const NetAddress& from, const uint8_t* data, int size)
+{
+    PacketReader reader(data, size);
+    if (reader.Read8() != PACKET_MAGIC)
+    {
+        return;
+    }
+
+    uint8_t type = reader.Read8();
+    if (type == PACKET_HELLO && m_localPlayer == 0)
+    {
+        // Answer again if our welcome got lost, but only ever take one peer
+        if (!m_connected)
+        {
+            m_peer = from;
+            m_connected = true;
+            ResetBuffers();
+        }
+
+        if (from == m_peer)
+        {
+            SendWelcome();
+        }
+        return;
+    }
+
+    if (from != m_peer)
+    {
+        return;
+    }
+
+    if (type == PACKET_WELCOME && !m_connected)
+    {
+        SessionSettings settings;
+        settings.seed = reader.Read32();
+        settings.initialPeons = reader.Read16();
+        settings.bonfires = reader.Read8();
+        settings.inputDelay = reader.Read8();
+        if (!reader.IsOk() || settings.inputDelay < 1)
+        {
+            return;
+        }
+
+        m_settings = settings;
+        m_connected = true;
+        ResetBuffers();
+        return;
+    }
+
+    if (type != PACKET_INPUT || !m_connected)
+    {
+        return;
+    }
+
+    int player = reader.Read8();
+    int count = reader.Read8();
+    int ack = (int)reader.Read32();
+    int firstTick = (int)reader.Read32();
+    int checksumTick = (int)reader.Read32();
+    uint32_t checksum = reader.Read32();
+    if (!reader.IsOk() || player == m_localPlayer || player >= MAX_PLAYERS || count > MAX_INPUTS_PER_PACKET)
+    {
+        return;
+    }
+
+    // Parse everything before storing anything, so a truncated packet
+    // cannot leave half of its input behind
+    TickInput inputs[MAX_INPUTS_PER_PACKET];
+    for (int i = 0; i < count; i++)
+    {
+        TickInput& input = inputs[i];
+        input.count = reader.Read8();
+        if (input.count > TickInput::MAX_COMMANDS)
+        {
+            return;
+        }
+
+        for (int c = 0; c < input.count; c++)
+        {
+            PlayerCommand& command = input.commands[c];
+            command.type = reader.Read8();
+            command.x = (int16_t)reader.Read16();
+            command.y = (int16_t)reader.Read16();
+            command.w = (int16_t)reader.Read16();
+            command.h = (int16_t)reader.Read16();
+        }
+    }
+
+    if (!reader.IsOk())
+    {
+        return;
+    }
+
+    m_stats.packetsReceived++;
+    m_lastReceiveTime = SDL_GetTicks();
+
+    if (ack > m_peerAck)
+    {
+        m_peerAck = std::min(ack, m_lastLocalTick);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        int tick = firstTick + i;
+
+        // Ignore anything outside the window we can hold
+        if (tick > m_remoteComplete && tick <= m_remoteComplete + INPUT_WINDOW / 2)
+        {
+            StoreInput(player, tick, inputs[i]);
+        }
+    }
+
+    if (checksumTick >= 0)
+    {
+        const ChecksumSlot& local = m_localChecksums[checksumTick % INPUT_WINDOW];
+        if (local.tick == checksumTick)
+        {
+            CompareChecksum(checksumTick, local.checksum, checksum);
+        }
+        else
+        {
+            ChecksumSlot& slot = m_remoteChecksums[checksumTick % INPUT_WINDOW];
+            slot.tick = checksumTick;
+            slot.checksum = checksum;
+        }
+    }
+}
+
+void LockstepSession::SendHello()
+{
+    uint8_t buffer[8];
+    PacketWriter writer(buffer, sizeof(buffer));
+    writer.Write8(PACKET_MAGIC);
+    writer.Write8(PACKET_HELLO);
+    m_socket.Send(m_peer, buffer, writer.GetSize());
+}
+
+void LockstepSession::SendWelcome()
+{
+    uint8_t buffer[16];
+    PacketWriter writer(buffer, sizeof(buffer));
+    writer.Write8(PACKET_MAGIC);
+    writer.Write8(PACKET_WELCOME);
+    writer.Write32(m_settings.seed);
+    writer.Write16((uint16_t)m_settings.initialPeons);
+    writer.Write8((uint8_t)m_settings.bonfires);
+    writer.Write8((uint8_t)m_settings.inputDelay);
+    m_socket.Send(m_peer, buffer, writer.GetSize());
+}
+
+void LockstepSession::Send(bool force)
+{
+    if (!m_connected)
+    {
+        return;
+    }
+
+    // New input goes out at once, otherwise only resend every so often
+    Uint32 now = SDL_GetTicks();
+    if (!force && !m_inputChanged && now - m_lastSendTime < RESEND_INTERVAL)
+    {
+        return;
+    }
+
+    int firstTick = m_peerAck + 1;
+    int count = std::min(m_lastLocalTick - m_peerAck, (int)MAX_INPUTS_PER_PACKET);
+
+    uint8_t buffer[MAX_PACKET_SIZE];
+    PacketWriter writer(buffer, sizeof(buffer));
+    writer.Write8(PACKET_MAGIC);
+    writer.Write8(PACKET_INPUT);
+    writer.Write8((uint8_t)m_localPlayer);
+    writer.Write8((uint8_t)count);
+    writer.Write32((uint32_t)m_remoteComplete);
+    writer.Write32((uint32_t)firstTick);
+    writer.Write32((uint32_t)m_lastChecksumTick);
+    writer.Write32(m_lastChecksum);
+
+    for (int i = 0; i < count; i++)
+    {
+        const TickInput& input = GetInput(m_localPlayer, firstTick + i);
+        writer.Write8(input.count);
+        for (int c = 0; c < input.count; c++)
+        {
+            const PlayerCommand& command = input.commands[c];
+            writer.Write8(command.type);
+            writer.Write16((uint16_t)command.x);
+            writer.Write16((uint16_t)command.y);
+            writer.Write16((uint16_t)command.w);
+            writer.Write16((uint16_t)command.h);
+        }
+    }
+
+    if (writer.IsOk() && m_socket.Send(m_peer, buffer, writer.GetSize()))
+    {
+        m_stats.packetsSent++;
+        m_stats.bytesSent += writer.GetSize();
+    }
+
+    m_lastSendTime = now;
+    m_inputChanged = false;
+}
+
+void LockstepSession::CountStall()
+{
+    m_stats.stalls++;
+}
+
+void LockstepSession::Linger(int milliseconds)
+{
+    Uint32 startTime = SDL_GetTicks();
+    while (m_connected && m_peerAck < m_lastLocalTick && (int)(SDL_GetTicks() - startTime) < milliseconds)
+    {
+        Poll();
+        Send(false);
+        SDL_Delay(1);
+    }
+}
+
+bool LockstepSession::IsTimedOut() const
+{
+    return m_connected && SDL_GetTicks() - m_lastReceiveTime > PEER_TIMEOUT;
+}
+
+const LockstepStats& LockstepSession::GetStats() const
+{
+    return m_stats;
+}
@@ -0,0 +1,150 @@
+#pragma once
+#include "PCH.hpp"
+#include "UdpSocket.hpp"
+
+enum CommandType
+{
+    COMMAND_NONE,
+    COMMAND_DESELECT,
+    COMMAND_SELECT,
+    COMMAND_MOVE,
+    COMMAND_SET_GROUP,
+    COMMAND_RECALL_GROUP
+};
+
+// One player action. Selection is sent as the box that was dragged, a
+// command as the clicked point and a control group as its number in x, and
+// every peer resolves them against its own copy of the world, so commands
+// stay the same size however many peons exist.
+struct PlayerCommand
+{
+    uint8_t type;
+    int16_t x;
+    int16_t y;
+    int16_t w;
+    int16_t h;
+};
+
+struct TickInput
+{
+    static const int MAX_COMMANDS = 4;
+
+    uint8_t count;
+    PlayerCommand commands[MAX_COMMANDS];
+};
+
+// Settings the host hands to the joining player, so both build the same world
+struct SessionSettings
+{
+    unsigned int seed;
+    int initialPeons;
+    int bonfires;
+    int inputDelay;
+};
+
+struct LockstepStats
+{
+    uint64_t packetsSent;
+    uint64_t packetsReceived;
+    uint64_t bytesSent;
+    uint64_t stalls;
+};
+
+// Two player deterministic lockstep over UDP. Only player input is exchanged:
+// input sampled on tick T is scheduled for tick T + input delay and sent to
+// the peer right away, and the simulation may only run a tick once it holds
+// both players' input for it. Every packet repeats all input the peer has
+// not acknowledged yet, so lost packets need no separate resend. Each packet
+// also carries a checksum of the sender's latest simulated tick, which is
+// compared against the local one to detect a desync.
+class LockstepSession
+{
+public:
+    static const int MAX_PLAYERS = 2;
+
+    LockstepSession();
+
+    // Block until a peer has joined, or the timeout runs out
+    bool Host(uint16_t port, const SessionSettings& settings);
+    bool Join(const std::string& hostAndPort);
+
+    int GetLocalPlayer() const;
+    const SessionSettings& GetSettings() const;
+
+    // Schedule pending commands on every tick up to tick + input delay that
+    // has no local input yet. Commands that do not fit wait for the next tick.
+    void SubmitLocalInput(int tick, std::vector<PlayerCommand>& pending);
+
+    bool HasInput(int tick) const;
+    const TickInput& GetInput(int player, int tick) const;
+
+    void RecordChecksum(int tick, uint32_t checksum);
+    bool IsDesynced() const;
+    int GetDesyncTick() const;
+
+    void Poll();
+    void Send(bool force);
+    void CountStall();
+
+    // Keep answering the peer for a while, so it receives our last input
+    // even when this side stops first
+    void Linger(int milliseconds);
+
+    bool IsTimedOut() const;
+    const LockstepStats& GetStats() const;
+
+private:
+    struct InputSlot
+    {
+        int tick;
+        TickInput input;
+    };
+
+    struct ChecksumSlot
+    {
+        int tick;
+        uint32_t checksum;
+    };
+
+    void SendHello();
+    void SendWelcome();
+    void HandlePacket(const NetAddress& from, const uint8_t* data, int size);
+    void StoreInput(int player, int tick, const TickInput& input);
+    void CompareChecksum(int tick, uint32_t local, uint32_t remote);
+    void ResetBuffers();
+
+private:
+    static const int INPUT_WINDOW = 256;
+    static const int MAX_INPUTS_PER_PACKET = 32;
+    static const int MAX_PACKET_SIZE = 1400;
+    static const int HANDSHAKE_TIMEOUT = 60000;
+    static const int PEER_TIMEOUT = 5000;
+    static const int RESEND_INTERVAL = 15;
+
+    UdpSocket m_socket;
+    NetAddress m_peer;
+    int m_localPlayer;
+    bool m_connected;
+    SessionSettings m_settings;
+
+    InputSlot m_inputs[MAX_PLAYERS][INPUT_WINDOW];
+    ChecksumSlot m_localChecksums[INPUT_WINDOW];
+    ChecksumSlot m_remoteChecksums[INPUT_WINDOW];
+
+    // Last tick with local input, and the last tick up to which the peer
+    // has received all of it
+    int m_lastLocalTick;
+    int m_peerAck;
+
+    // Last tick up to which all of the peer's input has arrived here
+    int m_remoteComplete;
+
+    int m_lastChecksumTick;
+    uint32_t m_lastChecksum;
+    int m_desyncTick;
+
+    Uint32 m_lastSendTime;
+    Uint32 m_lastReceiveTime;
+    bool m_inputChanged;
+    LockstepStats m_stats;
+};
@@ -0,0 +1,135 @@
+#include "PCH.hpp"
+#include "LockstepDriver.hpp"
+#include "Game.hpp"
+#include "GameOptions.hpp"
+#include "Logger.hpp"
+
+LockstepDriver::LockstepDriver(Game* game) :
+    m_game(game)
+{
+}
+
+bool LockstepDriver::Connect(GameOptions& options)
+{
+    if (options.hostPort != 0)
+    {
+        SessionSettings settings;
+        settings.seed = options.seed;
+        settings.initialPeons = options.initialPeons;
+        settings.bonfires = options.bonfires;
+        settings.inputDelay = options.inputDelay;
+        if (!m_session.Host((uint16_t)options.hostPort, settings))
+        {
+            return false;
+        }
+    }
+    else if (!m_session.Join(options.joinAddress))
+    {
+        return false;
+    }
+
+    const SessionSettings& settings = m_session.GetSettings();
+    options.seed = settings.seed;
+    options.initialPeons = settings.initialPeons;
+    options.bonfires = settings.bonfires;
+    options.inputDelay = settings.inputDelay;
+    return true;
+}
+
+int LockstepDriver::GetLocalPlayer() const
+{
+    return m_session.GetLocalPlayer();
+}
+
+int LockstepDriver::GetInputDelay() const
+{
+    return m_session.GetSettings().inputDelay;
+}
+
+void LockstepDriver::PushCommand(const PlayerCommand& command)
+{
+    m_localCommands.push_back(command);
+}
+
+bool LockstepDriver::Step(double& accumulator, double stepTime)
+{
+    m_session.Poll();
+    while (accumulator >= stepTime)
+    {
+        if (!Advance())
+        {
+            m_session.CountStall();
+            break;
+        }
+        accumulator -= stepTime;
+    }
+    m_session.Send(false);
+
+    if (m_session.IsTimedOut())
+    {
+        LOG_ERROR("Lost connection to the other player!");
+        return false;
+    }
+    return true;
+}
+
+bool LockstepDriver::TryAdvance()
+{
+    m_session.Poll();
+    bool advanced = Advance();
+    m_session.Send(false);
+
+    if (!advanced)
+    {
+        m_session.CountStall();
+    }
+    return advanced;
+}
+
+bool LockstepDriver::IsTimedOut() const
+{
+    return m_session.IsTimedOut();
+}
+
+bool LockstepDriver::Advance()
+{
+    int tick = m_game->GetTick();
+    m_session.SubmitLocalInput(tick, m_localCommands);
+    if (!m_session.HasInput(tick))
+    {
+        return false;
+    }
+
+    // Players are always applied in the same order on every machine
+    for (int player = 0; player < LockstepSession::MAX_PLAYERS; player++)
+    {
+        const TickInput& input = m_session.GetInput(player, tick);
+        for (int i = 0; i < input.count; i++)
+        {
+            m_game->ApplyCommand(player, input.commands[i]);
+        }
+    }
+
+    m_game->Update();
+    m_session.RecordChecksum(tick, m_game->ComputeChecksum());
+    return true;
+}
+
+void LockstepDriver::Finish(int lingerTime)
+{
+    m_session.Linger(lingerTime);
+
+    int tick = m_game->GetTick();
+    const LockstepStats& stats = m_session.GetStats();
+    std::cout << "Player " << GetLocalPlayer() << " finished tick " << tick << " with checksum " << std::hex << m_game->ComputeChecksum() << std::dec << std::endl;
+    std::cout << "Sent " << stats.packetsSent << " packets (" << stats.bytesSent << " bytes, " << ((double)stats.bytesSent / std::max(tick, 1)) << " bytes/tick), received " << stats.packetsReceived << ", stalled " << stats.stalls << " times" << std::endl;
+
+    if (m_session.IsDesynced())
+    {
+        std::cout << "Desynced at tick " << m_session.GetDesyncTick() << std::endl;
+    }
+    else
+    {
+        std::cout << "No desync detected" << std::endl;
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "PCH.hpp"
+#include "Lockstep.hpp"
+
+struct GameOptions;
+class Game;
+
+// Runs a game's ticks from a lockstep session. Local commands go out with
+// the next tick the session schedules, and a tick only runs once every
+// player's commands for it have arrived, applied in the same player order on
+// every machine.
+class LockstepDriver
+{
+public:
+    LockstepDriver(Game* game);
+
+    // Hosts or joins as the options ask. Afterwards the options hold the
+    // host's settings, so both sides build the same world from them.
+    bool Connect(GameOptions& options);
+
+    int GetLocalPlayer() const;
+    int GetInputDelay() const;
+
+    // Queued for the next tick the session schedules
+    void PushCommand(const PlayerCommand& command);
+
+    // Windowed games. Runs as many of the fixed steps in the accumulator as
+    // input has arrived for, and returns false once the peer is lost.
+    bool Step(double& accumulator, double stepTime);
+
+    // Headless games. Runs the next tick if its input is in, counting a
+    // stall when it is not.
+    bool TryAdvance();
+    bool IsTimedOut() const;
+
+    // Keeps answering the peer for a while, then prints how it went
+    void Finish(int lingerTime);
+
+private:
+    bool Advance();
+
+private:
+    Game* m_game;
+    LockstepSession m_session;
+    std::vector<PlayerCommand> m_localCommands;
+};
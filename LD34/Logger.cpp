@@ -0,0 +1,185 @@
+#include "PCH.hpp"
+#include "Logger.hpp"
+#include "MPSCQueue.hpp"
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+struct LogEntry
+{
+    uint32_t time;
+    LogLevel level;
+    char text[248];
+};
+
+static const char* const LEVEL_NAMES[] = { "INFO ", "WARN ", "ERROR" };
+
+static MPSCQueue<LogEntry, 1024> s_queue;
+static std::atomic<uint64_t> s_dropped(0);
+static std::atomic<bool> s_running(false);
+static std::thread s_writer;
+static std::FILE* s_file = nullptr;
+static const std::chrono::steady_clock::time_point s_startTime = std::chrono::steady_clock::now();
+
+// Milliseconds since the program started
+static uint32_t Now()
+{
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - s_startTime).count();
+}
+
+LogRateLimit::LogRateLimit() :
+    m_tokens(BURST),
+    m_lastRefill(0),
+    m_suppressed(0)
+{
+}
+
+bool LogRateLimit::Allow(uint32_t now, uint32_t& suppressed)
+{
+    // Only the thread that moves the refill time forward hands out tokens
+    uint32_t last = m_lastRefill.load(std::memory_order_relaxed);
+    uint32_t elapsed = now - last;
+    if (elapsed >= REFILL_TIME && m_lastRefill.compare_exchange_strong(last, now - elapsed % REFILL_TIME))
+    {
+        int refill = (int)std::min(elapsed / REFILL_TIME, (uint32_t)BURST);
+        int tokens = m_tokens.load(std::memory_order_relaxed);
+        while (!m_tokens.compare_exchange_weak(tokens, std::min(tokens + refill, (int)BURST)))
+        {
+        }
+    }
+
+    if (m_tokens.fetch_sub(1) <= 0)
+    {
+        m_tokens.fetch_add(1);
+        m_suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    suppressed = m_suppressed.exchange(0, std::memory_order_relaxed);
+    return true;
+}
+
+// Drain the queue, formatting as many lines as fit into one write
+static void WriteQueued(std::FILE* out)
+{
+    char batch[8192];
+    size_t used = 0;
+
+    LogEntry entry;
+    char line[320];
+    for (;;)
+    {
+        int length = 0;
+        if (s_queue.TryPop(entry))
+        {
+            length = snprintf(line, sizeof(line), "[%6u.%03u] %s %s\n", entry.time / 1000, entry.time % 1000, LEVEL_NAMES[entry.level], entry.text);
+        }
+        else
+        {
+            uint64_t dropped = s_dropped.exchange(0);
+            if (dropped == 0)
+            {
+                break;
+            }
+
+            length = snprintf(line, sizeof(line), "[%6u.%03u] %s %llu messages dropped, the log buffer was full\n", Now() / 1000, Now() % 1000, LEVEL_NAMES[LOG_LEVEL_WARNING], (unsigned long long)dropped);
+        }
+
+        length = std::min(std::max(length, 0), (int)sizeof(line) - 1);
+        if (used + length > sizeof(batch))
+        {
+            std::fwrite(batch, 1, used, out);
+            used = 0;
+        }
+
+        std::memcpy(batch + used, line, length);
+        used += length;
+    }
+
+    if (used > 0)
+    {
+        std::fwrite(batch, 1, used, out);
+        std::fflush(out);
+    }
+}
+
+static void WriterLoop()
+{
+    std::FILE* out = (s_file != nullptr) ? s_file : stderr;
+    while (s_running.load())
+    {
+        WriteQueued(out);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    WriteQueued(out);
+}
+
+void Logger::Start(const std::string& path)
+{
+    if (s_running.load())
+    {
+        return;
+    }
+
+    if (!path.empty())
+    {
+        s_file = std::fopen(path.c_str(), "w");
+        if (s_file == nullptr)
+        {
+            LOG_ERROR("Unable to open %s for logging, using stderr", path.c_str());
+        }
+    }
+
+    s_running.store(true);
+    s_writer = std::thread(WriterLoop);
+}
+
+void Logger::Stop()
+{
+    if (!s_running.load())
+    {
+        WriteQueued(stderr);
+        return;
+    }
+
+    s_running.store(false);
+    s_writer.join();
+
+    if (s_file != nullptr)
+    {
+        std::fclose(s_file);
+        s_file = nullptr;
+    }
+}
+
+void Logger::Write(LogRateLimit& limit, LogLevel level, const char* format, ...)
+{
+    uint32_t now = Now();
+    uint32_t suppressed = 0;
+    if (!limit.Allow(now, suppressed))
+    {
+        return;
+    }
+
+    LogEntry entry;
+    entry.time = now;
+    entry.level = level;
+
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(entry.text, sizeof(entry.text), format, args);
+    va_end(args);
+
+    if (suppressed > 0 && length >= 0 && length < (int)sizeof(entry.text))
+    {
+        snprintf(entry.text + length, sizeof(entry.text) - length, " (%u more like this suppressed)", suppressed);
+    }
+
+    if (!s_queue.TryPush(entry))
+    {
+        s_dropped.fetch_add(1);
+    }
+}
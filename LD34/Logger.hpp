@@ -0,0 +1,54 @@
+#pragma once
+#include "PCH.hpp"
+#include <atomic>
+
+enum LogLevel
+{
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARNING,
+    LOG_LEVEL_ERROR
+};
+
+// Lets a burst of messages through from one place in the code, then only
+// a couple a second, counting the ones it held back
+class LogRateLimit
+{
+public:
+    LogRateLimit();
+
+    // False if the message should be dropped. Otherwise suppressed is set
+    // to how many were dropped since the last one that got through.
+    bool Allow(uint32_t now, uint32_t& suppressed);
+
+private:
+    static const int BURST = 20;
+    static const uint32_t REFILL_TIME = 500;
+
+    std::atomic<int> m_tokens;
+    std::atomic<uint32_t> m_lastRefill;
+    std::atomic<uint32_t> m_suppressed;
+};
+
+// Diagnostics are formatted on the calling thread into a lock-free ring
+// buffer, and a background thread writes them out in batches to stderr or a
+// file. Logging never blocks or flushes on the caller's thread; when the
+// buffer is full the message is dropped and counted instead. Use the LOG_
+// macros below rather than calling Write() directly.
+class Logger
+{
+public:
+    // Messages logged before Start() wait in the buffer
+    static void Start(const std::string& path);
+
+    // Writes out everything still queued
+    static void Stop();
+
+    static void Write(LogRateLimit& limit, LogLevel level, const char* format, ...);
+};
+
+// Each use of a macro is rate limited on its own, so an error repeated every
+// frame cannot flood the log
+#define LOG_WRITE(level, ...) do { static LogRateLimit logRateLimit; Logger::Write(logRateLimit, level, __VA_ARGS__); } while (0)
+#define LOG_INFO(...) LOG_WRITE(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARNING(...) LOG_WRITE(LOG_LEVEL_WARNING, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_WRITE(LOG_LEVEL_ERROR, __VA_ARGS__)
@@ -0,0 +1,86 @@
+#pragma once
+#include "PCH.hpp"
+#include <atomic>
+
+// Bounded lock-free queue for many producers and a single consumer. Each cell
+// carries a sequence number that tells producers whether it is free and tells
+// the consumer whether it has been filled, so neither side ever blocks: a push
+// into a full queue fails and the caller decides what to do with the value.
+template <typename T, size_t Capacity>
+class MPSCQueue
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "MPSCQueue capacity must be a power of two");
+
+public:
+    MPSCQueue() :
+        m_tail(0),
+        m_head(0)
+    {
+        for (size_t i = 0; i < Capacity; i++)
+        {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Safe to call from any thread
+    bool TryPush(const T& value)
+    {
+        Cell* cell;
+        size_t position = m_tail.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &m_cells[position & (Capacity - 1)];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+
+            if (difference == 0)
+            {
+                if (m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (difference < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->value = value;
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Only ever call from the consuming thread
+    bool TryPop(T& value)
+    {
+        Cell* cell = &m_cells[m_head & (Capacity - 1)];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        if ((intptr_t)sequence - (intptr_t)(m_head + 1) < 0)
+        {
+            return false;
+        }
+
+        value = cell->value;
+        cell->sequence.store(m_head + Capacity, std::memory_order_release);
+        m_head++;
+        return true;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    Cell m_cells[Capacity];
+
+    // Keep the producer and consumer cursors on separate cache lines
+    alignas(64) std::atomic<size_t> m_tail;
+    alignas(64) size_t m_head;
+};
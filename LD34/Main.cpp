@@ -1,12 +1,55 @@
 #include "PCH.hpp"
+#include "AllocationCounter.hpp"
+#include "BatchRunner.hpp"
 #include "Game.hpp"
+#include "GameOptions.hpp"
+#include "HeadlessRunner.hpp"
+#include "Logger.hpp"
+#include "NetRelay.hpp"
+#include "TelemetryReader.hpp"
 
 int main(int argc, char** argv)
 {
-    std::srand(std::time(0));
+    GameOptions options;
+    if (!options.Parse(argc, argv))
+    {
+        return 1;
+    }
 
-    Game game;
-    game.Start();
+    Logger::Start(options.logPath);
 
-    return 0;
+    int exitCode = 0;
+    if (options.relayPort != 0)
+    {
+        NetRelay relay(options);
+        exitCode = relay.Run();
+    }
+    else if (!options.readTelemetry.empty())
+    {
+        TelemetryReader reader(options);
+        exitCode = reader.Run();
+    }
+    else if (options.batchWorlds > 0)
+    {
+        BatchRunner runner(options);
+        exitCode = runner.Run();
+    }
+    else if (options.headless)
+    {
+        AllocationCounter::InstallSDLHooks();
+
+        HeadlessRunner runner(options);
+        exitCode = runner.Run();
+    }
+    else
+    {
+        AllocationCounter::InstallSDLHooks();
+
+        Game game(options);
+        game.Start();
+        exitCode = game.GetExitCode();
+    }
+
+    Logger::Stop();
+    return exitCode;
 }
\ No newline at end of file
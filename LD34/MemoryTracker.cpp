@@ -0,0 +1,182 @@
+#include "PCH.hpp"
+#include "MemoryTracker.hpp"
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <new>
+
+// Every tracked allocation is prefixed with its size and tag. The header is
+// padded to keep the returned pointer aligned like malloc's.
+struct AllocationHeader
+{
+    std::size_t size;
+    MemoryTag tag;
+};
+
+static const std::size_t HEADER_SIZE = (sizeof(AllocationHeader) + 15) & ~(std::size_t)15;
+
+static std::atomic<int64_t> s_current[MEMORY_TAG_COUNT];
+static std::atomic<int64_t> s_peak[MEMORY_TAG_COUNT];
+static std::atomic<int64_t> s_count[MEMORY_TAG_COUNT];
+static std::atomic<int64_t> s_total[MEMORY_TAG_COUNT];
+
+static thread_local MemoryTag s_currentTag = MEMORY_UNTAGGED;
+
+static void Record(MemoryTag tag, int64_t bytes)
+{
+    int64_t current = s_current[tag].fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    s_count[tag].fetch_add(1, std::memory_order_relaxed);
+    s_total[tag].fetch_add(1, std::memory_order_relaxed);
+
+    int64_t peak = s_peak[tag].load(std::memory_order_relaxed);
+    while (current > peak && !s_peak[tag].compare_exchange_weak(peak, current, std::memory_order_relaxed))
+    {
+    }
+}
+
+static void Unrecord(MemoryTag tag, int64_t bytes)
+{
+    s_current[tag].fetch_sub(bytes, std::memory_order_relaxed);
+    s_count[tag].fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool MemoryTracker::IsEnabled()
+{
+#if JAND_MEMORY_TRACKING
+    return true;
+#else
+    return false;
+#endif
+}
+
+void* MemoryTracker::Allocate(std::size_t size)
+{
+    char* block = (char*)std::malloc(size + HEADER_SIZE);
+    if (block == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    AllocationHeader* header = (AllocationHeader*)block;
+    header->size = size;
+    header->tag = s_currentTag;
+    Record(header->tag, (int64_t)size);
+
+    return block + HEADER_SIZE;
+}
+
+void MemoryTracker::Free(void* ptr)
+{
+    if (ptr == nullptr)
+    {
+        return;
+    }
+
+    char* block = (char*)ptr - HEADER_SIZE;
+    AllocationHeader* header = (AllocationHeader*)block;
+    Unrecord(header->tag, (int64_t)header->size);
+
+    std::free(block);
+}
+
+MemoryTag MemoryTracker::GetCurrentTag()
+{
+    return s_currentTag;
+}
+
+MemoryTag MemoryTracker::SetCurrentTag(MemoryTag tag)
+{
+    MemoryTag previous = s_currentTag;
+    s_currentTag = tag;
+
+    return previous;
+}
+
+void MemoryTracker::TrackExternal(MemoryTag tag, int64_t bytes)
+{
+    Record(tag, bytes);
+}
+
+void MemoryTracker::UntrackExternal(MemoryTag tag, int64_t bytes)
+{
+    Unrecord(tag, bytes);
+}
+
+MemoryStats MemoryTracker::GetStats(MemoryTag tag)
+{
+    MemoryStats stats;
+    stats.current = s_current[tag].load(std::memory_order_relaxed);
+    stats.peak = s_peak[tag].load(std::memory_order_relaxed);
+    stats.count = s_count[tag].load(std::memory_order_relaxed);
+    stats.total = s_total[tag].load(std::memory_order_relaxed);
+
+    return stats;
+}
+
+const char* MemoryTracker::GetTagName(MemoryTag tag)
+{
+    switch (tag)
+    {
+        case MEMORY_UNTAGGED: return "untagged";
+        case MEMORY_OBJECTS: return "objects";
+        case MEMORY_CONTAINERS: return "containers";
+        case MEMORY_STRINGS: return "strings";
+        case MEMORY_FRAME: return "frame";
+        case MEMORY_TEXTURES: return "textures";
+        case MEMORY_FONTS: return "fonts";
+        case MEMORY_SOUNDS: return "sounds";
+        default: return "unknown";
+    }
+}
+
+void MemoryTracker::WriteReport(std::ostream& out)
+{
+    if (!IsEnabled())
+    {
+        out << "Memory tracking is disabled. Build with JAND_MEMORY_TRACKING to enable it." << std::endl;
+        return;
+    }
+
+    out << std::left << std::setw(12) << "tag"
+        << std::right << std::setw(14) << "current" << std::setw(14) << "peak"
+        << std::setw(10) << "live" << std::setw(12) << "total" << std::endl;
+
+    MemoryStats sum = MemoryStats();
+    for (int i = 0; i < MEMORY_TAG_COUNT; i++)
+    {
+        MemoryStats stats = GetStats((MemoryTag)i);
+        out << std::left << std::setw(12) << GetTagName((MemoryTag)i)
+            << std::right << std::setw(14) << stats.current << std::setw(14) << stats.peak
+            << std::setw(10) << stats.count << std::setw(12) << stats.total << std::endl;
+
+        sum.current += stats.current;
+        sum.count += stats.count;
+        sum.total += stats.total;
+    }
+
+    out << std::left << std::setw(12) << "all"
+        << std::right << std::setw(14) << sum.current << std::setw(14) << "-"
+        << std::setw(10) << sum.count << std::setw(12) << sum.total << std::endl;
+}
+
+void MemoryTracker::Report(const std::string& path)
+{
+    WriteReport(std::cout);
+
+    std::ofstream file(path.c_str(), std::ios::out | std::ios::app);
+    if (file.is_open())
+    {
+        file << "--- " << SDL_GetTicks() << " ms ---" << std::endl;
+        WriteReport(file);
+    }
+}
+
+MemoryScope::MemoryScope(MemoryTag tag) :
+    m_previousTag(MemoryTracker::SetCurrentTag(tag))
+{
+}
+
+MemoryScope::~MemoryScope()
+{
+    MemoryTracker::SetCurrentTag(m_previousTag);
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "PCH.hpp"
+
+// Build with JAND_MEMORY_TRACKING defined to turn on tagged accounting of
+// heap allocations and asset memory. Without it the macros below compile
+// away and operator new goes straight to malloc.
+enum MemoryTag
+{
+    MEMORY_UNTAGGED,
+    MEMORY_OBJECTS,
+    MEMORY_CONTAINERS,
+    MEMORY_STRINGS,
+    MEMORY_FRAME,
+    MEMORY_TEXTURES,
+    MEMORY_FONTS,
+    MEMORY_SOUNDS,
+    MEMORY_TAG_COUNT
+};
+
+struct MemoryStats
+{
+    int64_t current;
+    int64_t peak;
+    int64_t count;
+    int64_t total;
+};
+
+class MemoryTracker
+{
+public:
+    static bool IsEnabled();
+
+    // Heap allocations, tagged with the calling thread's current tag
+    static void* Allocate(std::size_t size);
+    static void Free(void* ptr);
+
+    static MemoryTag GetCurrentTag();
+    static MemoryTag SetCurrentTag(MemoryTag tag);
+
+    // Memory owned by libraries (SDL textures, fonts, sound chunks) that we
+    // can only estimate
+    static void TrackExternal(MemoryTag tag, int64_t bytes);
+    static void UntrackExternal(MemoryTag tag, int64_t bytes);
+
+    static MemoryStats GetStats(MemoryTag tag);
+    static const char* GetTagName(MemoryTag tag);
+
+    static void WriteReport(std::ostream& out);
+    static void Report(const std::string& path);
+};
+
+// Tags every allocation made on this thread until it goes out of scope
+class MemoryScope
+{
+public:
+    MemoryScope(MemoryTag tag);
+    ~MemoryScope();
+
+private:
+    MemoryTag m_previousTag;
+};
+
+#define MEMORY_CONCAT_INNER(a, b) a##b
+#define MEMORY_CONCAT(a, b) MEMORY_CONCAT_INNER(a, b)
+
+#if JAND_MEMORY_TRACKING
+    #define MEMORY_SCOPE(tag) MemoryScope MEMORY_CONCAT(memoryScope, __LINE__)(tag)
+    #define MEMORY_TRACK(tag, bytes) MemoryTracker::TrackExternal(tag, bytes)
+    #define MEMORY_UNTRACK(tag, bytes) MemoryTracker::UntrackExternal(tag, bytes)
+#else
+    // Still mention the size, unevaluated, so a local kept only for the
+    // accounting does not turn into an unused variable
+    #define MEMORY_SCOPE(tag)
+    #define MEMORY_TRACK(tag, bytes) ((void)sizeof(bytes))
+    #define MEMORY_UNTRACK(tag, bytes) ((void)sizeof(bytes))
+#endif
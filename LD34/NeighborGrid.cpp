@@ -0,0 +1,215 @@
+#include "PCH.hpp"
+#include "NeighborGrid.hpp"
+#include "FrameArena.hpp"
+#include <cfloat>
+
+const int NeighborGrid::MAX_CELLS_PER_AXIS;
+const int NeighborGrid::MAX_NEIGHBORS;
+const int NeighborGrid::MAX_SCANNED;
+
+// Push directions for points stacked exactly on top of each other
+static const float STACKED_DIRECTIONS[8][2] =
+{
+    { 1.0f, 0.0f }, { 0.7071f, 0.7071f }, { 0.0f, 1.0f }, { -0.7071f, 0.7071f },
+    { -1.0f, 0.0f }, { -0.7071f, -0.7071f }, { 0.0f, -1.0f }, { 0.7071f, -0.7071f }
+};
+
+NeighborGrid::NeighborGrid(float cellSize) :
+    m_cellSize(cellSize),
+    m_originX(0),
+    m_originY(0),
+    m_columns(1),
+    m_rows(1),
+    m_count(0)
+{
+    // Sized for the largest grid, since how far it stretches depends on
+    // where the points wander rather than how many there are
+    m_cellStart.reserve(MAX_CELLS_PER_AXIS * MAX_CELLS_PER_AXIS + 1);
+    m_cellCursor.reserve(MAX_CELLS_PER_AXIS * MAX_CELLS_PER_AXIS);
+}
+
+void NeighborGrid::Reserve(size_t count)
+{
+    m_cellOf.reserve(count);
+    m_sortedIndex.reserve(count);
+    m_sortedX.reserve(count);
+    m_sortedY.reserve(count);
+}
+
+void NeighborGrid::Build(const float* xs, const float* ys, int count)
+{
+    m_count = count;
+
+    // Fit the grid to the current bounds of the points
+    float minX = 0, minY = 0, maxX = 0, maxY = 0;
+    if (m_count > 0)
+    {
+        minX = maxX = xs[0];
+        minY = maxY = ys[0];
+    }
+
+    for (int i = 1; i < m_count; i++)
+    {
+        minX = std::min(minX, xs[i]);
+        maxX = std::max(maxX, xs[i]);
+        minY = std::min(minY, ys[i]);
+        maxY = std::max(maxY, ys[i]);
+    }
+
+    m_originX = minX;
+    m_originY = minY;
+    m_columns = std::min((int)((maxX - minX) / m_cellSize) + 1, MAX_CELLS_PER_AXIS);
+    m_rows = std::min((int)((maxY - minY) / m_cellSize) + 1, MAX_CELLS_PER_AXIS);
+
+    // Counting sort of the points by cell
+    int cellCount = m_columns * m_rows;
+    m_cellStart.assign(cellCount + 1, 0);
+    m_cellOf.resize(m_count);
+
+    for (int i = 0; i < m_count; i++)
+    {
+        int cell = CellIndex(xs[i], ys[i]);
+        m_cellOf[i] = cell;
+        m_cellStart[cell + 1]++;
+    }
+
+    for (int c = 0; c < cellCount; c++)
+    {
+        m_cellStart[c + 1] += m_cellStart[c];
+    }
+
+    m_cellCursor.assign(m_cellStart.begin(), m_cellStart.end() - 1);
+    m_sortedIndex.resize(m_count);
+    m_sortedX.resize(m_count);
+    m_sortedY.resize(m_count);
+
+    for (int i = 0; i < m_count; i++)
+    {
+        int slot = m_cellCursor[m_cellOf[i]]++;
+        m_sortedIndex[slot] = i;
+        m_sortedX[slot] = xs[i];
+        m_sortedY[slot] = ys[i];
+    }
+}
+
+// A cell in range of a point, by the squared distance to its nearest edge
+struct CellVisit
+{
+    float distSq;
+    int cell;
+};
+
+// Squared distance from a point to the nearest edge of a span, zero inside
+static float GapSq(float value, float low, float high)
+{
+    float gap = std::max(std::max(low - value, value - high), 0.0f);
+    return gap * gap;
+}
+
+void NeighborGrid::ComputeSeparation(float radius, float* pushX, float* pushY) const
+{
+    float radiusSq = radius * radius;
+    int reach = (int)std::ceil(radius / m_cellSize);
+
+    FrameArena& arena = FrameArena::ForThisThread();
+    CellVisit* visits = arena.AllocateArray<CellVisit>((2 * reach + 1) * (2 * reach + 1));
+
+    for (int slot = 0; slot < m_count; slot++)
+    {
+        float x = m_sortedX[slot];
+        float y = m_sortedY[slot];
+        int index = m_sortedIndex[slot];
+        int cell = m_cellOf[index];
+        int column = cell % m_columns;
+        int row = cell / m_columns;
+
+        // Cells within range, nearest first. Points past the far edge of the
+        // grid are clamped into the last row and column, so those stretch on.
+        int visitCount = 0;
+        for (int r = std::max(row - reach, 0); r <= std::min(row + reach, m_rows - 1); r++)
+        {
+            float top = m_originY + r * m_cellSize;
+            float bottom = (r == m_rows - 1) ? FLT_MAX : top + m_cellSize;
+            float gapY = GapSq(y, top, bottom);
+            for (int c = std::max(column - reach, 0); c <= std::min(column + reach, m_columns - 1); c++)
+            {
+                float left = m_originX + c * m_cellSize;
+                float right = (c == m_columns - 1) ? FLT_MAX : left + m_cellSize;
+                CellVisit visit = { gapY + GapSq(x, left, right), r * m_columns + c };
+                if (visit.distSq >= radiusSq)
+                {
+                    continue;
+                }
+
+                int i = visitCount++;
+                for (; i > 0 && visits[i - 1].distSq > visit.distSq; i--)
+                {
+                    visits[i] = visits[i - 1];
+                }
+                visits[i] = visit;
+            }
+        }
+
+        // Only points in range count toward the cap, so the nearest cells
+        // always get their say
+        float accumX = 0;
+        float accumY = 0;
+        int found = 0;
+        int scanned = 0;
+        for (int v = 0; v < visitCount && found < MAX_NEIGHBORS && scanned < MAX_SCANNED; v++)
+        {
+            int neighborCell = visits[v].cell;
+            for (int other = m_cellStart[neighborCell]; other < m_cellStart[neighborCell + 1] && found < MAX_NEIGHBORS && scanned < MAX_SCANNED; other++)
+            {
+                if (other == slot)
+                {
+                    continue;
+                }
+                scanned++;
+
+                float dx = x - m_sortedX[other];
+                float dy = y - m_sortedY[other];
+                float distSq = dx * dx + dy * dy;
+                if (distSq >= radiusSq)
+                {
+                    continue;
+                }
+                found++;
+
+                if (distSq < 0.0001f)
+                {
+                    // Stacked exactly on top of each other, so pick a direction
+                    // from the pair's indices. Both sides agree on it and push
+                    // away from each other.
+                    int otherIndex = m_sortedIndex[other];
+                    const float* direction = STACKED_DIRECTIONS[(index ^ otherIndex) & 7];
+                    float sign = (index < otherIndex) ? 1.0f : -1.0f;
+                    accumX += sign * direction[0];
+                    accumY += sign * direction[1];
+                    continue;
+                }
+
+                float dist = std::sqrt(distSq);
+                float strength = (radius - dist) / (radius * dist);
+                accumX += dx * strength;
+                accumY += dy * strength;
+            }
+        }
+
+        pushX[index] = accumX;
+        pushY[index] = accumY;
+    }
+}
+
+int NeighborGrid::GetCount() const
+{
+    return m_count;
+}
+
+int NeighborGrid::CellIndex(float x, float y) const
+{
+    int column = std::min(std::max((int)((x - m_originX) / m_cellSize), 0), m_columns - 1);
+    int row = std::min(std::max((int)((y - m_originY) / m_cellSize), 0), m_rows - 1);
+
+    return row * m_columns + column;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "PCH.hpp"
+
+// Uniform grid over a set of points, rebuilt from scratch every tick with a
+// counting sort. Points are stored sorted by cell so a neighbourhood query
+// only touches the 3x3 block of cells around a point.
+class NeighborGrid
+{
+public:
+    NeighborGrid(float cellSize);
+
+    // Make room for this many points up front, so Build() does not allocate
+    void Reserve(size_t count);
+
+    void Build(const float* xs, const float* ys, int count);
+
+    // Accumulate a separation push for every point from the nearest
+    // neighbours closer than radius. Results are indexed like the input
+    // passed to Build(), and both arrays need room for every point. Scratch
+    // space comes from the frame arena.
+    void ComputeSeparation(float radius, float* pushX, float* pushY) const;
+
+    int GetCount() const;
+
+private:
+    int CellIndex(float x, float y) const;
+
+private:
+    static const int MAX_CELLS_PER_AXIS = 512;
+
+    // Cells are searched nearest first, and a point is pushed by the first
+    // MAX_NEIGHBORS points found in range. The push is clamped to unit
+    // length anyway, so in a crowd that dense more would only add cost.
+    // Out of range points are skipped, but no more than MAX_SCANNED points
+    // are looked at, so a tight crowd cannot turn the pass quadratic.
+    static const int MAX_NEIGHBORS = 24;
+    static const int MAX_SCANNED = 4 * MAX_NEIGHBORS;
+
+    float m_cellSize;
+    float m_originX;
+    float m_originY;
+    int m_columns;
+    int m_rows;
+    int m_count;
+
+    std::vector<int> m_cellStart;
+    std::vector<int> m_cellCursor;
+    std::vector<int> m_cellOf;
+    std::vector<int> m_sortedIndex;
+    std::vector<float> m_sortedX;
+    std::vector<float> m_sortedY;
+};
@@ -0,0 +1,116 @@
+#include "PCH.hpp"
+#include "NetRelay.hpp"
+#include "Logger.hpp"
+#include "GameOptions.hpp"
+
+NetRelay::NetRelay(const GameOptions& options) :
+    m_port((uint16_t)options.relayPort),
+    m_target(options.relayTarget),
+    m_loss(options.packetLoss / 100.0),
+    m_latency(options.latency),
+    m_jitter(options.jitter),
+    m_random(options.seed),
+    m_forwarded(0),
+    m_dropped(0)
+{
+}
+
+int NetRelay::Run()
+{
+    if (!NetAddress::Resolve(m_target, m_host))
+    {
+        LOG_ERROR("Unable to resolve %s!", m_target.c_str());
+        return 1;
+    }
+
+    if (!m_clientSide.Open(m_port) || !m_hostSide.Open(0))
+    {
+        return 1;
+    }
+
+    LOG_INFO("Relaying port %d to %s with %g%% loss, %d ms latency and %d ms jitter",
+        (int)m_port, m_host.ToString().c_str(), m_loss * 100, (int)m_latency, (int)m_jitter);
+
+    uint8_t buffer[MAX_PACKET_SIZE];
+    Uint32 lastTraffic = 0;
+    Uint32 lastReport = SDL_GetTicks();
+    for (;;)
+    {
+        Uint32 now = SDL_GetTicks();
+        NetAddress from;
+        int size;
+
+        while ((size = m_clientSide.Receive(from, buffer, sizeof(buffer))) >= 0)
+        {
+            // Replies from the host go back to whoever spoke last
+            m_client = from;
+            Schedule(buffer, size, true);
+            lastTraffic = now;
+        }
+
+        while ((size = m_hostSide.Receive(from, buffer, sizeof(buffer))) >= 0)
+        {
+            if (from == m_host && m_client.IsValid())
+            {
+                Schedule(buffer, size, false);
+                lastTraffic = now;
+            }
+        }
+
+        while (!m_queue.empty() && m_queue.front().releaseTime <= now)
+        {
+            std::pop_heap(m_queue.begin(), m_queue.end());
+            const DelayedPacket& packet = m_queue.back();
+            if (packet.toHost)
+            {
+                m_hostSide.Send(m_host, packet.data.data(), (int)packet.data.size());
+            }
+            else
+            {
+                m_clientSide.Send(m_client, packet.data.data(), (int)packet.data.size());
+            }
+            m_queue.pop_back();
+        }
+
+        if (now - lastReport >= 5000)
+        {
+            LOG_INFO("Forwarded %llu, dropped %llu", (unsigned long long)m_forwarded, (unsigned long long)m_dropped);
+            lastReport = now;
+        }
+
+        if (lastTraffic != 0 && now - lastTraffic > IDLE_TIMEOUT)
+        {
+            break;
+        }
+
+        SDL_Delay(1);
+    }
+
+    LOG_INFO("Both sides went quiet. Forwarded %llu, dropped %llu", (unsigned long long)m_forwarded, (unsigned long long)m_dropped);
+    return 0;
+}
+
+void NetRelay::Schedule(const uint8_t* data, int size, bool toHost)
+{
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    if (chance(m_random) < m_loss)
+    {
+        m_dropped++;
+        return;
+    }
+
+    int delay = m_latency;
+    if (m_jitter > 0)
+    {
+        delay += std::uniform_int_distribution<int>(-m_jitter, m_jitter)(m_random);
+    }
+
+    DelayedPacket packet;
+    packet.releaseTime = SDL_GetTicks() + std::max(delay, 0);
+    packet.toHost = toHost;
+    packet.data.assign(data, data + size);
+
+    m_queue.push_back(std::move(packet));
+    std::push_heap(m_queue.begin(), m_queue.end());
+    m_forwarded++;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "PCH.hpp"
+#include "UdpSocket.hpp"
+#include <random>
+
+struct GameOptions;
+
+// Stand-in for a bad network between two local players. The joining player
+// connects to the relay instead of the host, and every datagram in either
+// direction is dropped with some probability or held back for a latency
+// plus random jitter before being passed on.
+class NetRelay
+{
+public:
+    NetRelay(const GameOptions& options);
+
+    // Forward until both sides have gone quiet for a while
+    int Run();
+
+private:
+    struct DelayedPacket
+    {
+        Uint32 releaseTime;
+        bool toHost;
+        std::vector<uint8_t> data;
+
+        bool operator<(const DelayedPacket& other) const
+        {
+            // Earliest release on top of the heap
+            return releaseTime > other.releaseTime;
+        }
+    };
+
+    void Schedule(const uint8_t* data, int size, bool toHost);
+
+private:
+    static const int MAX_PACKET_SIZE = 1500;
+    static const int IDLE_TIMEOUT = 10000;
+
+    uint16_t m_port;
+    std::string m_target;
+    double m_loss;
+    int m_latency;
+    int m_jitter;
+
+    UdpSocket m_clientSide;
+    UdpSocket m_hostSide;
+    NetAddress m_host;
+    NetAddress m_client;
+
+    std::vector<DelayedPacket> m_queue;
+    std::mt19937 m_random;
+
+    uint64_t m_forwarded;
+    uint64_t m_dropped;
+};
@@ -1,11 +1,14 @@
 #pragma once
 
 #include <iostream>
+#include <algorithm>
+#include <cmath>
 #include <memory>
 #include <map>
 #include <vector>
 #include <string>
 #include <sstream>
+#include <cstdint>
 #include <cstdlib>
 #include <ctime>
 
@@ -15,9 +18,14 @@
     #include <SDL_image.h>
     #include <SDL_ttf.h>
     #include <SDL_mixer.h>
-#else
+#elif __APPLE__
     #include <SDL2/SDL.h>
     #include <SDL2_image/SDL_image.h>
     #include <SDL2_ttf/SDL_ttf.h>
     #include <SDL2_mixer/SDL_mixer.h>
+#else
+    #include <SDL2/SDL.h>
+    #include <SDL2/SDL_image.h>
+    #include <SDL2/SDL_ttf.h>
+    #include <SDL2/SDL_mixer.h>
 #endif
@@ -0,0 +1,142 @@
+#include "PCH.hpp"
+#include "ParticlePool.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <xmmintrin.h>
+    #define PARTICLE_POOL_SSE 1
+#endif
+
+ParticlePool::ParticlePool() :
+    m_count(0),
+    m_capacity(0)
+{
+}
+
+void ParticlePool::Init(int capacity)
+{
+    // Padded to a whole number of SIMD groups, so the update never has to
+    // finish off the last few particles one at a time
+    m_capacity = capacity;
+    size_t padded = (size_t)(capacity + 3) & ~(size_t)3;
+    m_x.assign(padded, 0.0f);
+    m_y.assign(padded, 0.0f);
+    m_vx.assign(padded, 0.0f);
+    m_vy.assign(padded, 0.0f);
+    m_gravity.assign(padded, 0.0f);
+    m_life.assign(padded, 0.0f);
+    m_inverseLifetime.assign(padded, 0.0f);
+    m_size.assign(padded, 0.0f);
+    m_color.assign(padded, SDL_Color());
+    m_count = 0;
+}
+
+bool ParticlePool::Add(float x, float y, float vx, float vy, float gravity, float life, float size, SDL_Color color)
+{
+    if (m_count >= m_capacity || life <= 0.0f)
+    {
+        return false;
+    }
+
+    int i = m_count++;
+    m_x[i] = x;
+    m_y[i] = y;
+    m_vx[i] = vx;
+    m_vy[i] = vy;
+    m_gravity[i] = gravity;
+    m_life[i] = life;
+    m_inverseLifetime[i] = 1.0f / life;
+    m_size[i] = size;
+    m_color[i] = color;
+    return true;
+}
+
+void ParticlePool::Update(float deltaTime)
+{
+    float* x = m_x.data();
+    float* y = m_y.data();
+    float* vx = m_vx.data();
+    float* vy = m_vy.data();
+    float* life = m_life.data();
+    const float* gravity = m_gravity.data();
+
+    int i = 0;
+
+#if PARTICLE_POOL_SSE
+    const __m128 dt = _mm_set1_ps(deltaTime);
+    for (; i < m_count; i += 4)
+    {
+        __m128 velocityY = _mm_add_ps(_mm_loadu_ps(vy + i), _mm_mul_ps(_mm_loadu_ps(gravity + i), dt));
+        _mm_storeu_ps(vy + i, velocityY);
+        _mm_storeu_ps(x + i, _mm_add_ps(_mm_loadu_ps(x + i), _mm_mul_ps(_mm_loadu_ps(vx + i), dt)));
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(velocityY, dt)));
+        _mm_storeu_ps(life + i, _mm_sub_ps(_mm_loadu_ps(life + i), dt));
+    }
+#endif
+
+    for (; i < m_count; i++)
+    {
+        vy[i] += gravity[i] * deltaTime;
+        x[i] += vx[i] * deltaTime;
+        y[i] += vy[i] * deltaTime;
+        life[i] -= deltaTime;
+    }
+
+    // Walk backwards, so the particle moved into a hole has already been
+    // checked
+    for (int j = m_count - 1; j >= 0; j--)
+    {
+        if (life[j] <= 0.0f)
+        {
+            Remove(j);
+        }
+    }
+}
+
+void ParticlePool::Remove(int index)
+{
+    int last = --m_count;
+    m_x[index] = m_x[last];
+    m_y[index] = m_y[last];
+    m_vx[index] = m_vx[last];
+    m_vy[index] = m_vy[last];
+    m_gravity[index] = m_gravity[last];
+    m_life[index] = m_life[last];
+    m_inverseLifetime[index] = m_inverseLifetime[last];
+    m_size[index] = m_size[last];
+    m_color[index] = m_color[last];
+}
+
+int ParticlePool::GetCount() const
+{
+    return m_count;
+}
+
+int ParticlePool::GetCapacity() const
+{
+    return m_capacity;
+}
+
+const float* ParticlePool::GetX() const
+{
+    return m_x.data();
+}
+
+const float* ParticlePool::GetY() const
+{
+    return m_y.data();
+}
+
+const float* ParticlePool::GetSize() const
+{
+    return m_size.data();
+}
+
+const SDL_Color* ParticlePool::GetColor() const
+{
+    return m_color.data();
+}
+
+float ParticlePool::GetFade(int index) const
+{
+    return std::min(std::max(m_life[index] * m_inverseLifetime[index], 0.0f), 1.0f);
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "PCH.hpp"
+
+// Fixed number of particles kept as a structure of arrays, so the update is
+// a straight SIMD pass over each field. Nothing is allocated after Init().
+// Dead particles are replaced by the last live one, so the live ones always
+// fill the front of the arrays, in no particular order.
+class ParticlePool
+{
+public:
+    ParticlePool();
+
+    void Init(int capacity);
+
+    // Returns false, dropping the particle, when the pool is full
+    bool Add(float x, float y, float vx, float vy, float gravity, float life, float size, SDL_Color color);
+
+    // Move every particle and retire the ones whose life ran out
+    void Update(float deltaTime);
+
+    int GetCount() const;
+    int GetCapacity() const;
+
+    const float* GetX() const;
+    const float* GetY() const;
+    const float* GetSize() const;
+    const SDL_Color* GetColor() const;
+
+    // How much of a particle's life is left, from 1 down to 0
+    float GetFade(int index) const;
+
+private:
+    void Remove(int index);
+
+private:
+    int m_count;
+    int m_capacity;
+
+    std::vector<float> m_x;
+    std::vector<float> m_y;
+    std::vector<float> m_vx;
+    std::vector<float> m_vy;
+    std::vector<float> m_gravity;
+    std::vector<float> m_life;
+    std::vector<float> m_inverseLifetime;
+    std::vector<float> m_size;
+    std::vector<SDL_Color> m_color;
+};
@@ -0,0 +1,138 @@
+#include "PCH.hpp"
+#include "ParticleSystem.hpp"
+
+struct ParticleEffectInfo
+{
+    ParticleLayer layer;
+
+    // Particles leave around this angle (degrees, 0 is right and -90 is
+    // up), spread this far to either side, from anywhere within radius
+    // of the emitter horizontally
+    float angle;
+    float spread;
+    float radius;
+
+    float minSpeed;
+    float maxSpeed;
+    float gravity;
+    float minLife;
+    float maxLife;
+    float minSize;
+    float maxSize;
+
+    SDL_Color color;
+    int colorJitter;
+};
+
+static const ParticleEffectInfo EFFECTS[PARTICLE_EFFECT_COUNT] =
+{
+    // Flames rise faster the higher they get, as if pulled up by the heat
+    { PARTICLE_LAYER_FLAMES, -90.0f, 20.0f, 8.0f, 8.0f, 24.0f, -40.0f, 0.5f, 1.1f, 6.0f, 11.0f, { 255, 240, 220, 255 }, 15 },
+    // Wood chips and stone sparks are thrown up and fall back down
+    { PARTICLE_LAYER_DEBRIS, -90.0f, 60.0f, 4.0f, 40.0f, 90.0f, 320.0f, 0.35f, 0.6f, 2.0f, 3.0f, { 122, 84, 44, 255 }, 20 },
+    { PARTICLE_LAYER_DEBRIS, -90.0f, 80.0f, 4.0f, 60.0f, 140.0f, 220.0f, 0.2f, 0.4f, 1.0f, 2.0f, { 255, 226, 150, 255 }, 25 }
+};
+
+static const float DEGREES_TO_RADIANS = 3.14159265f / 180.0f;
+
+static Uint8 Jitter(Uint8 channel, float amount)
+{
+    return (Uint8)std::min(std::max(channel + (int)amount, 0), 255);
+}
+
+ParticleSystem::ParticleSystem() :
+    m_enabled(false),
+    m_random(2463534242u),
+    m_updateTime(0)
+{
+}
+
+void ParticleSystem::Init(int capacityPerLayer)
+{
+    for (int i = 0; i < PARTICLE_LAYER_COUNT; i++)
+    {
+        m_layers[i].Init(capacityPerLayer);
+    }
+
+    m_enabled = true;
+}
+
+bool ParticleSystem::IsEnabled() const
+{
+    return m_enabled;
+}
+
+void ParticleSystem::Emit(ParticleEffect effect, float x, float y, int count, float scale)
+{
+    if (!m_enabled)
+    {
+        return;
+    }
+
+    const ParticleEffectInfo& info = EFFECTS[effect];
+    ParticlePool& pool = m_layers[info.layer];
+    for (int i = 0; i < count; i++)
+    {
+        float angle = (info.angle + Random(-info.spread, info.spread)) * DEGREES_TO_RADIANS;
+        float speed = Random(info.minSpeed, info.maxSpeed) * scale;
+        float jitter = Random(-1.0f, 1.0f) * info.colorJitter;
+
+        SDL_Color color = info.color;
+        color.r = Jitter(color.r, jitter);
+        color.g = Jitter(color.g, jitter);
+        color.b = Jitter(color.b, jitter);
+
+        bool added = pool.Add(x + Random(-info.radius, info.radius) * scale, y,
+            std::cos(angle) * speed, std::sin(angle) * speed, info.gravity,
+            Random(info.minLife, info.maxLife), Random(info.minSize, info.maxSize) * scale, color);
+        if (!added)
+        {
+            break;
+        }
+    }
+}
+
+void ParticleSystem::Update(float deltaTime)
+{
+    if (!m_enabled)
+    {
+        return;
+    }
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < PARTICLE_LAYER_COUNT; i++)
+    {
+        m_layers[i].Update(deltaTime);
+    }
+    m_updateTime = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+const ParticlePool& ParticleSystem::GetLayer(ParticleLayer layer) const
+{
+    return m_layers[layer];
+}
+
+int ParticleSystem::GetCount() const
+{
+    int count = 0;
+    for (int i = 0; i < PARTICLE_LAYER_COUNT; i++)
+    {
+        count += m_layers[i].GetCount();
+    }
+
+    return count;
+}
+
+double ParticleSystem::GetUpdateTime() const
+{
+    return m_updateTime;
+}
+
+float ParticleSystem::Random(float min, float max)
+{
+    // xorshift32
+    m_random ^= m_random << 13;
+    m_random ^= m_random >> 17;
+    m_random ^= m_random << 5;
+    return min + (max - min) * (m_random >> 8) * (1.0f / 16777216.0f);
+}
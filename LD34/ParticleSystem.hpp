@@ -0,0 +1,49 @@
+#pragma once
+#include "PCH.hpp"
+#include "ParticlePool.hpp"
+
+// Each layer is one pool, drawn in one batch
+enum ParticleLayer
+{
+    PARTICLE_LAYER_FLAMES,  // Sprites from fire.png
+    PARTICLE_LAYER_DEBRIS,  // Solid squares
+    PARTICLE_LAYER_COUNT
+};
+
+enum ParticleEffect
+{
+    PARTICLE_FLAME,
+    PARTICLE_WOOD_CHIPS,
+    PARTICLE_STONE_SPARKS,
+    PARTICLE_EFFECT_COUNT
+};
+
+// Cosmetic particles. They roll their own dice rather than calling rand(),
+// and nothing in the simulation reads them back, so they never affect a
+// lockstep game. Until Init() is called, emitting does nothing, which keeps
+// runs that do not render free of them.
+class ParticleSystem
+{
+public:
+    ParticleSystem();
+
+    void Init(int capacityPerLayer);
+    bool IsEnabled() const;
+
+    // Scale makes the particles bigger and throws them further
+    void Emit(ParticleEffect effect, float x, float y, int count, float scale = 1.0f);
+    void Update(float deltaTime);
+
+    const ParticlePool& GetLayer(ParticleLayer layer) const;
+    int GetCount() const;
+    double GetUpdateTime() const;
+
+private:
+    float Random(float min, float max);
+
+private:
+    bool m_enabled;
+    uint32_t m_random;
+    ParticlePool m_layers[PARTICLE_LAYER_COUNT];
+    double m_updateTime;
+};
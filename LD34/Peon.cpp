@@ -1,13 +1,14 @@
 #include "PCH.hpp"
 #include "Peon.hpp"
 #include "Game.hpp"
+#include "RenderSnapshot.hpp"
 
 Peon::Peon(Game* game, const Vector2D& position, const int& width, const int& height, const std::string& textureID) :
     m_state(IDLE),
     dest(0, 0),
-    m_bonfire(nullptr),
-    m_targetResource(nullptr),
-    m_resources(0)
+    m_lastResource(RESOURCE_TYPE_COUNT),
+    m_resources(0),
+    m_behavior(nullptr)
 {
     m_position = position;
     m_width = width;
@@ -17,11 +18,18 @@ Peon::Peon(Game* game, const Vector2D& position, const int& width, const int& he
     m_game = game;
     m_ID = "peon";
 
-    m_bonfire = m_game->FindBonfire(this);
+    m_gatherTimer.SetClock(m_game->GetClock());
+    m_idleTimer.SetClock(m_game->GetClock());
 
-    speedVariation = rand() % 20 - 10;
+    Bonfire* bonfire = m_game->FindBonfire(this);
+    if (bonfire != nullptr)
+    {
+        m_bonfire = bonfire->GetHandle();
+    }
 
-    int randTex = rand() % 80;
+    speedVariation = m_game->Random() % 20 - 10;
+
+    int randTex = m_game->Random() % 80;
     if (randTex <= 20)
     {
         m_textureID = "man";
@@ -39,56 +47,101 @@ Peon::Peon(Game* game, const Vector2D& position, const int& width, const int& he
         m_textureID = "man4";
     }
 
-    // Set up state machine
-    m_stateHandler[IDLE] = &Peon::IdleState;
-    m_stateHandler[WALKING] = &Peon::WalkingState;
-    m_stateHandler[GATHERING] = &Peon::GatheringState;
-    m_stateHandler[SACRIFICE] = &Peon::SacrificeState;
+    m_behaviors[IDLE] = &Peon::IdleBehavior;
+    m_behaviors[WALKING] = &Peon::WalkingBehavior;
+    m_behaviors[GATHERING] = &Peon::GatheringBehavior;
+    m_behaviors[SACRIFICE] = &Peon::SacrificeBehavior;
+}
+
+Peon::~Peon()
+{
+    EndBehavior();
 }
 
 void Peon::Respawn()
 {
     m_resources = 0;
-    m_targetResource = nullptr;
-    m_position = Vector2D(rand() % 600, -50);
+    m_targetResource = Handle();
+    m_isReturning = false;
+    m_position = Vector2D(m_game->Random() % 600, -50);
     dest = Vector2D(256, 200);
     m_state = WALKING;
 }
 
+void Peon::ReturnToDepot()
+{
+    Bonfire* bonfire = m_game->FindBonfire(this);
+    if (bonfire == nullptr)
+    {
+        return;
+    }
+
+    m_bonfire = bonfire->GetHandle();
+    dest = bonfire->GetPosition();
+    m_isReturning = true;
+    m_state = WALKING;
+}
+
 void Peon::Update()
 {
     GameObject::Update();
 
-    stateFunction stateFunc = m_stateHandler[m_state];
-    if (stateFunc != nullptr)
+    // Something else put us in another state while we were waiting, so
+    // whatever we were doing is dropped
+    if (m_behavior != nullptr && m_behavior->state != m_state)
     {
-       (this->*stateFunc)();
+        EndBehavior();
+    }
+
+    if (m_behavior == nullptr)
+    {
+        m_behavior = m_game->GetBehaviorPool().Acquire();
+        m_behavior->state = m_state;
+    }
+
+    // The steps of a walk are taken here, and the behavior only carries on
+    // once it is over
+    if (m_behavior->awaitingArrival)
+    {
+        if (!StepTowardDestination())
+        {
+            return;
+        }
+        m_behavior->awaitingArrival = false;
+    }
+
+    if ((this->*m_behaviors[m_behavior->state])(m_behavior) == COROUTINE_DONE)
+    {
+        EndBehavior();
     }
 }
 
-void Peon::Render()
+void Peon::EndBehavior()
 {
+    if (m_behavior != nullptr)
+    {
+        m_game->GetBehaviorPool().Release(m_behavior);
+        m_behavior = nullptr;
+    }
+}
+
+void Peon::Render(RenderSnapshot& snapshot)
+{
+    // Only called for peons in view, once a tick, so nobody pays for
+    // hopping off screen
     if (m_state == WALKING || m_state == SACRIFICE)
     {
         hopIndex += m_game->m_deltaTime;
         hopOffset = -(hopAmp * sin(hopFreq * hopIndex));
     }
 
-    m_game->RenderTexture(m_textureID, m_position.GetX(), m_position.GetY() + hopOffset, m_width, m_height);
+    snapshot.AddSprite(m_textureID, m_position.GetX(), m_position.GetY() + hopOffset, m_width, m_height);
 
-    if (m_resources >= 5)
+    // Built once, so drawing the load does not make a string every frame
+    static const std::string carriedTextures[RESOURCE_TYPE_COUNT] = { "log", "rock" };
+    if (m_resources >= 5 && m_lastResource != RESOURCE_TYPE_COUNT)
     {
-        std::string texID;
-        if (m_lastResource == "tree")
-        {
-            texID = "log";
-        }
-        else if (m_lastResource == "stone")
-        {
-            texID = "rock";
-        }
-
-        m_game->RenderTexture(texID, m_position.GetX() + 8, m_position.GetY() + 10, 16, 16);
+        snapshot.AddSprite(carriedTextures[m_lastResource], m_position.GetX() + 8, m_position.GetY() + 10, 16, 16);
     }
 }
 
@@ -114,7 +167,7 @@ void Peon::MoveTo(Vector2D dest)
         }
         speed += speedVariation;
 
-        m_position += direction * (speed * m_game->m_deltaTime);
+        m_position += direction * (speed * m_step);
         if (Vector2D::Distance(start, m_position) > distance)
         {
             m_position = dest;
@@ -122,124 +175,231 @@ void Peon::MoveTo(Vector2D dest)
     }
 }
 
-void Peon::IdleState()
+void Peon::Separate(Vector2D offset)
+{
+    // Only peons that have settled get pushed around. Walking peons need to
+    // land exactly on their destination to finish the walk.
+    if (m_state == IDLE || m_state == GATHERING)
+    {
+        m_position += offset;
+
+        // A parked peon is not updated, so keep its hit box in step here
+        if (m_wakeTicket != 0)
+        {
+            UpdateHitBox();
+        }
+    }
+}
+
+bool Peon::StepTowardDestination()
+{
+    if (m_game->GetGameObject(m_targetResource) != nullptr)
+    {
+        m_isWandering = false;
+    }
+
+    if (m_isReturning)
+    {
+        FollowFlowField();
+    }
+    else
+    {
+        MoveTo(dest);
+    }
+    return m_position == dest;
+}
+
+void Peon::FollowFlowField()
+{
+    FlowField::Route route = m_game->GetFlowField().Lookup(m_position);
+    GameObject* bonfire = m_game->GetGameObject(route.depot);
+    if (bonfire == nullptr)
+    {
+        MoveTo(dest);
+        return;
+    }
+
+    m_bonfire = route.depot;
+    dest = bonfire->GetPosition();
+    MoveTo(route.arrived ? dest : route.waypoint);
+}
+
+CoroutineStatus Peon::IdleBehavior(PeonBehavior* frame)
 {
+    CO_BEGIN(frame);
+
     if (!m_idleTimer.IsStarted())
     {
-        waitTime = rand() % 10000 + 1000;
+        waitTime = m_game->Random() % 10000 + 1000;
         m_idleTimer.Start();
     }
 
+    // Nothing to do until the wait is over, or we are given a resource
+    while (m_idleTimer.GetTime() <= waitTime && m_game->GetGameObject(m_targetResource) == nullptr)
+    {
+        SleepUntil(m_idleTimer, waitTime);
+        CO_SUSPEND(frame);
+    }
+
     if (m_idleTimer.GetTime() > waitTime)
     {
         m_idleTimer.Stop();
         m_state = WALKING;
 
-        double randX = rand() % 64 - 32;
-        double randY = rand() % 64 - 32;
+        double randX = m_game->Random() % 64 - 32;
+        double randY = m_game->Random() % 64 - 32;
         dest = m_position + Vector2D(randX, randY);
         m_isWandering = true;
     }
 
-    if (m_targetResource != nullptr)
+    GameObject* target = m_game->GetGameObject(m_targetResource);
+    if (target != nullptr)
     {
-        dest = m_targetResource->GetPosition();
+        dest = target->GetPosition();
         m_state = WALKING;
     }
+
+    CO_END(frame);
 }
 
-void Peon::WalkingState()
+CoroutineStatus Peon::WalkingBehavior(PeonBehavior* frame)
 {
+    CO_BEGIN(frame);
+
     // If we are gathering, interrupt it
     if (m_gatherTimer.IsStarted())
     {
         m_gatherTimer.Stop();
     }
 
-    if (m_targetResource != nullptr)
+    if (!StepTowardDestination())
     {
-        m_isWandering = false;
+        frame->awaitingArrival = true;
+        CO_SUSPEND(frame);
     }
 
-    // Walk to our destination.
-    MoveTo(dest);
-
-    // If we have reached our destination, begin the next action
-    if (m_position == dest)
+    // We have reached our destination, so begin the next action
     {
         m_state = IDLE;
+        m_isReturning = false;
 
-        if (m_targetResource != nullptr)
+        GameObject* target = m_game->GetGameObject(m_targetResource);
+        if (target != nullptr && Vector2D::Distance(target->GetPosition(), m_position) < 10)
         {
-            if (Vector2D::Distance(m_targetResource->GetPosition(), m_position) < 10)
-            {
-                m_state = GATHERING;
-            }
+            m_state = GATHERING;
         }
 
-        if (m_bonfire != nullptr)
+        GameObject* bonfire = m_game->GetGameObject(m_bonfire);
+        if (bonfire != nullptr && Vector2D::Distance(bonfire->GetPosition(), m_position) < 10 && m_resources > 0)
         {
-            if (Vector2D::Distance(m_bonfire->GetPosition(), m_position) < 10)
-            {
-                if (m_resources > 0)
-                {
-                    m_game->DepositResources(m_resources);
-                    m_resources = 0;
-                    m_game->PlaySound("drop");
-                    m_state = IDLE;
-                }
-            }
+            m_game->DepositResources(m_resources);
+            m_resources = 0;
+            m_game->PlaySound("drop", MIX_MAX_VOLUME, m_game->PanForPosition(m_position.GetX()));
+            m_state = IDLE;
         }
     }
+
+    CO_END(frame);
 }
 
-void Peon::GatheringState()
+CoroutineStatus Peon::GatheringBehavior(PeonBehavior* frame)
 {
-    if (!m_gatherTimer.IsStarted())
-    {
-        m_gatherTimer.Start();
-        soundDelay = rand() % 1000 + 700;
-    }
+    CO_BEGIN(frame);
 
-    if (m_gatherTimer.GetTime() > soundDelay)
+    for (;;)
     {
-        m_gatherTimer.Stop();
-        if (m_targetResource->m_ID == "tree")
+        if (m_game->GetGameObject(m_targetResource) == nullptr)
         {
-            m_lastResource = "tree";
-            m_game->PlaySound("chop");
-            m_resources += 1;
+            m_gatherTimer.Stop();
+            m_state = IDLE;
+            CO_RETURN(frame);
         }
-        else if (m_targetResource->m_ID == "stone")
+
+        if (!m_gatherTimer.IsStarted())
         {
-            m_lastResource = "stone";
-            m_game->PlaySound("mine");
-            m_resources += 2;
+            m_gatherTimer.Start();
+            soundDelay = m_game->Random() % 1000 + 700;
         }
-    }
 
-    if (m_resources >= 5)
-    {
-        if (m_bonfire != nullptr)
+        if (m_gatherTimer.GetTime() > soundDelay)
+        {
+            m_gatherTimer.Stop();
+            Harvest(m_game->GetGameObject(m_targetResource));
+        }
+
+        // Take a full load back to the nearest bonfire
+        if (m_resources >= 5 && m_game->FindBonfire(this) != nullptr)
         {
-            dest = m_bonfire->GetPosition();
-            m_state = WALKING;
+            ReturnToDepot();
+            CO_RETURN(frame);
         }
+
+        // Wait for the next swing, or start it next tick after a harvest
+        if (m_gatherTimer.IsStarted())
+        {
+            SleepUntil(m_gatherTimer, soundDelay);
+        }
+        CO_SUSPEND(frame);
     }
+
+    CO_END(frame);
 }
 
-void Peon::SacrificeState()
+void Peon::Harvest(GameObject* target)
 {
-    m_targetResource = nullptr;
-    if (m_bonfire != nullptr)
+    Resource* resource = dynamic_cast<Resource*>(target);
+    if (resource == nullptr)
     {
-        dest = m_bonfire->GetPosition();
+        return;
+    }
 
-        MoveTo(dest);
+    int harvested = resource->Harvest();
+    float hitX = (float)(resource->GetPosition().GetX() + resource->GetWidth() / 2);
+    float hitY = (float)(resource->GetPosition().GetY() + resource->GetHeight() / 2);
+    if (resource->GetType() == RESOURCE_TREE)
+    {
+        m_lastResource = RESOURCE_TREE;
+        m_game->PlaySound("chop", MIX_MAX_VOLUME, m_game->PanForPosition(m_position.GetX()));
+        m_game->GetParticles().Emit(PARTICLE_WOOD_CHIPS, hitX, hitY, 8);
+    }
+    else if (resource->GetType() == RESOURCE_STONE)
+    {
+        m_lastResource = RESOURCE_STONE;
+        m_game->PlaySound("mine", MIX_MAX_VOLUME, m_game->PanForPosition(m_position.GetX()));
+        m_game->GetParticles().Emit(PARTICLE_STONE_SPARKS, hitX, hitY, 10);
+    }
 
-        if (Vector2D::Distance(m_bonfire->GetPosition(), m_position) < 10)
-        {
-            m_game->SacrificePeon(this);
-        }
+    m_resources += harvested;
+}
+
+void Peon::SleepUntil(Timer& timer, int duration)
+{
+    // The timer keeps counting against the sim clock while we are parked,
+    // so picking up again after the wake reads the same as having polled
+    double now = *m_game->GetClock();
+    m_game->Park(this, now + (duration - timer.GetTime()));
+}
+
+CoroutineStatus Peon::SacrificeBehavior(PeonBehavior* frame)
+{
+    CO_BEGIN(frame);
+
+    CO_AWAIT(frame, RunForBonfire());
+    m_game->SacrificePeon(this);
+
+    CO_END(frame);
+}
+
+bool Peon::RunForBonfire()
+{
+    m_targetResource = Handle();
+    GameObject* bonfire = m_game->GetGameObject(m_bonfire);
+    if (bonfire == nullptr)
+    {
+        return false;
     }
+
+    dest = bonfire->GetPosition();
+    MoveTo(dest);
+    return Vector2D::Distance(bonfire->GetPosition(), m_position) < 10;
 }
@@ -4,28 +4,45 @@
 #include "Timer.hpp"
 #include "Tree.hpp"
 #include "Bonfire.hpp"
+#include "Coroutine.hpp"
 
+struct PeonBehavior;
+
+// What a peon does in each state is a coroutine, started when it enters the
+// state and resumed by Update() only once whatever it waits for has come
+// about: the end of a timer, through parking, or the end of a walk.
 class Peon : public GameObject
 {
 public:
     Peon(Game* game, const Vector2D& position, const int& width, const int& height, const std::string& textureID);
+    ~Peon();
 
     void Update();
-    void Render();
+    void Render(RenderSnapshot& snapshot);
     void Clean();
 
     void MoveTo(Vector2D dest);
+    void Separate(Vector2D offset);
     void Respawn();
 
-    void IdleState();
-    void WalkingState();
-    void GatheringState();
-    void SacrificeState();
+    // Head for the nearest bonfire with what we carry
+    void ReturnToDepot();
+
+    CoroutineStatus IdleBehavior(PeonBehavior* frame);
+    CoroutineStatus WalkingBehavior(PeonBehavior* frame);
+    CoroutineStatus GatheringBehavior(PeonBehavior* frame);
+    CoroutineStatus SacrificeBehavior(PeonBehavior* frame);
+
+    // Park until the timer passes duration
+    void SleepUntil(Timer& timer, int duration);
 
 public:
     Vector2D dest;
 
     bool m_isWandering = false;
+
+    // On the way to drop a load off, following the flow field
+    bool m_isReturning = false;
     double walkSpeed = 32;
     double runSpeed = 64;
     double speedVariation = 0;
@@ -33,9 +50,9 @@ public:
     enum State { IDLE, WALKING, GATHERING, SACRIFICE };
     State m_state;
 
-    Bonfire* m_bonfire;
-    GameObject* m_targetResource;
-    std::string m_lastResource;
+    Handle m_bonfire;
+    Handle m_targetResource;
+    ResourceType m_lastResource;
 
     int soundDelay;
     Timer m_gatherTimer;
@@ -43,12 +60,42 @@ public:
     Timer m_idleTimer;
     int m_resources;
 
-    double hopOffset;
-    double hopIndex;
+    double hopOffset = 0;
+    double hopIndex = 0;
     double hopAmp = 3;
-    double hopFreq;
+    double hopFreq = 0;
+
+private:
+    // One step of a walk, true once we have arrived
+    bool StepTowardDestination();
+
+    // Steers toward the next cell on the way to the nearest bonfire, which
+    // may change on the way as bonfires come and go
+    void FollowFlowField();
+
+    // One step toward the bonfire, true once close enough to jump in
+    bool RunForBonfire();
+    void Harvest(GameObject* target);
+    void EndBehavior();
 
 private:
-    typedef void (Peon::*stateFunction)();
-    stateFunction m_stateHandler[5];
+    typedef CoroutineStatus (Peon::*Behavior)(PeonBehavior* frame);
+    Behavior m_behaviors[4];
+    PeonBehavior* m_behavior;
+};
+
+// The frame of a running behavior, from the game's pool
+struct PeonBehavior : public CoroutineFrame
+{
+    PeonBehavior() :
+        state(Peon::IDLE),
+        awaitingArrival(false)
+    {
+    }
+
+    // Started for this state, and dropped if something else changes it
+    Peon::State state;
+
+    // Walking along until dest is reached
+    bool awaitingArrival;
 };
\ No newline at end of file
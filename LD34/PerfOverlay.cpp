@@ -0,0 +1,150 @@
+#include "PCH.hpp"
+#include "PerfOverlay.hpp"
+#include "Game.hpp"
+
+PerfOverlay::PerfOverlay(Game* game) :
+    m_game(game),
+    m_isVisible(false),
+    m_world(),
+    m_historyIndex(0),
+    m_overlayTime(0),
+    m_lastRefresh(0)
+{
+    for (int i = 0; i < HISTORY_SIZE; i++)
+    {
+        m_history[i] = FrameStats();
+    }
+
+    // Room for the longest line up front, so refreshing never allocates
+    for (int i = 0; i < LINE_COUNT; i++)
+    {
+        m_lines[i].reserve(LINE_LENGTH);
+    }
+}
+
+void PerfOverlay::Toggle()
+{
+    m_isVisible = !m_isVisible;
+    m_lastRefresh = 0;
+}
+
+bool PerfOverlay::IsVisible() const
+{
+    return m_isVisible;
+}
+
+void PerfOverlay::AddFrame(const FrameStats& stats)
+{
+    m_history[m_historyIndex] = stats;
+    m_historyIndex = (m_historyIndex + 1) % HISTORY_SIZE;
+}
+
+void PerfOverlay::SetWorldStats(const WorldStats& stats)
+{
+    m_world = stats;
+}
+
+void PerfOverlay::Render(SDL_Renderer* renderer)
+{
+    if (!m_isVisible)
+    {
+        return;
+    }
+
+    Uint64 startTime = SDL_GetPerformanceCounter();
+
+    if (m_lastRefresh == 0 || SDL_GetTicks() - m_lastRefresh > REFRESH_TIME)
+    {
+        RefreshText();
+        m_lastRefresh = SDL_GetTicks();
+    }
+
+    const int x = X;
+    const int graphHeight = GRAPH_HEIGHT;
+    const int graphTop = Y + LINE_COUNT * LINE_HEIGHT + 4;
+
+    SDL_Rect background = { X, Y, HISTORY_SIZE + 8, LINE_COUNT * LINE_HEIGHT + GRAPH_HEIGHT + 12 };
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderFillRect(renderer, &background);
+
+    // Straight to the window, even when the game renders in software
+    SDL_Color white = { 255, 255, 255, 255 };
+    SDL_Texture* glyphs = m_game->GetGlyphTexture();
+    for (int i = 0; i < LINE_COUNT && glyphs != nullptr; i++)
+    {
+        m_game->GetGlyphAtlas().RenderText(renderer, glyphs, X + 4, Y + 2 + i * LINE_HEIGHT, m_lines[i], white);
+    }
+
+    // Frame time graph, oldest sample on the left
+    int graphBottom = graphTop + graphHeight;
+    for (int i = 0; i < HISTORY_SIZE; i++)
+    {
+        const FrameStats& stats = m_history[(m_historyIndex + i) % HISTORY_SIZE];
+        int height = std::min((int)(stats.frameTime * GRAPH_SCALE), graphHeight);
+
+        m_bars[i].x = x + 4 + i;
+        m_bars[i].y = graphBottom - height;
+        m_bars[i].w = 1;
+        m_bars[i].h = height;
+    }
+
+    SDL_SetRenderDrawColor(renderer, 133, 222, 80, 255);
+    SDL_RenderFillRects(renderer, m_bars, HISTORY_SIZE);
+
+    // 60 and 30 fps budget lines
+    SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
+    int budget60 = graphBottom - (int)(16.67 * GRAPH_SCALE);
+    SDL_RenderDrawLine(renderer, x + 4, budget60, x + 4 + HISTORY_SIZE, budget60);
+    SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
+    int budget30 = graphBottom - (int)(33.33 * GRAPH_SCALE);
+    SDL_RenderDrawLine(renderer, x + 4, budget30, x + 4 + HISTORY_SIZE, budget30);
+
+    m_overlayTime = (double)(SDL_GetPerformanceCounter() - startTime) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+void PerfOverlay::RefreshText()
+{
+    // Average over the whole history so the numbers are readable
+    FrameStats average = FrameStats();
+    double worstFrame = 0;
+    for (int i = 0; i < HISTORY_SIZE; i++)
+    {
+        average.frameTime += m_history[i].frameTime;
+        average.simTime += m_history[i].simTime;
+        average.renderTime += m_history[i].renderTime;
+        worstFrame = std::max(worstFrame, m_history[i].frameTime);
+    }
+    average.frameTime /= HISTORY_SIZE;
+    average.simTime /= HISTORY_SIZE;
+    average.renderTime /= HISTORY_SIZE;
+
+    const FrameStats& last = m_history[(m_historyIndex + HISTORY_SIZE - 1) % HISTORY_SIZE];
+
+    char buffer[LINE_LENGTH];
+    snprintf(buffer, sizeof(buffer), "frame %.2f ms max %.1f", average.frameTime, worstFrame);
+    m_lines[0] = buffer;
+    snprintf(buffer, sizeof(buffer), "tick %.2f render %.2f ms", average.simTime, average.renderTime);
+    m_lines[1] = buffer;
+    snprintf(buffer, sizeof(buffer), "draws %d tex switches %d", last.drawCalls, last.textureSwitches);
+    m_lines[2] = buffer;
+    snprintf(buffer, sizeof(buffer), "allocs/frame %llu", (unsigned long long)last.allocations);
+    m_lines[3] = buffer;
+    snprintf(buffer, sizeof(buffer), "peon %d tree %d stone %d other %d", m_world.peons, m_world.trees, m_world.stones, m_world.others);
+    m_lines[4] = buffer;
+    SoundStats sounds = m_game->GetSoundStats();
+    snprintf(buffer, sizeof(buffer), "sounds %llu overflow %llu drop %llu", (unsigned long long)sounds.played, (unsigned long long)sounds.overflows, (unsigned long long)sounds.dropped);
+    m_lines[5] = buffer;
+    snprintf(buffer, sizeof(buffer), "parked %llu coarse %llu", (unsigned long long)m_world.parked, (unsigned long long)m_world.coarse);
+    m_lines[6] = buffer;
+    const LatencyHistogram& latency = m_game->GetInputLatency();
+    snprintf(buffer, sizeof(buffer), "input lag p50 %d p99 %d ms", latency.GetPercentile(0.5), latency.GetPercentile(0.99));
+    m_lines[7] = buffer;
+    snprintf(buffer, sizeof(buffer), "particles %d update %.2f ms", m_world.particles, m_world.particleUpdateTime);
+    m_lines[8] = buffer;
+    snprintf(buffer, sizeof(buffer), "cpu %.0f%% skipped %llu frames", m_game->GetCpuMeter().GetUsage() * 100, (unsigned long long)m_game->GetSkippedFrames());
+    m_lines[9] = buffer;
+    snprintf(buffer, sizeof(buffer), "arena peak tick %llu frame %llu KB", (unsigned long long)(m_world.arenaPeak >> 10), (unsigned long long)(last.arenaPeak >> 10));
+    m_lines[10] = buffer;
+    snprintf(buffer, sizeof(buffer), "overlay %.3f ms", m_overlayTime);
+    m_lines[11] = buffer;
+}
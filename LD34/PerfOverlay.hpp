@@ -0,0 +1,62 @@
+#pragma once
+#include "PCH.hpp"
+#include "RenderSnapshot.hpp"
+
+class Game;
+
+// Timing and counters for a single frame, filled in by the game loop
+struct FrameStats
+{
+    double frameTime;
+    double simTime;
+    double renderTime;
+    int drawCalls;
+    int textureSwitches;
+    uint64_t allocations;
+    size_t arenaPeak;
+};
+
+// Toggleable debug overlay with a frame-time graph and render/object counters.
+// Text is only re-formatted a few times a second and drawn from the game's
+// glyph atlas, and the graph is submitted as a single batch of rects, so
+// drawing it is cheap and never allocates.
+class PerfOverlay
+{
+public:
+    PerfOverlay(Game* game);
+
+    void Toggle();
+    bool IsVisible() const;
+
+    void AddFrame(const FrameStats& stats);
+
+    // The world is counted by the simulation thread, and only read from here
+    void SetWorldStats(const WorldStats& stats);
+    void Render(SDL_Renderer* renderer);
+
+private:
+    void RefreshText();
+
+private:
+    static const int HISTORY_SIZE = 200;
+    static const int LINE_COUNT = 12;
+    static const int LINE_HEIGHT = 16;
+    static const int LINE_LENGTH = 64;
+    static const int GRAPH_HEIGHT = 70;
+    static const int X = 4;
+    static const int Y = 100;
+    const double REFRESH_TIME = 250;
+    const double GRAPH_SCALE = 2.0;
+
+    Game* m_game;
+    bool m_isVisible;
+
+    FrameStats m_history[HISTORY_SIZE];
+    WorldStats m_world;
+    int m_historyIndex;
+    double m_overlayTime;
+    Uint32 m_lastRefresh;
+
+    SDL_Rect m_bars[HISTORY_SIZE];
+    std::string m_lines[LINE_COUNT];
+};
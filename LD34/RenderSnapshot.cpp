@@ -0,0 +1,97 @@
+#include "PCH.hpp"
+#include "RenderSnapshot.hpp"
+#include <cstring>
+
+RenderSnapshot::RenderSnapshot() :
+    staticVersion(-1),
+    resources(0),
+    peons(0),
+    objectCount(0),
+    sceneHash(0),
+    inputTime(0),
+    inputSequence(0),
+    stats(),
+    m_buildingStaticLayer(false)
+{
+}
+
+void RenderSnapshot::Clear()
+{
+    sprites.clear();
+    selected.clear();
+    for (int i = 0; i < PARTICLE_LAYER_COUNT; i++)
+    {
+        particles[i].clear();
+    }
+}
+
+void RenderSnapshot::Reserve(size_t spriteCount, size_t selectedCount, int particlesPerLayer)
+{
+    // Doubling, so a slowly growing world does not reallocate every tick
+    if (sprites.capacity() < spriteCount)
+    {
+        sprites.reserve(std::max(spriteCount, sprites.capacity() * 2));
+    }
+
+    if (selected.capacity() < selectedCount)
+    {
+        selected.reserve(std::max(selectedCount, selected.capacity() * 2));
+    }
+
+    for (int i = 0; i < PARTICLE_LAYER_COUNT; i++)
+    {
+        particles[i].reserve(particlesPerLayer);
+    }
+}
+
+void RenderSnapshot::AddSprite(const std::string& texture, int x, int y, int width, int height)
+{
+    SpriteInstance sprite;
+    std::strncpy(sprite.texture, texture.c_str(), sizeof(sprite.texture) - 1);
+    sprite.texture[sizeof(sprite.texture) - 1] = '\0';
+    sprite.x = x;
+    sprite.y = y;
+    sprite.width = width;
+    sprite.height = height;
+    (m_buildingStaticLayer ? staticSprites : sprites).push_back(sprite);
+}
+
+void RenderSnapshot::BeginStaticLayer()
+{
+    staticSprites.clear();
+    m_buildingStaticLayer = true;
+}
+
+void RenderSnapshot::EndStaticLayer(int version)
+{
+    m_buildingStaticLayer = false;
+    staticVersion = version;
+}
+
+// FNV-1a a word at a time, which is plenty to tell frames apart
+static uint32_t HashWords(uint32_t hash, const void* data, size_t size)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i + 4 <= size; i += 4)
+    {
+        uint32_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * 16777619u;
+    }
+
+    return hash;
+}
+
+uint32_t RenderSnapshot::HashScene() const
+{
+    // Counts first, so the hash knows where the sprites end
+    uint32_t counts[2] = { (uint32_t)sprites.size(), (uint32_t)selected.size() };
+
+    uint32_t hash = 2166136261u;
+    hash = HashWords(hash, counts, sizeof(counts));
+    hash = HashWords(hash, &staticVersion, sizeof(staticVersion));
+    hash = HashWords(hash, sprites.data(), sprites.size() * sizeof(SpriteInstance));
+    hash = HashWords(hash, selected.data(), selected.size() * sizeof(SDL_Rect));
+    hash = HashWords(hash, &resources, sizeof(resources));
+    return HashWords(hash, &peons, sizeof(peons));
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include "PCH.hpp"
+#include "ParticleSystem.hpp"
+
+// A textured quad, drawn with the whole of a 32x32 texture
+struct SpriteInstance
+{
+    char texture[16];
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+// A particle as it is drawn, with its fade already applied to the color
+struct ParticleInstance
+{
+    float x;
+    float y;
+    float size;
+    SDL_Color color;
+};
+
+// Counters for the F3 overlay, taken when the snapshot is built
+struct WorldStats
+{
+    int tick;
+    double tickTime;
+    int peons;
+    int trees;
+    int stones;
+    int others;
+    size_t parked;
+    size_t coarse;
+    int particles;
+    double particleUpdateTime;
+    size_t arenaPeak;
+};
+
+// Everything needed to draw a frame of the world, copied out by the
+// simulation after a tick. Nothing in it points back into the world, so the
+// main thread can draw it while the next tick runs. The vectors keep their
+// capacity between uses.
+class RenderSnapshot
+{
+public:
+    RenderSnapshot();
+
+    void Clear();
+    void Reserve(size_t spriteCount, size_t selectedCount, int particlesPerLayer);
+    void AddSprite(const std::string& texture, int x, int y, int width, int height);
+
+    // Sprites added in between go to the static layer, replacing it
+    void BeginStaticLayer();
+    void EndStaticLayer(int version);
+
+    // Covers everything drawn but the particles, so two snapshots with the
+    // same hash only differ in ambient animation
+    uint32_t HashScene() const;
+
+public:
+    // Static objects in view, drawn under everything else. Kept across
+    // Clear(), and only rebuilt when the world's static version moves on.
+    std::vector<SpriteInstance> staticSprites;
+    int staticVersion;
+
+    // Other objects in view in draw order, carried loads included
+    std::vector<SpriteInstance> sprites;
+    std::vector<ParticleInstance> particles[PARTICLE_LAYER_COUNT];
+
+    // Peons the local player has selected
+    std::vector<SDL_Rect> selected;
+
+    // HUD
+    int resources;
+    int peons;
+
+    // Objects in the world, so the renderer can make room for all of them
+    // before drawing
+    size_t objectCount;
+
+    // HashScene(), only filled in when idle frames are being skipped
+    uint32_t sceneHash;
+
+    // The oldest input this snapshot shows the result of, numbered so the
+    // main thread only measures it once however many snapshots carry it
+    Uint32 inputTime;
+    int inputSequence;
+
+    WorldStats stats;
+
+private:
+    bool m_buildingStaticLayer;
+};
@@ -0,0 +1,40 @@
+#include "PCH.hpp"
+#include "Resource.hpp"
+#include "Game.hpp"
+
+Resource::Resource(Game* game, ResourceType type, int amount, int yield) :
+    m_type(type),
+    m_amount(amount),
+    m_yield(yield)
+{
+    m_game = game;
+    m_isStatic = true;
+}
+
+int Resource::Harvest()
+{
+    int harvested = std::min(m_yield, m_amount);
+    m_amount -= harvested;
+
+    if (harvested > 0 && m_amount <= 0)
+    {
+        m_game->RemoveResource(this);
+    }
+
+    return harvested;
+}
+
+ResourceType Resource::GetType() const
+{
+    return m_type;
+}
+
+int Resource::GetAmount() const
+{
+    return m_amount;
+}
+
+bool Resource::IsDepleted() const
+{
+    return m_amount <= 0;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "PCH.hpp"
+#include "GameObject.hpp"
+
+enum ResourceType { RESOURCE_TREE, RESOURCE_STONE, RESOURCE_TYPE_COUNT };
+
+// A gatherable node that holds a finite amount of resources. Once it has been
+// harvested dry it asks the game to remove it.
+class Resource : public GameObject
+{
+public:
+    Resource(Game* game, ResourceType type, int amount, int yield);
+
+    int Harvest();
+
+    ResourceType GetType() const;
+    int GetAmount() const;
+    bool IsDepleted() const;
+
+protected:
+    ResourceType m_type;
+    int m_amount;
+    int m_yield;
+};
@@ -0,0 +1,115 @@
+#include "PCH.hpp"
+#include "ResourceIndex.hpp"
+
+ResourceIndex::ResourceIndex(int width, int height, int cellSize) :
+    m_cellSize(cellSize),
+    m_columns(width / cellSize + 1),
+    m_rows(height / cellSize + 1)
+{
+    for (int type = 0; type < RESOURCE_TYPE_COUNT; type++)
+    {
+        m_cells[type].resize(m_columns * m_rows);
+        m_counts[type] = 0;
+    }
+}
+
+void ResourceIndex::Add(Handle handle, ResourceType type, Vector2D position)
+{
+    Entry entry;
+    entry.handle = handle;
+    entry.x = (float)position.GetX();
+    entry.y = (float)position.GetY();
+
+    m_cells[type][CellRow(position.GetY()) * m_columns + CellColumn(position.GetX())].push_back(entry);
+    m_counts[type]++;
+}
+
+void ResourceIndex::Remove(Handle handle, ResourceType type, Vector2D position)
+{
+    std::vector<Entry>& cell = m_cells[type][CellRow(position.GetY()) * m_columns + CellColumn(position.GetX())];
+    for (size_t i = 0; i < cell.size(); i++)
+    {
+        if (cell[i].handle == handle)
+        {
+            cell[i] = cell.back();
+            cell.pop_back();
+            m_counts[type]--;
+            return;
+        }
+    }
+}
+
+Handle ResourceIndex::FindNearest(ResourceType type, Vector2D position) const
+{
+    Handle best;
+    if (m_counts[type] == 0)
+    {
+        return best;
+    }
+
+    float x = (float)position.GetX();
+    float y = (float)position.GetY();
+    int column = CellColumn(x);
+    int row = CellRow(y);
+    float bestDistSq = 0;
+
+    // Search outwards ring by ring. Anything in ring r + 1 is at least
+    // r cells away, so we can stop as soon as the best hit is closer than that.
+    int maxRing = std::max(m_columns, m_rows);
+    for (int ring = 0; ring <= maxRing; ring++)
+    {
+        for (int r = row - ring; r <= row + ring; r++)
+        {
+            if (r < 0 || r >= m_rows)
+            {
+                continue;
+            }
+
+            bool edgeRow = (r == row - ring || r == row + ring);
+            int step = edgeRow ? 1 : ring * 2;
+            for (int c = column - ring; c <= column + ring; c += std::max(step, 1))
+            {
+                if (c < 0 || c >= m_columns)
+                {
+                    continue;
+                }
+
+                const std::vector<Entry>& cell = m_cells[type][r * m_columns + c];
+                for (size_t i = 0; i < cell.size(); i++)
+                {
+                    float dx = cell[i].x - x;
+                    float dy = cell[i].y - y;
+                    float distSq = dx * dx + dy * dy;
+                    if (best.IsNull() || distSq < bestDistSq)
+                    {
+                        best = cell[i].handle;
+                        bestDistSq = distSq;
+                    }
+                }
+            }
+        }
+
+        float reach = (float)(ring * m_cellSize);
+        if (!best.IsNull() && bestDistSq <= reach * reach)
+        {
+            break;
+        }
+    }
+
+    return best;
+}
+
+int ResourceIndex::GetCount(ResourceType type) const
+{
+    return m_counts[type];
+}
+
+int ResourceIndex::CellColumn(double x) const
+{
+    return std::min(std::max((int)(x / m_cellSize), 0), m_columns - 1);
+}
+
+int ResourceIndex::CellRow(double y) const
+{
+    return std::min(std::max((int)(y / m_cellSize), 0), m_rows - 1);
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "PCH.hpp"
+#include "Handle.hpp"
+#include "Resource.hpp"
+#include "Vector2D.hpp"
+
+// Coarse bucket grid of resource nodes per resource type. Entries are added
+// and removed as nodes spawn and deplete, so nearest-resource queries never
+// need a rebuild or a scan of every object.
+class ResourceIndex
+{
+public:
+    ResourceIndex(int width, int height, int cellSize);
+
+    void Add(Handle handle, ResourceType type, Vector2D position);
+    void Remove(Handle handle, ResourceType type, Vector2D position);
+    Handle FindNearest(ResourceType type, Vector2D position) const;
+    int GetCount(ResourceType type) const;
+
+private:
+    struct Entry
+    {
+        Handle handle;
+        float x;
+        float y;
+    };
+
+    int CellColumn(double x) const;
+    int CellRow(double y) const;
+
+private:
+    int m_cellSize;
+    int m_columns;
+    int m_rows;
+
+    std::vector<std::vector<Entry>> m_cells[RESOURCE_TYPE_COUNT];
+    int m_counts[RESOURCE_TYPE_COUNT];
+};
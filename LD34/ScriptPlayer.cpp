@@ -0,0 +1,157 @@
+#include "PCH.hpp"
+#include "ScriptPlayer.hpp"
+#include "Game.hpp"
+
+ScriptPlayer::ScriptPlayer(Game* game) :
+    m_game(game),
+    m_random(game->m_options.seed + game->GetLocalPlayer() + 1),
+    m_lastTick(-1)
+{
+}
+
+void ScriptPlayer::Update()
+{
+    int tick = m_game->GetTick();
+    if (tick == m_lastTick)
+    {
+        return;
+    }
+    m_lastTick = tick;
+
+    if (m_game->GetLockstep() != nullptr)
+    {
+        IssueCommands();
+    }
+    else
+    {
+        Act();
+    }
+}
+
+void ScriptPlayer::Act()
+{
+    int tick = m_game->GetTick();
+    int width = m_game->GetWidth();
+    int height = m_game->GetHeight();
+    int player = m_game->GetLocalPlayer();
+    const std::vector<Handle>& peons = m_game->GetPeonHandles();
+    Vector2D clicked(m_game->mouseX - 16, m_game->mouseY - 16);
+
+    if (tick % 300 == 0)
+    {
+        Vector2D position(m_game->Random() % width, m_game->Random() % height);
+        ResourceType type = (m_game->Random() % 2 == 0) ? RESOURCE_TREE : RESOURCE_STONE;
+
+        SelectionSet& selection = m_game->GetSelection(player);
+        selection.Clear();
+        for (std::vector<Handle>::const_iterator it = peons.begin(); it != peons.end(); it++)
+        {
+            Peon* peon = m_game->GetPeon(*it);
+            if (peon->m_targetResource.IsNull() && peon->m_state != Peon::SACRIFICE)
+            {
+                selection.Add(*it);
+            }
+        }
+
+        m_game->NotifySelectionChanged(player);
+        m_game->CommandPeons(player, m_game->GetGameObject(m_game->FindResource(type, position)), clicked);
+    }
+
+    if (tick % 600 == 300 && m_game->GetResources() >= 100 && !peons.empty())
+    {
+        SelectionSet& selection = m_game->GetSelection(player);
+        selection.Clear();
+        selection.Add(peons[m_game->Random() % peons.size()]);
+        m_game->NotifySelectionChanged(player);
+        m_game->CommandPeons(player, m_game->GetGameObject(m_game->GetMainBonfire()), clicked);
+    }
+
+    // Now and then everyone is rallied somewhere in formation and kept as
+    // control group 1, and twenty seconds later what is left of the group is
+    // moved again. Whoever is idle afterwards gets sent back to work.
+    if (tick % 3600 == 1350)
+    {
+        SelectionSet& selection = m_game->GetSelection(player);
+        selection.Clear();
+        for (std::vector<Handle>::const_iterator it = peons.begin(); it != peons.end(); it++)
+        {
+            if (m_game->GetPeon(*it)->m_state != Peon::SACRIFICE)
+            {
+                selection.Add(*it);
+            }
+        }
+
+        m_game->NotifySelectionChanged(player);
+        m_game->SetControlGroup(player, 0);
+        m_game->CommandPeons(player, nullptr, Vector2D(m_game->Random() % (width - 32), m_game->Random() % (height - 32)));
+    }
+
+    if (tick % 3600 == 2550)
+    {
+        m_game->RecallControlGroup(player, 0);
+        m_game->CommandPeons(player, nullptr, Vector2D(m_game->Random() % (width - 32), m_game->Random() % (height - 32)));
+    }
+}
+
+void ScriptPlayer::IssueCommands()
+{
+    // Each player looks after its own half of the map
+    int tick = m_game->GetTick();
+    int height = m_game->GetHeight();
+    int player = m_game->GetLocalPlayer();
+    int half = m_game->GetWidth() / 2;
+    int offset = player * 150;
+    const std::vector<Handle>& peons = m_game->GetPeonHandles();
+
+    if (tick % 300 == offset)
+    {
+        Vector2D position(m_random() % m_game->GetWidth(), m_random() % height);
+        ResourceType type = (m_random() % 2 == 0) ? RESOURCE_TREE : RESOURCE_STONE;
+        GameObject* target = m_game->GetGameObject(m_game->FindResource(type, position));
+        if (target != nullptr)
+        {
+            PlayerCommand deselect = { COMMAND_DESELECT, 0, 0, 0, 0 };
+            PlayerCommand select = { COMMAND_SELECT, (int16_t)(player * half), 0, (int16_t)half, (int16_t)height };
+            PlayerCommand move = { COMMAND_MOVE, (int16_t)(target->GetPosition().GetX() + 16), (int16_t)(target->GetPosition().GetY() + 16), 0, 0 };
+            m_game->PushCommand(deselect);
+            m_game->PushCommand(select);
+            m_game->PushCommand(move);
+        }
+    }
+
+    GameObject* bonfire = m_game->GetGameObject(m_game->GetMainBonfire());
+    if (tick % 600 == 300 + offset && m_game->GetResources() >= 100 && !peons.empty() && bonfire != nullptr)
+    {
+        Peon* peon = m_game->GetPeon(peons[m_random() % peons.size()]);
+        PlayerCommand deselect = { COMMAND_DESELECT, 0, 0, 0, 0 };
+        PlayerCommand select = { COMMAND_SELECT, (int16_t)(peon->GetPosition().GetX() + 16), (int16_t)(peon->GetPosition().GetY() + 16), 1, 1 };
+        PlayerCommand move = { COMMAND_MOVE, (int16_t)(bonfire->GetPosition().GetX() + 16), (int16_t)(bonfire->GetPosition().GetY() + 16), 0, 0 };
+        m_game->PushCommand(deselect);
+        m_game->PushCommand(select);
+        m_game->PushCommand(move);
+    }
+
+    // Our half is rallied in formation somewhere on our side and kept as
+    // control group 1, and what is left of the group is moved again later
+    if (tick % 3600 == 1350 + offset || tick % 3600 == 2550 + offset)
+    {
+        int16_t x = (int16_t)(player * half + 16 + m_random() % (half - 32));
+        int16_t y = (int16_t)(16 + m_random() % (height - 32));
+        PlayerCommand move = { COMMAND_MOVE, x, y, 0, 0 };
+        if (tick % 3600 == 1350 + offset)
+        {
+            PlayerCommand deselect = { COMMAND_DESELECT, 0, 0, 0, 0 };
+            PlayerCommand select = { COMMAND_SELECT, (int16_t)(player * half), 0, (int16_t)half, (int16_t)height };
+            PlayerCommand setGroup = { COMMAND_SET_GROUP, 0, 0, 0, 0 };
+            m_game->PushCommand(deselect);
+            m_game->PushCommand(select);
+            m_game->PushCommand(setGroup);
+        }
+        else
+        {
+            PlayerCommand recallGroup = { COMMAND_RECALL_GROUP, 0, 0, 0, 0 };
+            m_game->PushCommand(recallGroup);
+        }
+        m_game->PushCommand(move);
+    }
+}
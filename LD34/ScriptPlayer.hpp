@@ -0,0 +1,32 @@
+#pragma once
+#include "PCH.hpp"
+#include <random>
+
+class Game;
+
+// Scripted stand-in for the local player, used by headless and batch runs.
+// Every few seconds the peons without a job are sent to gather somewhere,
+// and every now and then one peon gets sacrificed.
+class ScriptPlayer
+{
+public:
+    ScriptPlayer(Game* game);
+
+    // Call before each tick runs. Does nothing when called again for a tick
+    // that stalled.
+    void Update();
+
+private:
+    // A single player game, which the script plays on the world directly
+    void Act();
+
+    // A lockstep game, where it only issues commands and rolls its own
+    // dice. Calling Random() here would desync the players, since the other
+    // side does not run this script.
+    void IssueCommands();
+
+private:
+    Game* m_game;
+    std::mt19937 m_random;
+    int m_lastTick;
+};
@@ -0,0 +1,68 @@
+#include "PCH.hpp"
+#include "SelectionSet.hpp"
+#include "AllocationCounter.hpp"
+
+SelectionSet::SelectionSet() :
+    m_count(0)
+{
+}
+
+void SelectionSet::Clear()
+{
+    if (m_count > 0)
+    {
+        std::fill(m_words.begin(), m_words.end(), 0);
+        m_count = 0;
+    }
+}
+
+void SelectionSet::Add(Handle handle)
+{
+    size_t word = handle.GetIndex() / 64;
+    if (word >= m_words.size())
+    {
+        // Only grows along with the world
+        AllocationExemption exemption;
+        m_words.resize(word + 1, 0);
+    }
+
+    uint64_t bit = (uint64_t)1 << (handle.GetIndex() % 64);
+    if ((m_words[word] & bit) == 0)
+    {
+        m_words[word] |= bit;
+        m_count++;
+    }
+}
+
+bool SelectionSet::Remove(Handle handle)
+{
+    if (!Contains(handle))
+    {
+        return false;
+    }
+
+    m_words[handle.GetIndex() / 64] &= ~((uint64_t)1 << (handle.GetIndex() % 64));
+    m_count--;
+    return true;
+}
+
+bool SelectionSet::Contains(Handle handle) const
+{
+    size_t word = handle.GetIndex() / 64;
+    if (word >= m_words.size())
+    {
+        return false;
+    }
+
+    return (m_words[word] & ((uint64_t)1 << (handle.GetIndex() % 64))) != 0;
+}
+
+size_t SelectionSet::GetCount() const
+{
+    return m_count;
+}
+
+bool SelectionSet::IsEmpty() const
+{
+    return m_count == 0;
+}
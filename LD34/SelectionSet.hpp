@@ -0,0 +1,56 @@
+#pragma once
+#include "PCH.hpp"
+#include "Handle.hpp"
+
+#if WINDOWS
+    #include <intrin.h>
+#endif
+
+// A set of objects kept as one bit per handle index, so adding, removing and
+// testing are a single bit operation and clearing is a pass over the words.
+// Members are visited in index order, which is the same on every peer. Only
+// the index is stored: whoever owns the set has to drop an object from it
+// when the object is destroyed, before its slot is handed out again.
+class SelectionSet
+{
+public:
+    SelectionSet();
+
+    void Clear();
+    void Add(Handle handle);
+    bool Remove(Handle handle);
+    bool Contains(Handle handle) const;
+    size_t GetCount() const;
+    bool IsEmpty() const;
+
+    // Calls visit(index) for the handle index of every member, lowest first
+    template <typename Visitor>
+    void ForEach(Visitor visit) const
+    {
+        for (size_t word = 0; word < m_words.size(); word++)
+        {
+            uint64_t bits = m_words[word];
+            while (bits != 0)
+            {
+                visit((uint32_t)(word * 64 + LowestBit(bits)));
+                bits &= bits - 1;
+            }
+        }
+    }
+
+private:
+    static int LowestBit(uint64_t bits)
+    {
+#if WINDOWS
+        unsigned long index;
+        _BitScanForward64(&index, bits);
+        return (int)index;
+#else
+        return __builtin_ctzll(bits);
+#endif
+    }
+
+private:
+    std::vector<uint64_t> m_words;
+    size_t m_count;
+};
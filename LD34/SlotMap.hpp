@@ -0,0 +1,171 @@
+#pragma once
+#include "PCH.hpp"
+#include "Handle.hpp"
+
+// Owns a set of values addressed by generational handles. Values are kept
+// packed in a dense array (removal swaps the last value into the hole), so
+// iterating over everything never touches dead entries. Slots are recycled
+// through a free list and bump their generation every time they are freed.
+// A slot whose generation has run out is retired rather than reused, as its
+// next handle would match ones handed out long ago. Each slot can hold
+// GENERATION_MASK values over its life, and there are MAX_INDEX + 1 slots.
+template <typename T>
+class SlotMap
+{
+public:
+    typedef typename std::vector<T>::iterator iterator;
+    typedef typename std::vector<T>::const_iterator const_iterator;
+
+    // False once every slot is taken or retired. Insert() fails then, and
+    // destroys the value it was given.
+    bool CanInsert() const
+    {
+        return !m_freeSlots.empty() || m_slots.size() <= Handle::MAX_INDEX;
+    }
+
+    Handle Insert(T value)
+    {
+        uint32_t slotIndex;
+        if (!m_freeSlots.empty())
+        {
+            slotIndex = m_freeSlots.back();
+            m_freeSlots.pop_back();
+        }
+        else
+        {
+            slotIndex = (uint32_t)m_slots.size();
+            if (slotIndex > Handle::MAX_INDEX)
+            {
+                return Handle();
+            }
+
+            Slot slot;
+            slot.generation = 1;
+            m_slots.push_back(slot);
+
+            // So that Remove() never has to grow the free list
+            m_freeSlots.reserve(m_slots.capacity());
+        }
+
+        Slot& slot = m_slots[slotIndex];
+        slot.denseIndex = (uint32_t)m_dense.size();
+
+        m_dense.push_back(std::move(value));
+        m_denseToSlot.push_back(slotIndex);
+
+        return Handle(slotIndex, slot.generation);
+    }
+
+    bool Remove(Handle handle)
+    {
+        if (!Contains(handle))
+        {
+            return false;
+        }
+
+        Slot& slot = m_slots[handle.GetIndex()];
+        uint32_t hole = slot.denseIndex;
+        uint32_t last = (uint32_t)m_dense.size() - 1;
+
+        // Keep the dense array packed by moving the last value into the hole
+        if (hole != last)
+        {
+            m_dense[hole] = std::move(m_dense[last]);
+            m_denseToSlot[hole] = m_denseToSlot[last];
+            m_slots[m_denseToSlot[hole]].denseIndex = hole;
+        }
+
+        m_dense.pop_back();
+        m_denseToSlot.pop_back();
+
+        // A retired slot keeps the last generation, so every handle to it
+        // stays stale for good
+        if (slot.generation == Handle::GENERATION_MASK)
+        {
+            return true;
+        }
+
+        slot.generation++;
+        m_freeSlots.push_back(handle.GetIndex());
+        return true;
+    }
+
+    bool Contains(Handle handle) const
+    {
+        if (handle.IsNull() || handle.GetIndex() >= m_slots.size())
+        {
+            return false;
+        }
+
+        return m_slots[handle.GetIndex()].generation == handle.GetGeneration();
+    }
+
+    T* Get(Handle handle)
+    {
+        return Contains(handle) ? &m_dense[m_slots[handle.GetIndex()].denseIndex] : nullptr;
+    }
+
+    const T* Get(Handle handle) const
+    {
+        return Contains(handle) ? &m_dense[m_slots[handle.GetIndex()].denseIndex] : nullptr;
+    }
+
+    // Handle of the value stored at a position in the dense array
+    Handle HandleAt(size_t denseIndex) const
+    {
+        uint32_t slotIndex = m_denseToSlot[denseIndex];
+        return Handle(slotIndex, m_slots[slotIndex].generation);
+    }
+
+    // Handle of whatever lives in a slot now, for callers that only kept
+    // the index of a handle and know the value is still there
+    Handle HandleOfSlot(uint32_t slotIndex) const
+    {
+        return Handle(slotIndex, m_slots[slotIndex].generation);
+    }
+
+    T& operator[](size_t denseIndex)
+    {
+        return m_dense[denseIndex];
+    }
+
+    const T& operator[](size_t denseIndex) const
+    {
+        return m_dense[denseIndex];
+    }
+
+    size_t Size() const
+    {
+        return m_dense.size();
+    }
+
+    bool Empty() const
+    {
+        return m_dense.empty();
+    }
+
+    void Clear()
+    {
+        while (!m_dense.empty())
+        {
+            Remove(HandleAt(m_dense.size() - 1));
+        }
+    }
+
+    iterator begin() { return m_dense.begin(); }
+    iterator end() { return m_dense.end(); }
+    const_iterator begin() const { return m_dense.begin(); }
+    const_iterator end() const { return m_dense.end(); }
+
+private:
+    struct Slot
+    {
+        uint32_t denseIndex;
+        uint32_t generation;
+    };
+
+    std::vector<T> m_dense;
+    std::vector<uint32_t> m_denseToSlot;
+    std::vector<Slot> m_slots;
+    std::vector<uint32_t> m_freeSlots;
+};
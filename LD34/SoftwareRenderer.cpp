@@ -0,0 +1,721 @@
+#include "PCH.hpp"
+#include "SoftwareRenderer.hpp"
+#include "Logger.hpp"
+#include "MemoryTracker.hpp"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define SOFTWARE_RENDERER_SSE2 1
+#endif
+
+static const uint32_t OPAQUE_ALPHA = 0xFF000000u;
+
+static uint32_t PackColor(Uint8 r, Uint8 g, Uint8 b, Uint8 a)
+{
+    return (uint32_t)r | ((uint32_t)g << 8) | ((uint32_t)b << 16) | ((uint32_t)a << 24);
+}
+
+// (x * a + y * (255 - a)) / 255, rounded
+static uint32_t BlendChannel(uint32_t x, uint32_t y, uint32_t a)
+{
+    uint32_t t = x * a + y * (255 - a) + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+static uint32_t BlendPixel(uint32_t src, uint32_t dst)
+{
+    uint32_t a = src >> 24;
+    if (a == 255)
+    {
+        return src;
+    }
+    if (a == 0)
+    {
+        return dst;
+    }
+
+    uint32_t r = BlendChannel(src & 0xFF, dst & 0xFF, a);
+    uint32_t g = BlendChannel((src >> 8) & 0xFF, (dst >> 8) & 0xFF, a);
+    uint32_t b = BlendChannel((src >> 16) & 0xFF, (dst >> 16) & 0xFF, a);
+    return r | (g << 8) | (b << 16) | OPAQUE_ALPHA;
+}
+
+#if SOFTWARE_RENDERER_SSE2
+// Blend two pixels widened to 16 bits per channel
+static __m128i BlendWide(__m128i src, __m128i dst)
+{
+    __m128i alpha = _mm_shufflelo_epi16(src, _MM_SHUFFLE(3, 3, 3, 3));
+    alpha = _mm_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+    __m128i inverse = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(src, alpha), _mm_mullo_epi16(dst, inverse));
+    t = _mm_add_epi16(t, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+#endif
+
+// Alpha blend a span of source pixels over the framebuffer
+static void BlendSpan(uint32_t* dst, const uint32_t* src, int count)
+{
+    int i = 0;
+
+#if SOFTWARE_RENDERER_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alphaMask = _mm_set1_epi32((int)OPAQUE_ALPHA);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+
+        // Whole groups of opaque or empty pixels are common in sprites
+        int opaque = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(s, alphaMask), alphaMask));
+        if (opaque == 0xFFFF)
+        {
+            _mm_storeu_si128((__m128i*)(dst + i), s);
+            continue;
+        }
+        int empty = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(s, alphaMask), zero));
+        if (empty == 0xFFFF)
+        {
+            continue;
+        }
+
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i low = BlendWide(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+        __m128i high = BlendWide(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(_mm_packus_epi16(low, high), alphaMask));
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        dst[i] = BlendPixel(src[i], dst[i]);
+    }
+}
+
+// Multiply every channel of a span by a tint. An opaque tint keeps alpha
+// as it is.
+static void TintSpan(uint32_t* pixels, uint32_t tint, int count)
+{
+    uint32_t r = tint & 0xFF;
+    uint32_t g = (tint >> 8) & 0xFF;
+    uint32_t b = (tint >> 16) & 0xFF;
+    uint32_t a = tint >> 24;
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t p = pixels[i];
+        uint32_t pr = ((p & 0xFF) * r + 255) >> 8;
+        uint32_t pg = (((p >> 8) & 0xFF) * g + 255) >> 8;
+        uint32_t pb = (((p >> 16) & 0xFF) * b + 255) >> 8;
+        uint32_t pa = ((p >> 24) * a + 255) >> 8;
+        pixels[i] = (pa << 24) | (pb << 16) | (pg << 8) | pr;
+    }
+}
+
+static void FillSpan(uint32_t* dst, uint32_t color, int count)
+{
+    if ((color >> 24) == 255)
+    {
+        std::fill(dst, dst + count, color);
+        return;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        dst[i] = BlendPixel(color, dst[i]);
+    }
+}
+
+SoftwareRenderer::SoftwareRenderer(int width, int height, int threads) :
+    m_width(width),
+    m_height(height),
+    m_loadedImages(0),
+    m_nextTile(0),
+    m_tilesDone(0),
+    m_frame(0),
+    m_quit(false)
+{
+    m_tileColumns = (width + TILE_SIZE - 1) / TILE_SIZE;
+    m_tileRows = (height + TILE_SIZE - 1) / TILE_SIZE;
+    m_tileCount = m_tileColumns * m_tileRows;
+    m_tileCommands.resize(m_tileCount);
+    m_batchTileStart.assign(m_tileCount + 1, 0);
+    m_batchTileCursor.assign(m_tileCount, 0);
+    m_batches.reserve(16);
+    m_pixels.assign((size_t)width * height, OPAQUE_ALPHA);
+
+    if (threads <= 0)
+    {
+        threads = (int)std::thread::hardware_concurrency();
+    }
+
+    // The thread calling Flush() rasterizes too
+    for (int i = 1; i < threads; i++)
+    {
+        m_workers.push_back(std::thread(&SoftwareRenderer::WorkerLoop, this));
+    }
+}
+
+SoftwareRenderer::~SoftwareRenderer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+
+    for (size_t i = 0; i < m_workers.size(); i++)
+    {
+        m_workers[i].join();
+    }
+}
+
+bool SoftwareRenderer::LoadTexture(const std::string& id, SDL_Surface* surface)
+{
+    int image = AddImage(surface);
+    if (image < 0)
+    {
+        return false;
+    }
+
+    MEMORY_SCOPE(MEMORY_STRINGS);
+    m_imageMap[id] = image;
+    m_loadedImages = m_images.size();
+    return true;
+}
+
+int64_t SoftwareRenderer::GetImageBytes() const
+{
+    int64_t bytes = 0;
+    for (size_t i = 0; i < m_loadedImages; i++)
+    {
+        bytes += (int64_t)m_images[i].pixels.size() * sizeof(uint32_t);
+    }
+
+    return bytes;
+}
+
+int SoftwareRenderer::AddImage(SDL_Surface* surface)
+{
+    if (surface == nullptr)
+    {
+        return -1;
+    }
+
+    SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+    if (converted == nullptr)
+    {
+        LOG_ERROR("Unable to convert surface for the software renderer! SDL error: %s", SDL_GetError());
+        return -1;
+    }
+
+    Image image;
+    image.width = converted->w;
+    image.height = converted->h;
+    image.pixels.resize((size_t)image.width * image.height);
+
+    SDL_LockSurface(converted);
+    for (int y = 0; y < image.height; y++)
+    {
+        const Uint8* row = (const Uint8*)converted->pixels + y * converted->pitch;
+        std::memcpy(&image.pixels[(size_t)y * image.width], row, image.width * sizeof(uint32_t));
+    }
+    SDL_UnlockSurface(converted);
+    SDL_FreeSurface(converted);
+
+    m_images.push_back(std::move(image));
+    return (int)m_images.size() - 1;
+}
+
+void SoftwareRenderer::Clear(Uint8 r, Uint8 g, Uint8 b)
+{
+    // Nothing drawn before a clear can show, so drop it
+    m_commands.clear();
+
+    SDL_Rect screen = { 0, 0, m_width, m_height };
+    SDL_Color color = { r, g, b, 255 };
+    FillRect(screen, color);
+}
+
+void SoftwareRenderer::DrawImage(const std::string& id, const SDL_Rect& src, const SDL_Rect& dest, SDL_Color tint)
+{
+    std::map<std::string, int>::const_iterator it = m_imageMap.find(id);
+    if (it == m_imageMap.end())
+    {
+        return;
+    }
+
+    Command command;
+    command.image = it->second;
+    command.src = src;
+    command.dest = dest;
+
+    // Image commands use the colour as a tint, with 0 for none
+    bool white = (tint.r == 255 && tint.g == 255 && tint.b == 255);
+    command.color = white ? 0 : PackColor(tint.r, tint.g, tint.b, 255);
+    command.batch = -1;
+    Record(command);
+}
+
+void SoftwareRenderer::DrawSurface(SDL_Surface* surface, int x, int y)
+{
+    // Kept until the end of the frame, since drawing happens in Flush()
+    int image = AddImage(surface);
+    if (image < 0)
+    {
+        return;
+    }
+
+    Command command;
+    command.image = image;
+    command.src.x = 0;
+    command.src.y = 0;
+    command.src.w = m_images[image].width;
+    command.src.h = m_images[image].height;
+    command.dest.x = x;
+    command.dest.y = y;
+    command.dest.w = command.src.w;
+    command.dest.h = command.src.h;
+    command.color = 0;
+    command.batch = -1;
+    Record(command);
+}
+
+void SoftwareRenderer::FillRect(const SDL_Rect& rect, SDL_Color color)
+{
+    Command command;
+    command.image = -1;
+    command.src = rect;
+    command.dest = rect;
+    command.color = PackColor(color.r, color.g, color.b, color.a);
+    command.batch = -1;
+    Record(command);
+}
+
+void SoftwareRenderer::DrawRect(const SDL_Rect& rect, SDL_Color color)
+{
+    // Same outline as SDL_RenderDrawRect, which also accepts negative sizes
+    int x0 = std::min(rect.x, rect.x + rect.w);
+    int y0 = std::min(rect.y, rect.y + rect.h);
+    int w = std::abs(rect.w);
+    int h = std::abs(rect.h);
+    if (w == 0 || h == 0)
+    {
+        return;
+    }
+
+    SDL_Rect top = { x0, y0, w, 1 };
+    SDL_Rect bottom = { x0, y0 + h - 1, w, 1 };
+    SDL_Rect left = { x0, y0, 1, h };
+    SDL_Rect right = { x0 + w - 1, y0, 1, h };
+    FillRect(top, color);
+    FillRect(bottom, color);
+    FillRect(left, color);
+    FillRect(right, color);
+}
+
+void SoftwareRenderer::BeginBatch(const std::string& id)
+{
+    Batch batch;
+    batch.image = -1;
+    batch.first = (int)m_batchQuads.size();
+    batch.count = 0;
+
+    std::map<std::string, int>::const_iterator it = m_imageMap.find(id);
+    if (it != m_imageMap.end())
+    {
+        batch.image = it->second;
+    }
+
+    m_batches.push_back(batch);
+}
+
+void SoftwareRenderer::AddToBatch(const SDL_Rect& dest, SDL_Color color)
+{
+    if (dest.w <= 0 || dest.h <= 0 || dest.x >= m_width || dest.y >= m_height || dest.x + dest.w <= 0 || dest.y + dest.h <= 0)
+    {
+        return;
+    }
+
+    BatchQuad quad;
+    quad.dest = dest;
+    quad.color = PackColor(color.r, color.g, color.b, color.a);
+    m_batchQuads.push_back(quad);
+    m_batches.back().count++;
+}
+
+void SoftwareRenderer::EndBatch()
+{
+    if (m_batches.back().count == 0)
+    {
+        m_batches.pop_back();
+        return;
+    }
+
+    // Covers the whole screen, so it lands in every tile's list at the
+    // right place in the draw order
+    Command command;
+    command.image = m_batches.back().image;
+    command.src.x = 0;
+    command.src.y = 0;
+    command.src.w = m_width;
+    command.src.h = m_height;
+    command.dest = command.src;
+    command.color = 0;
+    command.batch = (int)m_batches.size() - 1;
+    Record(command);
+}
+
+void SoftwareRenderer::ReserveBatches(size_t quads)
+{
+    // Small quads touch at most four tiles
+    m_batchQuads.reserve(quads);
+    m_batchEntries.reserve(quads * 4);
+}
+
+void SoftwareRenderer::Record(const Command& command)
+{
+    if (command.dest.w <= 0 || command.dest.h <= 0 || command.src.w <= 0 || command.src.h <= 0)
+    {
+        return;
+    }
+
+    if (command.dest.x >= m_width || command.dest.y >= m_height || command.dest.x + command.dest.w <= 0 || command.dest.y + command.dest.h <= 0)
+    {
+        return;
+    }
+
+    m_commands.push_back(command);
+}
+
+void SoftwareRenderer::Reserve(size_t commands)
+{
+    if (m_commands.capacity() >= commands)
+    {
+        return;
+    }
+
+    // Any tile might end up with every draw
+    commands = std::max(commands, m_commands.capacity() * 2);
+    m_commands.reserve(commands);
+    for (int i = 0; i < m_tileCount; i++)
+    {
+        m_tileCommands[i].reserve(commands);
+    }
+}
+
+void SoftwareRenderer::Flush()
+{
+    // Bin every command into the tiles it overlaps. Commands are appended in
+    // order, so each tile still draws back to front.
+    for (int i = 0; i < m_tileCount; i++)
+    {
+        m_tileCommands[i].clear();
+    }
+
+    for (size_t i = 0; i < m_commands.size(); i++)
+    {
+        const SDL_Rect& dest = m_commands[i].dest;
+        int column0 = std::max(dest.x, 0) / TILE_SIZE;
+        int row0 = std::max(dest.y, 0) / TILE_SIZE;
+        int column1 = std::min(dest.x + dest.w - 1, m_width - 1) / TILE_SIZE;
+        int row1 = std::min(dest.y + dest.h - 1, m_height - 1) / TILE_SIZE;
+
+        for (int row = row0; row <= row1; row++)
+        {
+            for (int column = column0; column <= column1; column++)
+            {
+                m_tileCommands[row * m_tileColumns + column].push_back((int)i);
+            }
+        }
+    }
+
+    BinBatchQuads();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tilesDone = 0;
+        m_nextTile.store(0);
+        m_frame++;
+    }
+    m_wake.notify_all();
+
+    RasterizeTiles();
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_finished.wait(lock, [this] { return m_tilesDone == m_tileCount; });
+    }
+
+    m_commands.clear();
+    m_batches.clear();
+    m_batchQuads.clear();
+    m_images.resize(m_loadedImages);
+}
+
+void SoftwareRenderer::BinBatchQuads()
+{
+    // Count the quads per tile, turn the counts into offsets, then drop each
+    // quad into place. Quads are visited in order, so every tile's range
+    // stays in submission order.
+    std::fill(m_batchTileStart.begin(), m_batchTileStart.end(), 0);
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (size_t i = 0; i < m_batchQuads.size(); i++)
+        {
+            const SDL_Rect& dest = m_batchQuads[i].dest;
+            int column0 = std::max(dest.x, 0) / TILE_SIZE;
+            int row0 = std::max(dest.y, 0) / TILE_SIZE;
+            int column1 = std::min(dest.x + dest.w - 1, m_width - 1) / TILE_SIZE;
+            int row1 = std::min(dest.y + dest.h - 1, m_height - 1) / TILE_SIZE;
+
+            for (int row = row0; row <= row1; row++)
+            {
+                for (int column = column0; column <= column1; column++)
+                {
+                    int tile = row * m_tileColumns + column;
+                    if (pass == 0)
+                    {
+                        m_batchTileStart[tile + 1]++;
+                    }
+                    else
+                    {
+                        m_batchEntries[m_batchTileCursor[tile]++] = (int)i;
+                    }
+                }
+            }
+        }
+
+        if (pass == 0)
+        {
+            for (int tile = 0; tile < m_tileCount; tile++)
+            {
+                m_batchTileStart[tile + 1] += m_batchTileStart[tile];
+                m_batchTileCursor[tile] = m_batchTileStart[tile];
+            }
+            m_batchEntries.resize(m_batchTileStart[m_tileCount]);
+        }
+    }
+}
+
+void SoftwareRenderer::RasterizeTiles()
+{
+    uint32_t scratch[TILE_SIZE];
+
+    int done = 0;
+    for (;;)
+    {
+        int tile = m_nextTile.fetch_add(1);
+        if (tile >= m_tileCount)
+        {
+            break;
+        }
+
+        RasterizeTile(tile, scratch);
+        done++;
+    }
+
+    if (done > 0)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tilesDone += done;
+        if (m_tilesDone == m_tileCount)
+        {
+            m_finished.notify_one();
+        }
+    }
+}
+
+void SoftwareRenderer::RasterizeTile(int tile, uint32_t* scratch)
+{
+    int tileX = (tile % m_tileColumns) * TILE_SIZE;
+    int tileY = (tile / m_tileColumns) * TILE_SIZE;
+    int tileRight = std::min(tileX + TILE_SIZE, m_width);
+    int tileBottom = std::min(tileY + TILE_SIZE, m_height);
+
+    SDL_Rect tileRect = { tileX, tileY, tileRight - tileX, tileBottom - tileY };
+    int nextQuad = m_batchTileStart[tile];
+    int lastQuad = m_batchTileStart[tile + 1];
+
+    const std::vector<int>& commands = m_tileCommands[tile];
+    for (size_t i = 0; i < commands.size(); i++)
+    {
+        const Command& command = m_commands[commands[i]];
+        const SDL_Rect& dest = command.dest;
+
+        int x0 = std::max(dest.x, tileX);
+        int y0 = std::max(dest.y, tileY);
+        int x1 = std::min(dest.x + dest.w, tileRight);
+        int y1 = std::min(dest.y + dest.h, tileBottom);
+        int count = x1 - x0;
+        if (count <= 0 || y0 >= y1)
+        {
+            continue;
+        }
+
+        // Batches come in order, so this tile's quads for the batch are the
+        // next ones in its range
+        if (command.batch >= 0)
+        {
+            const Batch& batch = m_batches[command.batch];
+            for (; nextQuad < lastQuad && m_batchEntries[nextQuad] < batch.first + batch.count; nextQuad++)
+            {
+                RasterizeQuad(m_batchQuads[m_batchEntries[nextQuad]], batch.image, tileRect, scratch);
+            }
+            continue;
+        }
+
+        if (command.image < 0)
+        {
+            for (int y = y0; y < y1; y++)
+            {
+                FillSpan(&m_pixels[(size_t)y * m_width + x0], command.color, count);
+            }
+            continue;
+        }
+
+        // Nearest neighbour sampling, with a straight copy when not scaled
+        const Image& image = m_images[command.image];
+        const SDL_Rect& src = command.src;
+        bool scaled = (src.w != dest.w);
+        for (int y = y0; y < y1; y++)
+        {
+            int srcY = src.y + (y - dest.y) * src.h / dest.h;
+            if (srcY < 0 || srcY >= image.height)
+            {
+                continue;
+            }
+
+            const uint32_t* srcRow = &image.pixels[(size_t)srcY * image.width];
+            uint32_t* dstRow = &m_pixels[(size_t)y * m_width + x0];
+            if (!scaled && command.color == 0 && src.x + (x0 - dest.x) >= 0 && src.x + (x1 - dest.x) <= image.width)
+            {
+                BlendSpan(dstRow, srcRow + src.x + (x0 - dest.x), count);
+                continue;
+            }
+
+            for (int x = x0; x < x1; x++)
+            {
+                int srcX = src.x + (x - dest.x) * src.w / dest.w;
+                scratch[x - x0] = (srcX >= 0 && srcX < image.width) ? srcRow[srcX] : 0;
+            }
+            if (command.color != 0)
+            {
+                TintSpan(scratch, command.color, count);
+            }
+            BlendSpan(dstRow, scratch, count);
+        }
+    }
+}
+
+void SoftwareRenderer::RasterizeQuad(const BatchQuad& quad, int image, const SDL_Rect& tile, uint32_t* scratch)
+{
+    const SDL_Rect& dest = quad.dest;
+    int x0 = std::max(dest.x, tile.x);
+    int y0 = std::max(dest.y, tile.y);
+    int x1 = std::min(dest.x + dest.w, tile.x + tile.w);
+    int y1 = std::min(dest.y + dest.h, tile.y + tile.h);
+    int count = x1 - x0;
+    if (count <= 0 || y0 >= y1)
+    {
+        return;
+    }
+
+    if (image < 0)
+    {
+        for (int y = y0; y < y1; y++)
+        {
+            FillSpan(&m_pixels[(size_t)y * m_width + x0], quad.color, count);
+        }
+        return;
+    }
+
+    // The whole image squeezed into the quad
+    const Image& source = m_images[image];
+    for (int y = y0; y < y1; y++)
+    {
+        const uint32_t* srcRow = &source.pixels[(size_t)((y - dest.y) * source.height / dest.h) * source.width];
+        for (int x = x0; x < x1; x++)
+        {
+            scratch[x - x0] = srcRow[(x - dest.x) * source.width / dest.w];
+        }
+
+        TintSpan(scratch, quad.color, count);
+        BlendSpan(&m_pixels[(size_t)y * m_width + x0], scratch, count);
+    }
+}
+
+void SoftwareRenderer::WorkerLoop()
+{
+    uint64_t frame = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this, frame] { return m_quit || m_frame != frame; });
+            if (m_quit)
+            {
+                return;
+            }
+            frame = m_frame;
+        }
+
+        RasterizeTiles();
+    }
+}
+
+const uint32_t* SoftwareRenderer::GetPixels() const
+{
+    return m_pixels.data();
+}
+
+int SoftwareRenderer::GetWidth() const
+{
+    return m_width;
+}
+
+int SoftwareRenderer::GetHeight() const
+{
+    return m_height;
+}
+
+int SoftwareRenderer::GetThreadCount() const
+{
+    return (int)m_workers.size() + 1;
+}
+
+uint32_t SoftwareRenderer::Checksum() const
+{
+    // FNV-1a over the framebuffer, to compare frames without saving them
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < m_pixels.size(); i++)
+    {
+        hash = (hash ^ m_pixels[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+bool SoftwareRenderer::SavePNG(const std::string& path) const
+{
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom((void*)m_pixels.data(), m_width, m_height, 32, m_width * sizeof(uint32_t), SDL_PIXELFORMAT_RGBA32);
+    if (surface == nullptr)
+    {
+        LOG_ERROR("Unable to create surface for %s! SDL error: %s", path.c_str(), SDL_GetError());
+        return false;
+    }
+
+    bool saved = (IMG_SavePNG(surface, path.c_str()) == 0);
+    if (!saved)
+    {
+        LOG_ERROR("Unable to save %s! SDL_image error: %s", path.c_str(), IMG_GetError());
+    }
+
+    SDL_FreeSurface(surface);
+    return saved;
+}
+
+bool SoftwareRenderer::WriteRaw(std::FILE* file) const
+{
+    return std::fwrite(m_pixels.data(), sizeof(uint32_t), m_pixels.size(), file) == m_pixels.size();
+}
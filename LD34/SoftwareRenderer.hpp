@@ -0,0 +1,132 @@
+#pragma once
+#include "PCH.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+// CPU rasterizer that composites sprites into an RGBA framebuffer, so a full
+// frame can be rendered, timed and saved without a GPU or even a window.
+// Draws are only recorded during the frame. Flush() sorts them into screen
+// tiles and a pool of threads rasterizes the tiles, each one walking its
+// draws in submission order, with SSE2 alpha blending where available.
+class SoftwareRenderer
+{
+public:
+    SoftwareRenderer(int width, int height, int threads);
+    ~SoftwareRenderer();
+
+    // Images are copied, so the surface can be freed afterwards
+    bool LoadTexture(const std::string& id, SDL_Surface* surface);
+    int64_t GetImageBytes() const;
+
+    void Clear(Uint8 r, Uint8 g, Uint8 b);
+    // The image's colour is multiplied by tint, like SDL_SetTextureColorMod()
+    void DrawImage(const std::string& id, const SDL_Rect& src, const SDL_Rect& dest, SDL_Color tint = {255, 255, 255, 255});
+    void DrawSurface(SDL_Surface* surface, int x, int y);
+    void FillRect(const SDL_Rect& rect, SDL_Color color);
+    void DrawRect(const SDL_Rect& rect, SDL_Color color);
+
+    // Lots of small quads drawn as a single command, such as particles. Each
+    // quad is the image scaled to fit, or a solid square when id is empty,
+    // multiplied by the quad's colour, alpha included. Quads are binned into
+    // tiles with a counting sort, so they cost no allocation up to the
+    // number reserved.
+    void BeginBatch(const std::string& id);
+    void AddToBatch(const SDL_Rect& dest, SDL_Color color);
+    void EndBatch();
+    void ReserveBatches(size_t quads);
+
+    // Make room for this many draws per frame, so recording and binning
+    // them does not allocate
+    void Reserve(size_t commands);
+
+    // Rasterize everything recorded since the last flush
+    void Flush();
+
+    // Pixels are 32 bits in R, G, B, A byte order (SDL_PIXELFORMAT_RGBA32)
+    const uint32_t* GetPixels() const;
+    int GetWidth() const;
+    int GetHeight() const;
+    int GetThreadCount() const;
+    uint32_t Checksum() const;
+
+    bool SavePNG(const std::string& path) const;
+    bool WriteRaw(std::FILE* file) const;
+
+private:
+    struct Image
+    {
+        int width;
+        int height;
+        std::vector<uint32_t> pixels;
+    };
+
+    struct Command
+    {
+        int image;
+        SDL_Rect src;
+        SDL_Rect dest;
+        uint32_t color;
+
+        // Index into m_batches, or -1 for a single draw
+        int batch;
+    };
+
+    struct Batch
+    {
+        int image;
+        int first;
+        int count;
+    };
+
+    struct BatchQuad
+    {
+        SDL_Rect dest;
+        uint32_t color;
+    };
+
+    int AddImage(SDL_Surface* surface);
+    void Record(const Command& command);
+    void BinBatchQuads();
+    void RasterizeTiles();
+    void RasterizeTile(int tile, uint32_t* scratch);
+    void RasterizeQuad(const BatchQuad& quad, int image, const SDL_Rect& tile, uint32_t* scratch);
+    void WorkerLoop();
+
+private:
+    static const int TILE_SIZE = 64;
+
+    int m_width;
+    int m_height;
+    int m_tileColumns;
+    int m_tileRows;
+    int m_tileCount;
+    std::vector<uint32_t> m_pixels;
+
+    std::vector<Image> m_images;
+    std::map<std::string, int> m_imageMap;
+    size_t m_loadedImages;
+
+    std::vector<Command> m_commands;
+    std::vector<std::vector<int>> m_tileCommands;
+
+    // Batched quads, and for each tile the range of m_batchEntries listing
+    // the quads that touch it in submission order
+    std::vector<Batch> m_batches;
+    std::vector<BatchQuad> m_batchQuads;
+    std::vector<int> m_batchEntries;
+    std::vector<int> m_batchTileStart;
+    std::vector<int> m_batchTileCursor;
+
+    // Workers sleep until m_frame changes, then take tiles from m_nextTile
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_finished;
+    std::atomic<int> m_nextTile;
+    int m_tilesDone;
+    uint64_t m_frame;
+    bool m_quit;
+};
@@ -2,20 +2,15 @@
 #include "Stone.hpp"
 #include "Game.hpp"
 
-Stone::Stone(Game* game)
+Stone::Stone(Game* game) :
+    Resource(game, RESOURCE_STONE, AMOUNT, YIELD)
 {
-    m_game = game;
     m_ID = "stone";
 }
 
-void Stone::Update()
+void Stone::Render(RenderSnapshot& snapshot)
 {
-    GameObject::Update();
-}
-
-void Stone::Render()
-{
-    GameObject::Render();
+    GameObject::Render(snapshot);
 }
 
 void Stone::Clean()
@@ -1,13 +1,16 @@
 #pragma once
 #include "PCH.hpp"
-#include "GameObject.hpp"
+#include "Resource.hpp"
 
-class Stone : public GameObject
+class Stone : public Resource
 {
 public:
     Stone(Game* game);
 
-    void Update();
-    void Render();
+    void Render(RenderSnapshot& snapshot);
     void Clean();
+
+public:
+    static const int AMOUNT = 60;
+    static const int YIELD = 2;
 };
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+#include "PCH.hpp"
+
+// Layout of a telemetry file: a header, then a ring of per-tick records. A
+// record never wraps around the end of the ring; when one does not fit, the
+// rest of the ring is skipped, marked by a record size of 0 if there is room
+// for it. Records start on four byte boundaries; the size in a record leaves
+// out the padding after it. Offsets in the header count bytes written since
+// the file was made, so a record at offset n sits at n % capacity in the ring.
+static const char TELEMETRY_MAGIC[8] = { 'J', 'A', 'N', 'D', 'T', 'E', 'L', '1' };
+static const uint32_t TELEMETRY_VERSION = 1;
+
+// Positions are stored in quarter pixels
+static const int TELEMETRY_QUANTIZATION = 4;
+
+struct TelemetryHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t capacity;
+    uint64_t head;
+    uint64_t tail;
+    int32_t worldWidth;
+    int32_t worldHeight;
+    int32_t quantization;
+    uint32_t stateCount;
+};
+
+enum TelemetryFlags
+{
+    TELEMETRY_KEYFRAME = 1
+};
+
+// Followed by one entry per peon in a keyframe: x and y as zigzag varints,
+// then the state as a byte. Other records only hold the peons that changed
+// since the last record, each as a varint count of unchanged peons skipped
+// since the previous entry, a byte with the state and 0x80 set if the peon
+// moved, and then the change in x and y as zigzag varints if it did.
+struct TelemetryRecord
+{
+    uint32_t size;
+    uint32_t flags;
+    int32_t tick;
+    int32_t resources;
+    int32_t peons;
+    uint32_t peonCount;
+};
+
+static const uint8_t TELEMETRY_MOVED = 0x80;
+
+static const uint32_t TELEMETRY_RECORD_ALIGNMENT = 4;
+
+// Distance from one record to the next
+inline uint32_t PaddedRecordSize(uint32_t size)
+{
+    return (size + TELEMETRY_RECORD_ALIGNMENT - 1) & ~(TELEMETRY_RECORD_ALIGNMENT - 1);
+}
+
+inline uint8_t* WriteVarint(uint8_t* out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+inline uint8_t* WriteZigzag(uint8_t* out, int32_t value)
+{
+    return WriteVarint(out, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+// Both return nullptr when the value runs past end
+inline const uint8_t* ReadVarint(const uint8_t* in, const uint8_t* end, uint32_t& value)
+{
+    value = 0;
+    for (int shift = 0; in < end && shift < 35; shift += 7)
+    {
+        uint8_t byte = *in++;
+        value |= (uint32_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return in;
+        }
+    }
+
+    return nullptr;
+}
+
+inline const uint8_t* ReadZigzag(const uint8_t* in, const uint8_t* end, int32_t& value)
+{
+    uint32_t raw = 0;
+    in = ReadVarint(in, end, raw);
+    value = (int32_t)(raw >> 1) ^ -(int32_t)(raw & 1);
+    return in;
+}
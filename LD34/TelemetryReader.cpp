@@ -0,0 +1,279 @@
+#include "PCH.hpp"
+#include "TelemetryReader.hpp"
+#include "GameOptions.hpp"
+#include "Logger.hpp"
+#include <cstring>
+
+static const char* STATE_NAMES[] = { "idle", "walking", "gathering", "sacrifice" };
+
+TelemetryReader::TelemetryReader(const GameOptions& options) :
+    m_path(options.readTelemetry),
+    m_synced(false),
+    m_heatWidth(0),
+    m_heatHeight(0),
+    m_series(nullptr),
+    m_records(0),
+    m_skipped(0),
+    m_firstTick(0),
+    m_lastTick(0)
+{
+    std::memset(&m_header, 0, sizeof(m_header));
+}
+
+int TelemetryReader::Run()
+{
+    if (!Load())
+    {
+        return 1;
+    }
+
+    m_heatWidth = std::max((int)m_header.worldWidth / CELL_SIZE, 1);
+    m_heatHeight = std::max((int)m_header.worldHeight / CELL_SIZE, 1);
+    m_heat.assign((size_t)m_heatWidth * m_heatHeight, 0);
+    for (int i = 0; i < STATE_COUNT; i++)
+    {
+        m_stateHeat[i].assign(m_heat.size(), 0);
+    }
+
+    std::string seriesPath = m_path + ".series.csv";
+    m_series = std::fopen(seriesPath.c_str(), "w");
+    if (m_series == nullptr)
+    {
+        LOG_ERROR("Unable to create %s!", seriesPath.c_str());
+        return 1;
+    }
+    std::fprintf(m_series, "tick,resources,peons,idle,walking,gathering,sacrifice\n");
+
+    // Walk the ring from the oldest record left to the newest
+    const uint8_t* ring = m_file.data() + m_header.headerSize;
+    uint64_t capacity = m_header.capacity;
+    uint64_t offset = m_header.tail;
+    bool corrupt = false;
+    while (offset < m_header.head)
+    {
+        uint64_t physical = offset % capacity;
+        uint32_t size = 0;
+        if (physical + sizeof(size) <= capacity)
+        {
+            std::memcpy(&size, ring + physical, sizeof(size));
+        }
+
+        if (size == 0)
+        {
+            offset += capacity - physical;
+            continue;
+        }
+
+        if (size < sizeof(TelemetryRecord) || physical + size > capacity)
+        {
+            corrupt = true;
+            break;
+        }
+
+        TelemetryRecord record;
+        std::memcpy(&record, ring + physical, sizeof(record));
+        const uint8_t* data = ring + physical + sizeof(record);
+        if (!DecodeRecord(record, data, ring + physical + size))
+        {
+            corrupt = true;
+            break;
+        }
+
+        offset += PaddedRecordSize(size);
+    }
+
+    std::fclose(m_series);
+    m_series = nullptr;
+
+    if (corrupt)
+    {
+        LOG_WARNING("%s is corrupt at offset %llu, stopped reading there", m_path.c_str(), (unsigned long long)offset);
+    }
+
+    bool written = WriteHeatmap(m_path + ".heat.pgm", m_heat);
+    for (int i = 0; i < STATE_COUNT; i++)
+    {
+        written &= WriteHeatmap(m_path + ".heat-" + STATE_NAMES[i] + ".pgm", m_stateHeat[i]);
+    }
+
+    std::cout << "Read " << m_records << " records from tick " << m_firstTick << " to " << m_lastTick
+        << ", skipped " << m_skipped << " before the first keyframe" << std::endl;
+    std::cout << "Wrote " << seriesPath << " and " << (STATE_COUNT + 1) << " heatmaps" << std::endl;
+
+    return written ? 0 : 1;
+}
+
+bool TelemetryReader::Load()
+{
+    FILE* file = std::fopen(m_path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        LOG_ERROR("Unable to open %s!", m_path.c_str());
+        return false;
+    }
+
+    std::fseek(file, 0, SEEK_END);
+    long size = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+
+    m_file.resize(size > 0 ? (size_t)size : 0);
+    size_t read = m_file.empty() ? 0 : std::fread(m_file.data(), 1, m_file.size(), file);
+    std::fclose(file);
+
+    if (read < sizeof(m_header))
+    {
+        LOG_ERROR("%s is too short to hold telemetry!", m_path.c_str());
+        return false;
+    }
+
+    std::memcpy(&m_header, m_file.data(), sizeof(m_header));
+    if (std::memcmp(m_header.magic, TELEMETRY_MAGIC, sizeof(TELEMETRY_MAGIC)) != 0 || m_header.version != TELEMETRY_VERSION)
+    {
+        LOG_ERROR("%s is not a telemetry file this version can read!", m_path.c_str());
+        return false;
+    }
+
+    if (m_header.headerSize < sizeof(m_header) || m_header.capacity == 0 ||
+        m_header.headerSize + m_header.capacity > read || m_header.tail > m_header.head ||
+        m_header.quantization <= 0)
+    {
+        LOG_ERROR("%s has a broken header!", m_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool TelemetryReader::DecodeRecord(const TelemetryRecord& record, const uint8_t* data, const uint8_t* end)
+{
+    // Deltas mean nothing until a keyframe has said where everyone is
+    bool keyframe = (record.flags & TELEMETRY_KEYFRAME) != 0;
+    if (!keyframe && !m_synced)
+    {
+        m_skipped++;
+        return true;
+    }
+
+    if (m_x.size() < record.peonCount)
+    {
+        m_x.resize(record.peonCount, 0);
+        m_y.resize(record.peonCount, 0);
+        m_state.resize(record.peonCount, 0);
+    }
+
+    if (keyframe)
+    {
+        for (uint32_t i = 0; i < record.peonCount; i++)
+        {
+            data = ReadZigzag(data, end, m_x[i]);
+            data = (data != nullptr) ? ReadZigzag(data, end, m_y[i]) : nullptr;
+            if (data == nullptr || data >= end)
+            {
+                return false;
+            }
+            m_state[i] = *data++;
+        }
+        m_synced = true;
+    }
+    else
+    {
+        uint32_t index = 0;
+        while (data < end)
+        {
+            uint32_t skip;
+            data = ReadVarint(data, end, skip);
+            if (data == nullptr || data >= end)
+            {
+                return false;
+            }
+
+            index += skip;
+            if (index >= record.peonCount)
+            {
+                return false;
+            }
+
+            uint8_t entry = *data++;
+            m_state[index] = entry & ~TELEMETRY_MOVED;
+            if (entry & TELEMETRY_MOVED)
+            {
+                int32_t dx;
+                int32_t dy;
+                data = ReadZigzag(data, end, dx);
+                data = (data != nullptr) ? ReadZigzag(data, end, dy) : nullptr;
+                if (data == nullptr)
+                {
+                    return false;
+                }
+                m_x[index] += dx;
+                m_y[index] += dy;
+            }
+            index++;
+        }
+    }
+
+    Accumulate(record);
+    return true;
+}
+
+void TelemetryReader::Accumulate(const TelemetryRecord& record)
+{
+    int states[STATE_COUNT] = {};
+    int scale = m_header.quantization * CELL_SIZE;
+    for (uint32_t i = 0; i < record.peonCount; i++)
+    {
+        int state = m_state[i];
+        int cellX = m_x[i] / scale;
+        int cellY = m_y[i] / scale;
+        bool inside = (m_x[i] >= 0 && m_y[i] >= 0 && cellX < m_heatWidth && cellY < m_heatHeight);
+
+        if (inside)
+        {
+            m_heat[cellY * m_heatWidth + cellX]++;
+        }
+
+        if (state < STATE_COUNT)
+        {
+            states[state]++;
+            if (inside)
+            {
+                m_stateHeat[state][cellY * m_heatWidth + cellX]++;
+            }
+        }
+    }
+
+    std::fprintf(m_series, "%d,%d,%d,%d,%d,%d,%d\n", record.tick, record.resources, record.peons,
+        states[0], states[1], states[2], states[3]);
+
+    if (m_records == 0)
+    {
+        m_firstTick = record.tick;
+    }
+    m_lastTick = record.tick;
+    m_records++;
+}
+
+bool TelemetryReader::WriteHeatmap(const std::string& path, const std::vector<uint32_t>& counts) const
+{
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        LOG_ERROR("Unable to create %s!", path.c_str());
+        return false;
+    }
+
+    // Log scaled, or a crowd around the bonfire would wash out everything else
+    uint32_t highest = counts.empty() ? 0 : *std::max_element(counts.begin(), counts.end());
+    double scale = (highest > 0) ? 255.0 / std::log(1.0 + highest) : 0.0;
+
+    std::vector<uint8_t> pixels(counts.size());
+    for (size_t i = 0; i < counts.size(); i++)
+    {
+        pixels[i] = (uint8_t)std::lrint(std::log(1.0 + counts[i]) * scale);
+    }
+
+    std::fprintf(file, "P5\n%d %d\n255\n", m_heatWidth, m_heatHeight);
+    std::fwrite(pixels.data(), 1, pixels.size(), file);
+    std::fclose(file);
+    return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "PCH.hpp"
+#include "Telemetry.hpp"
+#include <cstdio>
+
+struct GameOptions;
+
+// Turns a telemetry file back into something to look at: PATH.series.csv with
+// one row per tick, and PATH.heat.pgm plus one PATH.heat-STATE.pgm per peon
+// state counting how many ticks peons spent over each patch of the world.
+class TelemetryReader
+{
+public:
+    TelemetryReader(const GameOptions& options);
+
+    int Run();
+
+private:
+    bool Load();
+    bool DecodeRecord(const TelemetryRecord& record, const uint8_t* data, const uint8_t* end);
+    void Accumulate(const TelemetryRecord& record);
+    bool WriteHeatmap(const std::string& path, const std::vector<uint32_t>& counts) const;
+
+private:
+    // World pixels per heatmap pixel
+    static const int CELL_SIZE = 4;
+    static const int STATE_COUNT = 4;
+
+    std::string m_path;
+    std::vector<uint8_t> m_file;
+    TelemetryHeader m_header;
+
+    // Every peon as of the last record decoded
+    std::vector<int32_t> m_x;
+    std::vector<int32_t> m_y;
+    std::vector<uint8_t> m_state;
+    bool m_synced;
+
+    int m_heatWidth;
+    int m_heatHeight;
+    std::vector<uint32_t> m_heat;
+    std::vector<uint32_t> m_stateHeat[STATE_COUNT];
+
+    FILE* m_series;
+    uint64_t m_records;
+    uint64_t m_skipped;
+    int m_firstTick;
+    int m_lastTick;
+};
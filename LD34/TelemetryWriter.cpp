@@ -0,0 +1,387 @@
+#include "PCH.hpp"
+#include "TelemetryWriter.hpp"
+#include "Logger.hpp"
+#include <chrono>
+#include <cstring>
+
+#if WINDOWS
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+TelemetryWriter::TelemetryWriter() :
+    m_file(nullptr),
+    m_mapping(nullptr),
+    m_view(nullptr),
+    m_viewSize(0),
+    m_header(nullptr),
+    m_ring(nullptr),
+    m_submitted(0),
+    m_written(0),
+    m_running(false),
+    m_reserved(0),
+    m_stalls(0),
+    m_bytesWritten(0),
+    m_overflowed(false)
+{
+}
+
+TelemetryWriter::~TelemetryWriter()
+{
+    Close();
+}
+
+bool TelemetryWriter::Open(const std::string& path, uint64_t capacity, int worldWidth, int worldHeight)
+{
+    Close();
+
+    // Records stay aligned after the ring wraps around
+    capacity &= ~(uint64_t)(TELEMETRY_RECORD_ALIGNMENT - 1);
+    uint64_t size = HEADER_SIZE + capacity;
+
+#if WINDOWS
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        LOG_ERROR("Unable to create %s for telemetry!", path.c_str());
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, NULL);
+    void* view = (mapping != NULL) ? MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)size) : NULL;
+    if (view == NULL)
+    {
+        LOG_ERROR("Unable to map %s for telemetry! Error %lu", path.c_str(), GetLastError());
+        if (mapping != NULL)
+        {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        return false;
+    }
+
+    m_file = file;
+    m_mapping = mapping;
+#else
+    int file = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file < 0)
+    {
+        LOG_ERROR("Unable to create %s for telemetry!", path.c_str());
+        return false;
+    }
+
+    void* view = MAP_FAILED;
+    if (ftruncate(file, (off_t)size) == 0)
+    {
+        view = mmap(nullptr, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    }
+
+    // The mapping keeps the file open on its own
+    close(file);
+    if (view == MAP_FAILED)
+    {
+        LOG_ERROR("Unable to map %s for telemetry!", path.c_str());
+        return false;
+    }
+#endif
+
+    m_view = (uint8_t*)view;
+    m_viewSize = size;
+    m_header = (TelemetryHeader*)m_view;
+    m_ring = m_view + HEADER_SIZE;
+
+    std::memcpy(m_header->magic, TELEMETRY_MAGIC, sizeof(TELEMETRY_MAGIC));
+    m_header->version = TELEMETRY_VERSION;
+    m_header->headerSize = HEADER_SIZE;
+    m_header->capacity = capacity;
+    m_header->head = 0;
+    m_header->tail = 0;
+    m_header->worldWidth = worldWidth;
+    m_header->worldHeight = worldHeight;
+    m_header->quantization = TELEMETRY_QUANTIZATION;
+    m_header->stateCount = 4;
+
+    m_lastX.clear();
+    m_lastY.clear();
+    m_lastState.clear();
+    m_submitted.store(0);
+    m_written.store(0);
+    m_bytesWritten.store(0);
+    m_overflowed.store(false);
+    m_stalls = 0;
+
+    m_running.store(true);
+    m_thread = std::thread(&TelemetryWriter::WriterLoop, this);
+
+    LOG_INFO("Recording telemetry to %s (%llu KB ring)", path.c_str(), (unsigned long long)(capacity / 1024));
+    return true;
+}
+
+void TelemetryWriter::Close()
+{
+    if (m_view == nullptr)
+    {
+        return;
+    }
+
+    m_running.store(false);
+    m_thread.join();
+
+#if WINDOWS
+    FlushViewOfFile(m_view, 0);
+    UnmapViewOfFile(m_view);
+    CloseHandle((HANDLE)m_mapping);
+    CloseHandle((HANDLE)m_file);
+#else
+    munmap(m_view, (size_t)m_viewSize);
+#endif
+
+    m_file = nullptr;
+    m_mapping = nullptr;
+    m_view = nullptr;
+    m_header = nullptr;
+    m_ring = nullptr;
+}
+
+bool TelemetryWriter::IsOpen() const
+{
+    return m_view != nullptr;
+}
+
+void TelemetryWriter::Submit(int tick, int resources, int peons, const float* x, const float* y, const uint8_t* states, size_t count)
+{
+    if (!IsOpen() || m_overflowed.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    WaitForWriter(QUEUE_SIZE - 1);
+
+    uint64_t submitted = m_submitted.load(std::memory_order_relaxed);
+    Sample& sample = m_samples[submitted % QUEUE_SIZE];
+    sample.tick = tick;
+    sample.resources = resources;
+    sample.peons = peons;
+    sample.x.assign(x, x + count);
+    sample.y.assign(y, y + count);
+    sample.states.assign(states, states + count);
+
+    m_submitted.store(submitted + 1, std::memory_order_release);
+}
+
+void TelemetryWriter::Reserve(size_t peonCount)
+{
+    if (peonCount <= m_reserved)
+    {
+        return;
+    }
+
+    // Every sample has to be back in our hands before it can be grown
+    WaitForWriter(0);
+    for (int i = 0; i < QUEUE_SIZE; i++)
+    {
+        m_samples[i].x.reserve(peonCount);
+        m_samples[i].y.reserve(peonCount);
+        m_samples[i].states.reserve(peonCount);
+    }
+
+    m_lastX.reserve(peonCount);
+    m_lastY.reserve(peonCount);
+    m_lastState.reserve(peonCount);
+    m_reserved = peonCount;
+}
+
+uint64_t TelemetryWriter::GetRecordCount() const
+{
+    return m_written.load();
+}
+
+uint64_t TelemetryWriter::GetBytesWritten() const
+{
+    return m_bytesWritten.load();
+}
+
+uint64_t TelemetryWriter::GetStalls() const
+{
+    return m_stalls;
+}
+
+void TelemetryWriter::WriterLoop()
+{
+    int idle = 0;
+    for (;;)
+    {
+        uint64_t next = m_written.load(std::memory_order_relaxed);
+        if (next == m_submitted.load(std::memory_order_acquire))
+        {
+            // Look once more after the flag, in case a last tick came in
+            if (!m_running.load() && next == m_submitted.load(std::memory_order_acquire))
+            {
+                break;
+            }
+
+            // Stay close while ticks keep coming, and sleep once they stop
+            if (++idle < SPIN_COUNT)
+            {
+                std::this_thread::yield();
+            }
+            else
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            continue;
+        }
+
+        WriteRecord(m_samples[next % QUEUE_SIZE]);
+        m_written.store(next + 1, std::memory_order_release);
+        idle = 0;
+    }
+}
+
+void TelemetryWriter::WaitForWriter(uint64_t pending)
+{
+    uint64_t submitted = m_submitted.load(std::memory_order_relaxed);
+    if (submitted - m_written.load(std::memory_order_acquire) <= pending)
+    {
+        return;
+    }
+
+    m_stalls++;
+    while (submitted - m_written.load(std::memory_order_acquire) > pending)
+    {
+        std::this_thread::yield();
+    }
+}
+
+void TelemetryWriter::WriteRecord(const Sample& sample)
+{
+    // Only ever grows, so a peon keeps its slot
+    size_t count = sample.x.size();
+    if (m_lastX.size() < count)
+    {
+        m_lastX.resize(count, 0);
+        m_lastY.resize(count, 0);
+        m_lastState.resize(count, 0);
+    }
+
+    uint64_t capacity = m_header->capacity;
+    uint64_t worstCase = PaddedRecordSize((uint32_t)(sizeof(TelemetryRecord) + count * MAX_ENTRY_SIZE));
+    if (worstCase > capacity)
+    {
+        LOG_ERROR("The telemetry ring is too small for %d peons, recording stopped", (int)count);
+        m_overflowed.store(true);
+        return;
+    }
+
+    // Skip the end of the ring rather than split the record
+    uint64_t physical = m_header->head % capacity;
+    if (physical + worstCase > capacity)
+    {
+        uint64_t skipped = capacity - physical;
+        Reclaim(m_header->head + skipped);
+        *(uint32_t*)(m_ring + physical) = 0;
+        m_header->head += skipped;
+    }
+    Reclaim(m_header->head + worstCase);
+
+    bool keyframe = (m_written.load(std::memory_order_relaxed) % KEYFRAME_INTERVAL == 0);
+    TelemetryRecord* record = (TelemetryRecord*)(m_ring + m_header->head % capacity);
+    record->flags = keyframe ? TELEMETRY_KEYFRAME : 0;
+    record->tick = sample.tick;
+    record->resources = sample.resources;
+    record->peons = sample.peons;
+    record->peonCount = (uint32_t)count;
+
+    uint8_t* out = (uint8_t*)(record + 1);
+    out = keyframe ? WriteKeyframe(out, sample) : WriteDelta(out, sample);
+
+    // The size goes in last, so a record is only complete once it has one
+    record->size = (uint32_t)(out - (uint8_t*)record);
+    m_header->head += PaddedRecordSize(record->size);
+    m_bytesWritten.store(m_header->head, std::memory_order_relaxed);
+}
+
+// Rounds half away from zero, which is all the precision this needs and much
+// cheaper than lrint() in a loop over every peon
+static inline int32_t Quantize(float value)
+{
+    value *= TELEMETRY_QUANTIZATION;
+    return (int32_t)(value + (value >= 0.0f ? 0.5f : -0.5f));
+}
+
+uint8_t* TelemetryWriter::WriteKeyframe(uint8_t* out, const Sample& sample)
+{
+    const float* x = sample.x.data();
+    const float* y = sample.y.data();
+    const uint8_t* states = sample.states.data();
+    size_t count = sample.x.size();
+
+    int32_t* lastX = m_lastX.data();
+    int32_t* lastY = m_lastY.data();
+    uint8_t* lastState = m_lastState.data();
+
+    for (size_t i = 0; i < count; i++)
+    {
+        lastX[i] = Quantize(x[i]);
+        lastY[i] = Quantize(y[i]);
+        lastState[i] = states[i];
+
+        out = WriteZigzag(out, lastX[i]);
+        out = WriteZigzag(out, lastY[i]);
+        *out++ = states[i];
+    }
+
+    return out;
+}
+
+uint8_t* TelemetryWriter::WriteDelta(uint8_t* out, const Sample& sample)
+{
+    const float* x = sample.x.data();
+    const float* y = sample.y.data();
+    const uint8_t* states = sample.states.data();
+    size_t count = sample.x.size();
+
+    int32_t* lastX = m_lastX.data();
+    int32_t* lastY = m_lastY.data();
+    uint8_t* lastState = m_lastState.data();
+
+    size_t unchangedFrom = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        int32_t dx = Quantize(x[i]) - lastX[i];
+        int32_t dy = Quantize(y[i]) - lastY[i];
+        bool moved = (dx != 0 || dy != 0);
+        if (!moved && states[i] == lastState[i])
+        {
+            continue;
+        }
+
+        out = WriteVarint(out, (uint32_t)(i - unchangedFrom));
+        *out++ = states[i] | (moved ? TELEMETRY_MOVED : 0);
+        if (moved)
+        {
+            out = WriteZigzag(out, dx);
+            out = WriteZigzag(out, dy);
+            lastX[i] += dx;
+            lastY[i] += dy;
+        }
+        lastState[i] = states[i];
+        unchangedFrom = i + 1;
+    }
+
+    return out;
+}
+
+void TelemetryWriter::Reclaim(uint64_t end)
+{
+    uint64_t capacity = m_header->capacity;
+    while (m_header->tail < m_header->head && end - m_header->tail > capacity)
+    {
+        uint64_t physical = m_header->tail % capacity;
+        uint32_t size = *(uint32_t*)(m_ring + physical);
+        m_header->tail += (size == 0) ? capacity - physical : PaddedRecordSize(size);
+    }
+}
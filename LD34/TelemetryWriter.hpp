@@ -0,0 +1,94 @@
+#pragma once
+#include "PCH.hpp"
+#include "Telemetry.hpp"
+#include <atomic>
+#include <thread>
+
+// Appends a record of the world every tick to a fixed-size ring in a
+// memory-mapped file, overwriting the oldest records once it is full.
+// Every KEYFRAME_INTERVAL records holds every peon; the ones in between only
+// hold what changed, so a reader starts decoding at the first keyframe.
+//
+// Submitting a tick only copies the peons into a queue. A thread of the
+// writer's own encodes them straight into the mapping, so the simulation
+// never pays for encoding or for the page faults of a growing file, and
+// whatever was written survives a crash.
+class TelemetryWriter
+{
+public:
+    TelemetryWriter();
+    ~TelemetryWriter();
+
+    bool Open(const std::string& path, uint64_t capacity, int worldWidth, int worldHeight);
+
+    // Waits for everything submitted to be written
+    void Close();
+    bool IsOpen() const;
+
+    // Peons have to come in the same order every tick. Waits rather than
+    // lose the tick when the writer has fallen QUEUE_SIZE ticks behind.
+    void Submit(int tick, int resources, int peons, const float* x, const float* y, const uint8_t* states, size_t count);
+
+    // Room for this many peons, so submitting them does not allocate
+    void Reserve(size_t peonCount);
+
+    uint64_t GetRecordCount() const;
+    uint64_t GetBytesWritten() const;
+    uint64_t GetStalls() const;
+
+private:
+    struct Sample
+    {
+        int tick;
+        int resources;
+        int peons;
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<uint8_t> states;
+    };
+
+    void WriterLoop();
+    void WaitForWriter(uint64_t pending);
+    void WriteRecord(const Sample& sample);
+
+    // Drop the oldest records until everything before end fits in the ring
+    void Reclaim(uint64_t end);
+
+    uint8_t* WriteKeyframe(uint8_t* out, const Sample& sample);
+    uint8_t* WriteDelta(uint8_t* out, const Sample& sample);
+
+private:
+    static const uint32_t HEADER_SIZE = 64;
+    static const int KEYFRAME_INTERVAL = 60;
+    static const int QUEUE_SIZE = 16;
+    static const int SPIN_COUNT = 1000;
+
+    // Worst case for one peon: a skip count, a state byte and two deltas
+    static const size_t MAX_ENTRY_SIZE = 16;
+
+    void* m_file;
+    void* m_mapping;
+    uint8_t* m_view;
+    uint64_t m_viewSize;
+
+    TelemetryHeader* m_header;
+    uint8_t* m_ring;
+
+    // Ticks waiting to be written. The simulation fills m_samples[submitted
+    // % QUEUE_SIZE] and the writer thread empties m_samples[written % QUEUE_SIZE].
+    Sample m_samples[QUEUE_SIZE];
+    std::atomic<uint64_t> m_submitted;
+    std::atomic<uint64_t> m_written;
+    std::atomic<bool> m_running;
+    std::thread m_thread;
+    size_t m_reserved;
+    uint64_t m_stalls;
+
+    // What each peon looked like in the last record
+    std::vector<int32_t> m_lastX;
+    std::vector<int32_t> m_lastY;
+    std::vector<uint8_t> m_lastState;
+
+    std::atomic<uint64_t> m_bytesWritten;
+    std::atomic<bool> m_overflowed;
+};
@@ -2,6 +2,7 @@
 #include "Timer.hpp"
 
 Timer::Timer() :
+    m_clock(nullptr),
     m_startTime(0),
     m_pausedTime(0),
     m_isStarted(false),
@@ -9,11 +10,21 @@ Timer::Timer() :
 {
 }
 
+void Timer::SetClock(const double* clock)
+{
+    m_clock = clock;
+}
+
+double Timer::Now() const
+{
+    return (m_clock != nullptr) ? *m_clock : SDL_GetTicks();
+}
+
 void Timer::Start()
 {
     m_isStarted = true;
     m_isPaused = false;
-    m_startTime = SDL_GetTicks();
+    m_startTime = Now();
     m_pausedTime = 0;
 }
 
@@ -30,7 +41,7 @@ void Timer::Pause()
     if (m_isStarted && !m_isPaused)
     {
         m_isPaused = true;
-        m_pausedTime = SDL_GetTicks() - m_startTime;
+        m_pausedTime = Now() - m_startTime;
         m_startTime = 0;
     }
 }
@@ -40,7 +51,7 @@ void Timer::UnPause()
     if (m_isStarted && m_isPaused)
     {
         m_isPaused = false;
-        m_startTime = SDL_GetTicks() - m_pausedTime;
+        m_startTime = Now() - m_pausedTime;
         m_pausedTime = 0;
     }
 }
@@ -57,7 +68,7 @@ double Timer::GetTime()
         }
         else
         {
-            time = SDL_GetTicks() - m_startTime;
+            time = Now() - m_startTime;
         }
     }
     
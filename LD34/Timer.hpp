@@ -6,6 +6,9 @@ class Timer
 public:
     Timer();
 
+    // Read time from a clock in milliseconds instead of SDL_GetTicks()
+    void SetClock(const double* clock);
+
     void Start();
     void Stop();
     void Pause();
@@ -15,6 +18,10 @@ public:
     bool IsPaused();
 
 private:
+    double Now() const;
+
+private:
+    const double* m_clock;
     double m_startTime;
     double m_pausedTime;
     bool m_isStarted;
@@ -2,20 +2,15 @@
 #include "Tree.hpp"
 #include "Game.hpp"
 
-Tree::Tree(Game* game)
+Tree::Tree(Game* game) :
+    Resource(game, RESOURCE_TREE, AMOUNT, YIELD)
 {
-    m_game = game;
     m_ID = "tree";
 }
 
-void Tree::Update()
+void Tree::Render(RenderSnapshot& snapshot)
 {
-    GameObject::Update();
-}
-
-void Tree::Render()
-{
-    GameObject::Render();
+    GameObject::Render(snapshot);
 }
 
 void Tree::Clean()
@@ -1,13 +1,16 @@
 #pragma once
 #include "PCH.hpp"
-#include "GameObject.hpp"
+#include "Resource.hpp"
 
-class Tree : public GameObject
+class Tree : public Resource
 {
 public:
     Tree(Game* game);
 
-    void Update();
-    void Render();
+    void Render(RenderSnapshot& snapshot);
     void Clean();
+
+public:
+    static const int AMOUNT = 40;
+    static const int YIELD = 1;
 };
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+#include "PCH.hpp"
+#include <atomic>
+
+// Hands the latest of a stream of values from one writing thread to one
+// reading thread without either of them ever waiting. The writer owns one
+// slot and the reader another, and the third holds the newest finished
+// value. Publishing and acquiring each swap an index with that middle slot,
+// so the reader always gets the most recent value and skips any it missed.
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() :
+        m_writeIndex(0),
+        m_readIndex(1),
+        m_middle(2)
+    {
+    }
+
+    // Only safe before either side starts using the buffer
+    T& GetSlot(int index)
+    {
+        return m_slots[index];
+    }
+
+    // Writer side. Fill in the write buffer, then publish it.
+    T& GetWriteBuffer()
+    {
+        return m_slots[m_writeIndex];
+    }
+
+    void Publish()
+    {
+        m_writeIndex = m_middle.exchange(m_writeIndex | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // Reader side. Returns false, keeping the current read buffer, when
+    // nothing new has been published since the last call.
+    bool Acquire()
+    {
+        if ((m_middle.load(std::memory_order_relaxed) & FRESH) == 0)
+        {
+            return false;
+        }
+
+        m_readIndex = m_middle.exchange(m_readIndex, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    const T& GetReadBuffer() const
+    {
+        return m_slots[m_readIndex];
+    }
+
+private:
+    static const int INDEX_MASK = 3;
+    static const int FRESH = 4;
+
+    T m_slots[3];
+    int m_writeIndex;
+    int m_readIndex;
+    std::atomic<int> m_middle;
+};
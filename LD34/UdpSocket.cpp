@@ -0,0 +1,203 @@
+#include "PCH.hpp"
+#include "UdpSocket.hpp"
+#include "Logger.hpp"
+#include <cstring>
+
+#if WINDOWS
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+    #pragma comment(lib, "ws2_32.lib")
+    typedef int socklen_t;
+    static const intptr_t INVALID = (intptr_t)INVALID_SOCKET;
+#else
+    #include <arpa/inet.h>
+    #include <fcntl.h>
+    #include <netdb.h>
+    #include <netinet/in.h>
+    #include <sys/socket.h>
+    #include <unistd.h>
+    static const intptr_t INVALID = -1;
+#endif
+
+NetAddress::NetAddress() :
+    host(0),
+    port(0)
+{
+}
+
+bool NetAddress::Resolve(const std::string& hostAndPort, NetAddress& address)
+{
+    size_t colon = hostAndPort.rfind(':');
+    if (colon == std::string::npos)
+    {
+        return false;
+    }
+
+    std::string hostName = hostAndPort.substr(0, colon);
+    int port = std::atoi(hostAndPort.c_str() + colon + 1);
+    if (port <= 0 || port > 65535)
+    {
+        return false;
+    }
+
+#if WINDOWS
+    // getaddrinfo needs Winsock running, even before any socket is opened
+    WSADATA data;
+    WSAStartup(MAKEWORD(2, 2), &data);
+#endif
+
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    addrinfo* result = nullptr;
+    bool resolved = (getaddrinfo(hostName.empty() ? "127.0.0.1" : hostName.c_str(), nullptr, &hints, &result) == 0 && result != nullptr);
+    if (resolved)
+    {
+        address.host = ((sockaddr_in*)result->ai_addr)->sin_addr.s_addr;
+        address.port = htons((uint16_t)port);
+        freeaddrinfo(result);
+    }
+
+#if WINDOWS
+    WSACleanup();
+#endif
+
+    return resolved;
+}
+
+std::string NetAddress::ToString() const
+{
+    const uint8_t* bytes = (const uint8_t*)&host;
+    std::stringstream stream;
+    stream << (int)bytes[0] << "." << (int)bytes[1] << "." << (int)bytes[2] << "." << (int)bytes[3] << ":" << ntohs(port);
+    return stream.str();
+}
+
+bool NetAddress::IsValid() const
+{
+    return port != 0;
+}
+
+bool NetAddress::operator==(const NetAddress& other) const
+{
+    return host == other.host && port == other.port;
+}
+
+bool NetAddress::operator!=(const NetAddress& other) const
+{
+    return !(*this == other);
+}
+
+UdpSocket::UdpSocket() :
+    m_socket(INVALID)
+{
+}
+
+UdpSocket::~UdpSocket()
+{
+    Close();
+}
+
+bool UdpSocket::Open(uint16_t port)
+{
+    Close();
+
+#if WINDOWS
+    WSADATA data;
+    if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+    {
+        LOG_ERROR("Winsock could not initialize!");
+        return false;
+    }
+#endif
+
+    m_socket = (intptr_t)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (m_socket == INVALID)
+    {
+        LOG_ERROR("Unable to create UDP socket!");
+        return false;
+    }
+
+    sockaddr_in local;
+    std::memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(port);
+    if (bind(m_socket, (sockaddr*)&local, sizeof(local)) != 0)
+    {
+        LOG_ERROR("Unable to bind UDP socket to port %d!", (int)port);
+        Close();
+        return false;
+    }
+
+#if WINDOWS
+    u_long nonBlocking = 1;
+    ioctlsocket(m_socket, FIONBIO, &nonBlocking);
+#else
+    fcntl((int)m_socket, F_SETFL, fcntl((int)m_socket, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+    return true;
+}
+
+void UdpSocket::Close()
+{
+    if (m_socket == INVALID)
+    {
+        return;
+    }
+
+#if WINDOWS
+    closesocket(m_socket);
+    WSACleanup();
+#else
+    close((int)m_socket);
+#endif
+
+    m_socket = INVALID;
+}
+
+bool UdpSocket::IsOpen() const
+{
+    return m_socket != INVALID;
+}
+
+uint16_t UdpSocket::GetLocalPort() const
+{
+    sockaddr_in local;
+    socklen_t length = sizeof(local);
+    if (m_socket == INVALID || getsockname(m_socket, (sockaddr*)&local, &length) != 0)
+    {
+        return 0;
+    }
+
+    return ntohs(local.sin_port);
+}
+
+bool UdpSocket::Send(const NetAddress& to, const uint8_t* data, int size)
+{
+    sockaddr_in remote;
+    std::memset(&remote, 0, sizeof(remote));
+    remote.sin_family = AF_INET;
+    remote.sin_addr.s_addr = to.host;
+    remote.sin_port = to.port;
+
+    return sendto(m_socket, (const char*)data, size, 0, (sockaddr*)&remote, sizeof(remote)) == size;
+}
+
+int UdpSocket::Receive(NetAddress& from, uint8_t* buffer, int capacity)
+{
+    sockaddr_in remote;
+    socklen_t length = sizeof(remote);
+    int size = (int)recvfrom(m_socket, (char*)buffer, capacity, 0, (sockaddr*)&remote, &length);
+    if (size < 0)
+    {
+        return -1;
+    }
+
+    from.host = remote.sin_addr.s_addr;
+    from.port = remote.sin_port;
+    return size;
+}
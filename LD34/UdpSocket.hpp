@@ -0,0 +1,44 @@
+#pragma once
+#include "PCH.hpp"
+
+// IPv4 address and port, both kept in network byte order
+struct NetAddress
+{
+    NetAddress();
+
+    // Parse "host:port", looking the host up if it is a name
+    static bool Resolve(const std::string& hostAndPort, NetAddress& address);
+
+    std::string ToString() const;
+    bool IsValid() const;
+    bool operator==(const NetAddress& other) const;
+    bool operator!=(const NetAddress& other) const;
+
+    uint32_t host;
+    uint16_t port;
+};
+
+// Minimal non-blocking UDP socket over BSD sockets or Winsock
+class UdpSocket
+{
+public:
+    UdpSocket();
+    ~UdpSocket();
+
+    // Bind to a local port, or any free port when 0
+    bool Open(uint16_t port);
+    void Close();
+    bool IsOpen() const;
+    uint16_t GetLocalPort() const;
+
+    bool Send(const NetAddress& to, const uint8_t* data, int size);
+
+    // Size of the datagram read, or -1 when nothing is waiting
+    int Receive(NetAddress& from, uint8_t* buffer, int capacity);
+
+private:
+    UdpSocket(const UdpSocket&);
+    UdpSocket& operator=(const UdpSocket&);
+
+    intptr_t m_socket;
+};
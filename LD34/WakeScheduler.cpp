@@ -0,0 +1,42 @@
+#include "PCH.hpp"
+#include "WakeScheduler.hpp"
+
+void WakeScheduler::Schedule(Handle handle, double wakeTime, uint32_t ticket)
+{
+    Entry entry;
+    entry.wakeTime = wakeTime;
+    entry.ticket = ticket;
+    entry.handle = handle;
+
+    m_heap.push_back(entry);
+    std::push_heap(m_heap.begin(), m_heap.end());
+}
+
+bool WakeScheduler::PopDue(double now, Handle& handle, uint32_t& ticket)
+{
+    if (m_heap.empty() || m_heap.front().wakeTime > now)
+    {
+        return false;
+    }
+
+    std::pop_heap(m_heap.begin(), m_heap.end());
+    handle = m_heap.back().handle;
+    ticket = m_heap.back().ticket;
+    m_heap.pop_back();
+
+    return true;
+}
+
+void WakeScheduler::Reserve(size_t count)
+{
+    // Grow geometrically, since this gets called for every new object
+    if (m_heap.capacity() < count)
+    {
+        m_heap.reserve(std::max(count, m_heap.capacity() * 2));
+    }
+}
+
+size_t WakeScheduler::GetSize() const
+{
+    return m_heap.size();
+}
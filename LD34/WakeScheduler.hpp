@@ -0,0 +1,40 @@
+#pragma once
+#include "PCH.hpp"
+#include "Handle.hpp"
+
+// Min-heap of objects waiting for a point on the sim clock. Entries are never
+// removed early; an object that is woken by something else just gets a new
+// ticket, and the old entry is recognised as stale when it comes due.
+class WakeScheduler
+{
+public:
+    void Schedule(Handle handle, double wakeTime, uint32_t ticket);
+
+    // Take the earliest entry due at or before now, if there is one
+    bool PopDue(double now, Handle& handle, uint32_t& ticket);
+
+    size_t GetSize() const;
+    void Reserve(size_t count);
+
+private:
+    struct Entry
+    {
+        double wakeTime;
+        uint32_t ticket;
+        Handle handle;
+
+        bool operator<(const Entry& other) const
+        {
+            // Earliest wake on top of the heap, ties in scheduling order
+            if (wakeTime != other.wakeTime)
+            {
+                return wakeTime > other.wakeTime;
+            }
+
+            return ticket > other.ticket;
+        }
+    };
+
+private:
+    std::vector<Entry> m_heap;
+};